@@ -795,15 +795,19 @@ void mainLoop() {
 		cursor.rank = std::max(std::min(cursor.rank, 7), 0);
 		cursor.file = std::max(std::min(cursor.file, 7), 0);
 
-		if(pos.isInCheck(pos.color_playing))
+		if(pos.metadata.inCheck)
 		{
-			selections[pos.kingPositions[pos.color_playing].rank][pos.kingPositions[pos.color_playing].file] = pos.metadata.state == CHECK ? SquareStatus::CHECKED : SquareStatus::CHECKMATED;
+			selections[pos.kingPositions[pos.color_playing].rank][pos.kingPositions[pos.color_playing].file] = pos.metadata.state == CHECKMATE ? SquareStatus::CHECKMATED : SquareStatus::CHECKED;
 		}
 
-		for(Move& move : pos.metadata.legalMoves)
+		pos.CreateMoveList();
+
+		Coord origin = CoordEquals(selection, DEFAULT_INVALID_COORD) ? cursor : selection;
+		uint64_t targets = pos.metadata.targets[SquareIndex(origin)];
+		for(int square = 0; targets; square++, targets >>= 1)
 		{
-			 if(CoordEquals(move.from, CoordEquals(selection, DEFAULT_INVALID_COORD) ? cursor : selection))
-				selections[move.to.rank][move.to.file] = SquareStatus::MOVE_TARGETED;
+			if(targets & 1)
+				selections[square / 8][square % 8] = SquareStatus::MOVE_TARGETED;
 		}
 
 		selections[cursor.rank][cursor.file] = SquareStatus::CURSOR;
@@ -0,0 +1,111 @@
+#include <atomic>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include "alloctrack.hpp"
+
+static const char *ALLOC_SITE_NAMES[ALLOC_SITE_COUNT] =
+{
+    "unscoped",
+    "position setup",
+    "legacy moves",
+    "fen",
+    "perft root",
+    "perft",
+    "search root",
+    "search",
+};
+
+const char *AllocSiteName(AllocSite site)
+{
+    return ALLOC_SITE_NAMES[site];
+}
+
+#ifdef ENGINE_ALLOC_STATS
+
+// Zero initialized before any constructor runs, so allocations made during static initialization count too
+static std::atomic<uint64_t> allocationCounts[ALLOC_SITE_COUNT];
+static std::atomic<uint64_t> allocationBytes[ALLOC_SITE_COUNT];
+
+thread_local AllocSite allocSite = ALLOC_UNSCOPED;
+
+static void *CountedAllocate(size_t size)
+{
+    const AllocSite site = allocSite;
+    allocationCounts[site].fetch_add(1, std::memory_order_relaxed);
+    allocationBytes[site].fetch_add(size, std::memory_order_relaxed);
+
+    void *memory = std::malloc(size ? size : 1);
+    if(!memory) throw std::bad_alloc();
+
+    return memory;
+}
+
+void *operator new(size_t size) { return CountedAllocate(size); }
+void *operator new[](size_t size) { return CountedAllocate(size); }
+void operator delete(void *memory) noexcept { std::free(memory); }
+void operator delete[](void *memory) noexcept { std::free(memory); }
+void operator delete(void *memory, size_t) noexcept { std::free(memory); }
+void operator delete[](void *memory, size_t) noexcept { std::free(memory); }
+
+AllocCounts CollectAllocations()
+{
+    AllocCounts counts;
+
+    for(int i = 0; i < ALLOC_SITE_COUNT; i++)
+    {
+        counts.allocations[i] = allocationCounts[i].load(std::memory_order_relaxed);
+        counts.bytes[i] = allocationBytes[i].load(std::memory_order_relaxed);
+    }
+
+    return counts;
+}
+
+void ResetAllocations()
+{
+    for(int i = 0; i < ALLOC_SITE_COUNT; i++)
+    {
+        allocationCounts[i].store(0, std::memory_order_relaxed);
+        allocationBytes[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+#else
+
+AllocCounts CollectAllocations()
+{
+    AllocCounts counts = {};
+    return counts;
+}
+
+void ResetAllocations()
+{
+}
+
+#endif
+
+bool HotPathAllocated(const AllocCounts& counts)
+{
+    return counts.allocations[ALLOC_PERFT] || counts.allocations[ALLOC_SEARCH];
+}
+
+std::string AllocationReport(const AllocCounts& counts, uint64_t nodes)
+{
+    std::string report;
+    char line[160];
+
+    for(int i = 0; i < ALLOC_SITE_COUNT; i++)
+    {
+        if(!counts.allocations[i]) continue;
+
+        std::snprintf(line, sizeof line, "%-16s %10" PRIu64 " allocations %12" PRIu64 " bytes %10.4f / node %10.2f bytes / node\n",
+                      ALLOC_SITE_NAMES[i], counts.allocations[i], counts.bytes[i],
+                      nodes ? static_cast<double>(counts.allocations[i]) / nodes : 0.0,
+                      nodes ? static_cast<double>(counts.bytes[i]) / nodes : 0.0);
+        report += line;
+    }
+
+    return report.empty() ? "no allocations\n" : report;
+}
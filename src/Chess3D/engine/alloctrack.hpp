@@ -0,0 +1,72 @@
+#ifndef CHEESENG_ALLOCTRACK_H
+#define CHEESENG_ALLOCTRACK_H
+
+#include <cstdint>
+#include <string>
+
+// Heap allocation counting by call site. Built with ENGINE_ALLOC_STATS (cmake -DENGINE_ALLOC_STATS=ON) the
+// global operator new is replaced, and every allocation is charged to the innermost ALLOC_SCOPE of its
+// thread. Without it ALLOC_SCOPE compiles to nothing and the counts stay zero.
+enum AllocSite
+{
+    ALLOC_UNSCOPED,
+    ALLOC_POSITION_SETUP,   // Position from FEN or BoardState, copies taken for a search or perft
+    ALLOC_LEGACY_MOVES,     // std::vector<Move> lists and move strings of the GUI path
+    ALLOC_FEN,
+    ALLOC_PERFT_ROOT,
+    ALLOC_PERFT,            // the tree walk: must not allocate
+    ALLOC_SEARCH_ROOT,      // root moves, iteration reports
+    ALLOC_SEARCH,           // negamax and quiescence: must not allocate
+    ALLOC_SITE_COUNT
+};
+
+struct AllocCounts
+{
+    uint64_t allocations[ALLOC_SITE_COUNT];
+    uint64_t bytes[ALLOC_SITE_COUNT];
+};
+
+#ifdef ENGINE_ALLOC_STATS
+
+#define ALLOCS_ENABLED true
+
+extern thread_local AllocSite allocSite;
+
+class AllocScope
+{
+public:
+    explicit AllocScope(AllocSite site) : previous(allocSite) { allocSite = site; }
+    ~AllocScope() { allocSite = previous; }
+
+    AllocScope(const AllocScope&) = delete;
+    AllocScope& operator=(const AllocScope&) = delete;
+
+private:
+    AllocSite previous;
+};
+
+#define ALLOC_CONCAT_(a, b) a##b
+#define ALLOC_CONCAT(a, b) ALLOC_CONCAT_(a, b)
+#define ALLOC_SCOPE(site) AllocScope ALLOC_CONCAT(allocScope, __LINE__)(site)
+
+#else
+
+#define ALLOCS_ENABLED false
+
+#define ALLOC_SCOPE(site) ((void)0)
+
+#endif
+
+// Totals of all threads since the last reset
+AllocCounts CollectAllocations();
+void ResetAllocations();
+
+const char *AllocSiteName(AllocSite site);
+
+// True when the perft or search tree walk allocated
+bool HotPathAllocated(const AllocCounts& counts);
+
+// One line per site that allocated: count, bytes, and both per node of the run
+std::string AllocationReport(const AllocCounts& counts, uint64_t nodes);
+
+#endif //CHEESENG_ALLOCTRACK_H
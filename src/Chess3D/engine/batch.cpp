@@ -0,0 +1,155 @@
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include "batch.hpp"
+#include "evaluate.hpp"
+#include "pgn.hpp"
+#include "search.hpp"
+#include "tt.hpp"
+
+// Positions per unit of work: small enough to balance searches of uneven cost, large enough that
+// static evaluations do not spend their time on the queue locks
+#define BATCH_CHUNK 16
+
+#define BATCH_SHARED_TABLE_MB 16
+
+// A table per thread is cleared before every position, which costs as much as a shallow search
+// when the table is large: size it to the nodes a search stores (16 bytes a slot)
+static size_t TableMB(const BatchJob& job)
+{
+    if(job.tableMB) return job.tableMB;
+    if(job.sharedTable) return BATCH_SHARED_TABLE_MB;
+
+    // One megabyte holds 65536 slots, enough for the searches up to depth 8 of the bench positions
+    if(job.type == BATCH_DEPTH) return job.depth <= 8 ? 1 : BATCH_SHARED_TABLE_MB;
+
+    const uint64_t megabytes = (job.nodes * 16 + (1 << 20) - 1) >> 20;
+    return static_cast<size_t>(std::max<uint64_t>(1, std::min<uint64_t>(megabytes, BATCH_SHARED_TABLE_MB)));
+}
+
+// A worker takes chunks from the front of its own queue and steals from the back of the others'
+struct WorkQueue
+{
+    std::mutex mutex;
+    std::deque<std::pair<size_t, size_t>> chunks;
+};
+
+static bool TakeChunk(std::vector<WorkQueue>& queues, int self, std::pair<size_t, size_t>& chunk)
+{
+    const int count = static_cast<int>(queues.size());
+
+    for(int i = 0; i < count; i++)
+    {
+        WorkQueue& queue = queues[(self + i) % count];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+
+        if(queue.chunks.empty()) continue;
+
+        if(i == 0)
+        {
+            chunk = queue.chunks.front();
+            queue.chunks.pop_front();
+        }
+        else
+        {
+            chunk = queue.chunks.back();
+            queue.chunks.pop_back();
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+std::vector<BatchResult> EvaluateBatch(const std::string *fens, size_t count, const BatchJob& job, const BatchCallback& onResult)
+{
+    const int threads = job.threads > 0 ? job.threads : 1;
+    std::vector<BatchResult> results(count);
+
+    // Every thread starts with a contiguous share of the input, so neighbouring positions stay on one thread
+    std::vector<WorkQueue> queues(threads);
+
+    for(int t = 0; t < threads; t++)
+    {
+        const size_t begin = count * t / threads, end = count * (t + 1) / threads;
+
+        for(size_t first = begin; first < end; first += BATCH_CHUNK)
+            queues[t].chunks.emplace_back(first, std::min(end, first + BATCH_CHUNK));
+    }
+
+    std::unique_ptr<TranspositionTable> sharedTable;
+    if(job.type != BATCH_STATIC_EVAL && job.sharedTable) sharedTable.reset(new TranspositionTable(TableMB(job)));
+
+    // Results are handed out in input order: each completion releases the done prefix after the last one sent
+    std::mutex emitMutex;
+    std::vector<char> done(count, 0);
+    size_t nextEmit = 0;
+
+    SearchLimits limits;
+    if(job.type == BATCH_DEPTH) limits.depth = job.depth;
+    if(job.type == BATCH_NODES) limits.nodes = job.nodes;
+
+    auto worker = [&](int self)
+    {
+        std::unique_ptr<TranspositionTable> ownTable;
+        std::unique_ptr<Search> search;
+
+        if(job.type != BATCH_STATIC_EVAL)
+        {
+            if(!sharedTable) ownTable.reset(new TranspositionTable(TableMB(job)));
+            search.reset(new Search(sharedTable ? *sharedTable : *ownTable));
+        }
+
+        for(std::pair<size_t, size_t> chunk; TakeChunk(queues, self, chunk); )
+        {
+            for(size_t i = chunk.first; i < chunk.second; i++)
+            {
+                BatchResult& result = results[i];
+                result = BatchResult{i, false, 0, NULL_PACKED_MOVE, 0};
+
+                if(PlausibleFEN(fens[i]))
+                {
+                    Position pos(fens[i]);
+                    result.valid = true;
+
+                    if(job.type == BATCH_STATIC_EVAL)
+                    {
+                        result.score = Evaluate(pos);
+                        result.nodes = 1;
+                    }
+                    else
+                    {
+                        if(ownTable) ownTable->clear();
+                        search->clear();
+
+                        SearchResult searched = search->run(pos, limits);
+                        result.score = searched.score;
+                        result.bestMove = searched.bestMove;
+                        result.nodes = searched.nodes;
+                    }
+                }
+
+                std::lock_guard<std::mutex> lock(emitMutex);
+                done[i] = 1;
+
+                while(nextEmit < count && done[nextEmit])
+                {
+                    if(onResult) onResult(results[nextEmit]);
+                    nextEmit++;
+                }
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for(int t = 1; t < threads; t++) pool.emplace_back(worker, t);
+    worker(0);
+    for(std::thread& thread : pool) thread.join();
+
+    return results;
+}
@@ -0,0 +1,44 @@
+#ifndef CHEESENG_BATCH_H
+#define CHEESENG_BATCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "move.hpp"
+
+enum BatchJobType{BATCH_STATIC_EVAL, BATCH_DEPTH, BATCH_NODES};
+
+struct BatchJob
+{
+    BatchJobType type = BATCH_STATIC_EVAL;
+    int depth = 1;                  // BATCH_DEPTH
+    uint64_t nodes = 0;             // BATCH_NODES
+    int threads = 1;
+
+    // One table for all threads: faster, but a result then depends on what the table held. With a
+    // table per thread, cleared before every position, each result only depends on its position.
+    bool sharedTable = false;
+    size_t tableMB = 0;             // 0: 16 MB when shared, a table per thread sized to the job
+
+};
+
+struct BatchResult
+{
+    size_t index;                   // position in the input
+    bool valid;                     // false for a FEN that could not be read
+    int score;                      // centipawns for the side to move, UciScore for mates
+    PackedMove bestMove;            // NULL_PACKED_MOVE for a static evaluation
+    uint64_t nodes;
+};
+
+typedef std::function<void(const BatchResult& result)> BatchCallback;
+
+// Evaluate or search count positions given as FENs on a work stealing pool. The results come back in input
+// order; onResult, when given, is called in input order as well, as soon as every earlier position is done.
+std::vector<BatchResult> EvaluateBatch(const std::string *fens, size_t count, const BatchJob& job,
+                                       const BatchCallback& onResult=BatchCallback());
+
+#endif //CHEESENG_BATCH_H
@@ -0,0 +1,4 @@
+#include "bitboard.hpp"
+
+// Evaluated by the compiler: the tables are emitted as constant data, there is nothing to initialize at startup
+constexpr BitboardTables BITBOARDS = bitboard_detail::MakeBitboardTables();
@@ -0,0 +1,176 @@
+#ifndef CHEESENG_BITBOARD_H
+#define CHEESENG_BITBOARD_H
+
+#include <cstdint>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "coord.hpp"
+#include "piecetypes.hpp"
+
+// One bit per square, numbered like SquareIndex: a1 = bit 0, h8 = bit 63
+typedef uint64_t Bitboard;
+
+#define SQUARE_BB(square) (Bitboard(1) << (square))
+
+#define FILE_A_BB 0x0101010101010101ULL
+#define FILE_H_BB 0x8080808080808080ULL
+#define RANK_1_BB 0x00000000000000FFULL
+#define RANK_8_BB 0xFF00000000000000ULL
+#define DARK_SQUARES_BB 0xAA55AA55AA55AA55ULL
+
+// Shift every square by Delta squares (8 is one rank up). Wrapping across the a / h files is up to the caller.
+template<int Delta>
+constexpr Bitboard Shift(Bitboard b)
+{
+    return Delta > 0 ? b << (Delta > 0 ? Delta : 0) : b >> (Delta < 0 ? -Delta : 0);
+}
+
+inline int PopCount(Bitboard b)
+{
+#ifdef _MSC_VER
+    return static_cast<int>(__popcnt64(b));
+#else
+    return __builtin_popcountll(b);
+#endif
+}
+
+// Index of the lowest / highest set bit, b must not be empty
+inline int LowestSquare(Bitboard b)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, b);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(b);
+#endif
+}
+
+inline int HighestSquare(Bitboard b)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse64(&index, b);
+    return static_cast<int>(index);
+#else
+    return 63 ^ __builtin_clzll(b);
+#endif
+}
+
+inline int PopLowestSquare(Bitboard& b)
+{
+    int square = LowestSquare(b);
+    b &= b - 1;
+    return square;
+}
+
+// Directions as (file, rank) steps, the first four are diagonal and the last four straight.
+// Opposite directions are paired (dir ^ 1) and the odd ones walk towards higher squares.
+enum RayDirection {RAY_SW, RAY_NE, RAY_SE, RAY_NW, RAY_W, RAY_E, RAY_S, RAY_N, N_RAY_DIRECTIONS};
+
+struct BitboardTables
+{
+    Bitboard knight[64];
+    Bitboard king[64];
+    Bitboard pawn[2][64];               // squares attacked by a pawn of [color] on [square]
+    Bitboard ray[N_RAY_DIRECTIONS][64]; // squares from [square] to the edge, exclusive
+    Bitboard between[64][64];           // squares strictly between two aligned squares, 0 otherwise
+    Bitboard line[64][64];              // the full edge to edge line through two aligned squares, 0 otherwise
+};
+
+namespace bitboard_detail
+{
+    constexpr int RAY_STEPS[N_RAY_DIRECTIONS][2] = {{-1, -1}, {1, 1}, {1, -1}, {-1, 1}, {-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+    constexpr int KNIGHT_STEPS[8][2] = {{1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2}};
+
+    constexpr Bitboard StepTarget(int square, int file, int rank)
+    {
+        return (square % 8 + file < 0 || square % 8 + file > 7 || square / 8 + rank < 0 || square / 8 + rank > 7)
+            ? 0 : SQUARE_BB(square + rank * 8 + file);
+    }
+
+    constexpr BitboardTables MakeBitboardTables()
+    {
+        BitboardTables tables{};
+
+        for(int square = 0; square < 64; square++)
+        {
+            for(int i = 0; i < 8; i++)
+            {
+                tables.knight[square] |= StepTarget(square, KNIGHT_STEPS[i][0], KNIGHT_STEPS[i][1]);
+                tables.king[square]   |= StepTarget(square, RAY_STEPS[i][0], RAY_STEPS[i][1]);
+            }
+
+            tables.pawn[WHITE][square] = StepTarget(square, -1, 1) | StepTarget(square, 1, 1);
+            tables.pawn[BLACK][square] = StepTarget(square, -1, -1) | StepTarget(square, 1, -1);
+
+            for(int dir = 0; dir < N_RAY_DIRECTIONS; dir++)
+            {
+                const int file = RAY_STEPS[dir][0], rank = RAY_STEPS[dir][1];
+
+                for(int target = square; StepTarget(target, file, rank); target += rank * 8 + file)
+                    tables.ray[dir][square] |= StepTarget(target, file, rank);
+            }
+        }
+
+        for(int square = 0; square < 64; square++)
+            for(int dir = 0; dir < N_RAY_DIRECTIONS; dir++)
+            {
+                const int file = RAY_STEPS[dir][0], rank = RAY_STEPS[dir][1];
+                const Bitboard line = tables.ray[dir][square] | tables.ray[dir ^ 1][square] | SQUARE_BB(square);
+                Bitboard between = 0;
+
+                for(int target = square; StepTarget(target, file, rank); target += rank * 8 + file)
+                {
+                    const int next = target + rank * 8 + file;
+
+                    tables.between[square][next] = between;
+                    tables.line[square][next] = line;
+                    between |= SQUARE_BB(next);
+                }
+            }
+
+        return tables;
+    }
+}
+
+// Generated at compile time, see bitboard.cpp
+extern const BitboardTables BITBOARDS;
+
+inline Bitboard KnightAttacks(int square) { return BITBOARDS.knight[square]; }
+inline Bitboard KingAttacks(int square) { return BITBOARDS.king[square]; }
+inline Bitboard PawnAttacks(PieceColor color, int square) { return BITBOARDS.pawn[color][square]; }
+inline Bitboard Between(int a, int b) { return BITBOARDS.between[a][b]; }
+inline Bitboard Line(int a, int b) { return BITBOARDS.line[a][b]; }
+
+inline bool Aligned(int a, int b, int c) { return (BITBOARDS.line[a][b] & SQUARE_BB(c)) != 0; }
+
+// Slider attacks: each ray is cut at its first blocker, found with a single bit scan
+template<RayDirection Dir>
+inline Bitboard RayAttacks(int square, Bitboard occupied)
+{
+    Bitboard attacks = BITBOARDS.ray[Dir][square];
+    const Bitboard blockers = attacks & occupied;
+
+    if(blockers)
+        attacks ^= BITBOARDS.ray[Dir][(Dir & 1) ? LowestSquare(blockers) : HighestSquare(blockers)];
+
+    return attacks;
+}
+
+inline Bitboard BishopAttacks(int square, Bitboard occupied)
+{
+    return RayAttacks<RAY_SW>(square, occupied) | RayAttacks<RAY_NE>(square, occupied) |
+           RayAttacks<RAY_SE>(square, occupied) | RayAttacks<RAY_NW>(square, occupied);
+}
+
+inline Bitboard RookAttacks(int square, Bitboard occupied)
+{
+    return RayAttacks<RAY_W>(square, occupied) | RayAttacks<RAY_E>(square, occupied) |
+           RayAttacks<RAY_S>(square, occupied) | RayAttacks<RAY_N>(square, occupied);
+}
+
+#endif //CHEESENG_BITBOARD_H
@@ -0,0 +1,34 @@
+#include <cstring>
+
+#include "boardstate.hpp"
+#include "position.hpp"
+
+BoardState BoardStateFromPosition(const Position& pos)
+{
+    BoardState state;
+
+    state.zobristKey = pos.zobristKey;
+
+    for(int square = 0; square < BOARD_SIZE * BOARD_SIZE; square++)
+        state.board[square] = PieceCode(pos.position_grid[square % BOARD_SIZE][square / BOARD_SIZE]);
+
+    state.colorPlaying = static_cast<uint8_t>(pos.color_playing);
+
+    state.castling = 0;
+    for(int i = 0; i < 4; i++)
+        if(pos.castling_rights[i/2][i%2]) state.castling |= 1 << i;
+
+    state.enPassant = validCoord(pos.en_passant) ? static_cast<uint8_t>(SquareIndex(pos.en_passant)) : NO_SQUARE;
+
+    for(int color = WHITE; color <= BLACK; color++)
+    {
+        const Bitboard king = pos.pieces[color][KING];
+        state.kingSquares[color] = king ? static_cast<uint8_t>(LowestSquare(king)) : NO_SQUARE;
+    }
+
+    std::memset(state.reserved, 0, sizeof state.reserved);
+    state.halfmoveClock = static_cast<uint16_t>(pos.halfmoveClock);
+    state.fullmoveNumber = static_cast<uint16_t>(pos.fullmoveNumber);
+
+    return state;
+}
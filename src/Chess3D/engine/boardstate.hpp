@@ -0,0 +1,46 @@
+#ifndef CHEESENG_BOARDSTATE_H
+#define CHEESENG_BOARDSTATE_H
+
+#include <cstdint>
+#include <type_traits>
+
+#include "piecetypes.hpp"
+
+class Position;
+
+#define NO_SQUARE 0xFF
+
+// Compact copy of a position for search stacks, perft workers and datasets. Plain bytes only:
+// it can be memcpy'd, kept in std::vector or read straight from a mapped file.
+// The move list, metadata and repetition history of Position are not part of it.
+struct BoardState
+{
+    uint64_t zobristKey;
+    uint8_t board[64];          // PieceCode of each square, a1 = 0 ... h8 = 63
+    uint8_t colorPlaying;       // PieceColor
+    uint8_t castling;           // bit color * 2 + SHORT_CASTLE / LONG_CASTLE
+    uint8_t enPassant;          // square or NO_SQUARE
+    uint8_t kingSquares[2];     // [color], NO_SQUARE when missing
+    uint8_t reserved[7];        // zero, keeps the layout free of padding
+    uint16_t halfmoveClock;
+    uint16_t fullmoveNumber;
+};
+
+static_assert(sizeof(BoardState) == 88, "BoardState must stay compact and without padding");
+static_assert(std::is_trivially_copyable<BoardState>::value, "BoardState must be trivially copyable");
+static_assert(std::is_standard_layout<BoardState>::value, "BoardState is stored in files");
+
+// 0 for an empty square, 1 + color * 6 + type otherwise
+inline uint8_t PieceCode(Piece piece)
+{
+    return piece.type == NO_PIECE ? 0 : static_cast<uint8_t>(1 + piece.color * 6 + piece.type);
+}
+
+inline Piece PieceFromCode(uint8_t code)
+{
+    return code == 0 ? NO_PIECE_LITERAL : Piece{static_cast<PieceType>((code - 1) % 6), static_cast<PieceColor>((code - 1) / 6)};
+}
+
+BoardState BoardStateFromPosition(const Position& pos);
+
+#endif //CHEESENG_BOARDSTATE_H
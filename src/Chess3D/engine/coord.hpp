@@ -26,6 +26,10 @@ struct Coord
 bool validCoord(Coord coord);
 bool CoordEquals(Coord a, Coord b);
 
+// Square numbering used by the hash keys and the on-disk formats: a1 = 0, b1 = 1, ..., h8 = 63
+inline int SquareIndex(Coord coord) { return coord.rank * 8 + coord.file; }
+inline Coord CoordFromIndex(int square) { return Coord(square % 8, square / 8); }
+
 
 Coord CoordFromAlgebraic(const char *alg);
 
@@ -0,0 +1,304 @@
+#include <algorithm>
+#include <chrono>
+
+#include "dfpn.hpp"
+#include "movegen.hpp"
+
+#define DFPN_INFINITY 100000000u
+
+// Every search gets a distinct key per number of plies left, a proof with more plies is not one with fewer
+#define DFPN_PLY_KEY 0x9E3779B97F4A7C15ULL
+
+static inline uint64_t NodeKey(const Position& pos, int remaining)
+{
+    return pos.zobristKey ^ (DFPN_PLY_KEY * (remaining + 1));
+}
+
+static inline uint32_t SaturatingAdd(uint32_t a, uint32_t b)
+{
+    return a + b >= DFPN_INFINITY ? DFPN_INFINITY : a + b;
+}
+
+MateSolver::MateSolver(size_t megabytes) : bucketCount(0), attacker(WHITE), nodes(0), maxNodes(0), stopped(false)
+{
+    resize(megabytes);
+}
+
+void MateSolver::resize(size_t megabytes)
+{
+    size_t count = (megabytes ? megabytes : 1) * 1024 * 1024 / sizeof(Bucket);
+
+    if(count != bucketCount)
+    {
+        buckets.reset(new Bucket[count]);
+        bucketCount = count;
+    }
+
+    clear();
+}
+
+void MateSolver::clear()
+{
+    for(size_t i = 0; i < bucketCount; i++)
+        for(Entry& entry : buckets[i].entries) entry = Entry{0, 0, 0, 0};
+}
+
+bool MateSolver::probe(uint64_t key, uint32_t& pn, uint32_t& dn, uint64_t *work) const
+{
+    for(const Entry& entry : buckets[key % bucketCount].entries)
+    {
+        if(entry.key != key || (entry.pn == 0 && entry.dn == 0)) continue;
+
+        pn = entry.pn;
+        dn = entry.dn;
+        if(work) *work = entry.work;
+
+        return true;
+    }
+
+    return false;
+}
+
+// Solved nodes are worth keeping whatever they cost, open ones by the work spent on them
+void MateSolver::store(uint64_t key, uint32_t pn, uint32_t dn, uint64_t work)
+{
+    Entry *replace = nullptr;
+    uint64_t replaceWork = UINT64_MAX;
+
+    for(Entry& entry : buckets[key % bucketCount].entries)
+    {
+        if(entry.key == key || (entry.pn == 0 && entry.dn == 0))
+        {
+            replace = &entry;
+            break;
+        }
+
+        const uint64_t value = entry.pn == 0 || entry.dn == 0 ? UINT64_MAX - 1 : entry.work;
+
+        if(value < replaceWork)
+        {
+            replaceWork = value;
+            replace = &entry;
+        }
+    }
+
+    *replace = Entry{key, pn, dn, work};
+}
+
+// Proof and disproof numbers of the nodes decided without a search: mates, draws and the attacker out of
+// plies. Only positions in check are tested for legal moves; stalemates are found when mid expands them.
+bool MateSolver::terminal(Position& pos, int remaining, uint32_t& pn, uint32_t& dn) const
+{
+    const bool attacking = pos.color_playing == attacker;
+    const bool inCheck = pos.checkers() != 0;
+    bool proven;
+
+    if(pos.halfmoveClock >= 100 || pos.isRepetition(2))
+        proven = false;
+    else if(inCheck && !pos.hasAnyLegalMove())
+        proven = !attacking;
+    else if(remaining == 0)
+        proven = false;
+    else
+        return false;
+
+    pn = proven ? 0 : DFPN_INFINITY;
+    dn = proven ? DFPN_INFINITY : 0;
+
+    return true;
+}
+
+void MateSolver::childNumbers(Position& pos, PackedMove move, int remaining, uint32_t& pn, uint32_t& dn)
+{
+    MoveUndo undo;
+    pos.makeMove(move, undo);
+
+    const uint64_t key = NodeKey(pos, remaining);
+
+    if(!probe(key, pn, dn))
+    {
+        if(terminal(pos, remaining, pn, dn))
+            store(key, pn, dn, 0);
+        else
+            pn = dn = 1;
+    }
+
+    pos.unmakeMove(undo);
+}
+
+// Multiple iterative deepening: search below the node until its phi or delta reaches the threshold. At an OR
+// node (attacker to move) phi is the proof number and delta the disproof number, at an AND node the reverse;
+// a node's phi is the smallest delta of its children and its delta the sum of their phis.
+void MateSolver::mid(Position& pos, int remaining, uint32_t thPhi, uint32_t thDelta, uint32_t& pn, uint32_t& dn)
+{
+    const bool orNode = pos.color_playing == attacker;
+    const uint64_t key = NodeKey(pos, remaining);
+    const uint64_t startNodes = nodes++;
+
+    MoveList moves;
+    GenerateLegalMoves(pos, moves);
+
+    // Stalemate
+    if(moves.size() == 0)
+    {
+        pn = DFPN_INFINITY;
+        dn = 0;
+        store(key, pn, dn, 1);
+        return;
+    }
+
+    uint32_t childPhi[MAX_MOVES], childDelta[MAX_MOVES];
+
+    for(int i = 0; i < moves.size(); i++)
+    {
+        uint32_t cpn, cdn;
+        childNumbers(pos, moves[i], remaining - 1, cpn, cdn);
+
+        // The children are of the other kind
+        childPhi[i] = orNode ? cdn : cpn;
+        childDelta[i] = orNode ? cpn : cdn;
+    }
+
+    uint32_t phi, delta;
+
+    while(true)
+    {
+        phi = DFPN_INFINITY;
+        delta = 0;
+
+        int best = 0;
+        uint32_t secondDelta = DFPN_INFINITY;
+
+        for(int i = 0; i < moves.size(); i++)
+        {
+            delta = SaturatingAdd(delta, childPhi[i]);
+
+            if(childDelta[i] < phi)
+            {
+                secondDelta = phi;
+                phi = childDelta[i];
+                best = i;
+            }
+            else if(childDelta[i] < secondDelta)
+            {
+                secondDelta = childDelta[i];
+            }
+        }
+
+        if(phi >= thPhi || delta >= thDelta || stopped) break;
+
+        if(maxNodes && nodes >= maxNodes)
+        {
+            stopped = true;
+            break;
+        }
+
+        // The best child is searched until its delta passes the second best's, with a quarter of slack
+        // against switching back and forth (the 1 + epsilon trick), or its phi pushes our delta over the threshold
+        const uint64_t childThPhi = static_cast<uint64_t>(thDelta) - delta + childPhi[best];
+        const uint64_t childThDelta = std::min<uint64_t>(thPhi, secondDelta + secondDelta / 4 + 1);
+
+        MoveUndo undo;
+        pos.makeMove(moves[best], undo);
+
+        uint32_t cpn, cdn;
+        mid(pos, remaining - 1, static_cast<uint32_t>(std::min<uint64_t>(childThPhi, DFPN_INFINITY)),
+            static_cast<uint32_t>(std::min<uint64_t>(childThDelta, DFPN_INFINITY)), cpn, cdn);
+
+        pos.unmakeMove(undo);
+
+        childPhi[best] = orNode ? cdn : cpn;
+        childDelta[best] = orNode ? cpn : cdn;
+    }
+
+    pn = orNode ? phi : delta;
+    dn = orNode ? delta : phi;
+
+    store(key, pn, dn, nodes - startNodes);
+}
+
+// Follow the proofs: the proving move for the attacker, the most stubborn defence for the defender
+void MateSolver::principalVariation(Position& pos, int remaining, std::vector<PackedMove>& pv)
+{
+    if(remaining == 0) return;
+
+    MoveList moves;
+    GenerateLegalMoves(pos, moves);
+
+    PackedMove chosen = NULL_PACKED_MOVE;
+    uint64_t chosenWork = 0;
+
+    for(PackedMove move : moves)
+    {
+        MoveUndo undo;
+        pos.makeMove(move, undo);
+
+        uint32_t pn, dn;
+        uint64_t work = 0;
+        const bool known = probe(NodeKey(pos, remaining - 1), pn, dn, &work) || terminal(pos, remaining - 1, pn, dn);
+
+        pos.unmakeMove(undo);
+
+        if(!known || pn != 0) continue;
+
+        if(chosen == NULL_PACKED_MOVE || (pos.color_playing != attacker && work > chosenWork))
+        {
+            chosen = move;
+            chosenWork = work;
+        }
+
+        if(pos.color_playing == attacker) break;
+    }
+
+    if(chosen == NULL_PACKED_MOVE) return;
+
+    pv.push_back(chosen);
+
+    MoveUndo undo;
+    pos.makeMove(chosen, undo);
+    principalVariation(pos, remaining - 1, pv);
+    pos.unmakeMove(undo);
+}
+
+MateResult MateSolver::solve(const Position& root, int maxMoves, uint64_t nodeLimit)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    Position pos = root;
+    pos.keyHistory.reserve(pos.keyHistory.size() + 2 * maxMoves + 1);
+
+    attacker = root.color_playing;
+    nodes = 0;
+    maxNodes = nodeLimit;
+    stopped = false;
+
+    MateResult result = {MATE_NONE, 0, {}, 0, 0};
+
+    if(pos.hasAnyLegalMove())
+    {
+        for(int moves = 1; moves <= maxMoves; moves++)
+        {
+            uint32_t pn, dn;
+            mid(pos, 2 * moves - 1, DFPN_INFINITY, DFPN_INFINITY, pn, dn);
+
+            if(pn == 0)
+            {
+                result.status = MATE_FOUND;
+                result.mateIn = moves;
+                principalVariation(pos, 2 * moves - 1, result.pv);
+                break;
+            }
+
+            if(stopped)
+            {
+                result.status = MATE_UNKNOWN;
+                break;
+            }
+        }
+    }
+
+    result.nodes = nodes;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    return result;
+}
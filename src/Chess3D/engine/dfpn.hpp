@@ -0,0 +1,67 @@
+#ifndef CHEESENG_DFPN_H
+#define CHEESENG_DFPN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "move.hpp"
+#include "position.hpp"
+
+enum MateStatus{MATE_FOUND, MATE_NONE, MATE_UNKNOWN};
+
+struct MateResult
+{
+    MateStatus status;
+    int mateIn;                     // moves of the side to move, with MATE_FOUND
+    std::vector<PackedMove> pv;
+    uint64_t nodes;
+    double seconds;
+};
+
+// Depth-first proof-number search for forced mates of the side to move. Proof and disproof numbers live in
+// the solver's own table, keyed by position and the plies left. Draws by repetition are treated as
+// disproofs wherever they are found, which can miss a mate through a transposition in rare cases.
+class MateSolver
+{
+public:
+    explicit MateSolver(size_t megabytes=16);
+
+    void resize(size_t megabytes);
+    void clear();
+
+    // The shortest mate in at most maxMoves moves; mate lengths are tried in increasing order.
+    // MATE_UNKNOWN when maxNodes (0: no limit) ran out first.
+    MateResult solve(const Position& root, int maxMoves, uint64_t maxNodes=0);
+
+private:
+    struct Entry
+    {
+        uint64_t key;
+        uint32_t pn, dn;
+        uint64_t work;              // nodes spent on it, the smallest is replaced first
+    };
+
+    struct Bucket
+    {
+        Entry entries[4];
+    };
+
+    bool probe(uint64_t key, uint32_t& pn, uint32_t& dn, uint64_t *work=nullptr) const;
+    void store(uint64_t key, uint32_t pn, uint32_t dn, uint64_t work);
+
+    bool terminal(Position& pos, int remaining, uint32_t& pn, uint32_t& dn) const;
+    void childNumbers(Position& pos, PackedMove move, int remaining, uint32_t& pn, uint32_t& dn);
+    void mid(Position& pos, int remaining, uint32_t thPhi, uint32_t thDelta, uint32_t& pn, uint32_t& dn);
+    void principalVariation(Position& pos, int remaining, std::vector<PackedMove>& pv);
+
+    std::unique_ptr<Bucket[]> buckets;
+    size_t bucketCount;
+
+    PieceColor attacker;
+    uint64_t nodes, maxNodes;
+    bool stopped;
+};
+
+#endif //CHEESENG_DFPN_H
@@ -0,0 +1,83 @@
+#include <cctype>
+#include <fstream>
+#include <sstream>
+
+#include "epd.hpp"
+#include "pgn.hpp"
+
+static bool IsNumber(const std::string& text)
+{
+    if(text.empty()) return false;
+
+    for(char c : text)
+        if(!std::isdigit(static_cast<unsigned char>(c))) return false;
+
+    return true;
+}
+
+bool ParseEpdLine(const std::string& line, EpdRecord& record)
+{
+    std::istringstream in(line);
+    std::string placement, side, castling, enPassant;
+
+    if(!(in >> placement >> side >> castling >> enPassant)) return false;
+
+    std::string halfmove = "0", fullmove = "1";
+    std::streampos operations = in.tellg();
+    std::string first, second;
+
+    // A FEN line goes on with its two counters
+    if(in >> first >> second && IsNumber(first) && IsNumber(second))
+    {
+        halfmove = first;
+        fullmove = second;
+        operations = in.tellg();
+    }
+
+    record.fen = placement + " " + side + " " + castling + " " + enPassant + " " + halfmove + " " + fullmove;
+    record.operations = operations == std::streampos(-1) ? "" : line.substr(static_cast<size_t>(operations));
+
+    const size_t begin = record.operations.find_first_not_of(" \t");
+    record.operations = begin == std::string::npos ? "" : record.operations.substr(begin);
+
+    return PlausibleFEN(record.fen);
+}
+
+std::string EpdOperation(const EpdRecord& record, const std::string& name)
+{
+    const std::string& operations = record.operations;
+    size_t at = 0;
+
+    while((at = operations.find(name + " ", at)) != std::string::npos)
+    {
+        if(at == 0 || operations[at - 1] == ' ' || operations[at - 1] == ';')
+        {
+            const size_t begin = at + name.size() + 1, end = operations.find(';', begin);
+            std::string value = operations.substr(begin, end == std::string::npos ? std::string::npos : end - begin);
+
+            while(!value.empty() && value.back() == ' ') value.pop_back();
+            if(value.size() >= 2 && value.front() == '"' && value.back() == '"') value = value.substr(1, value.size() - 2);
+
+            return value;
+        }
+
+        at++;
+    }
+
+    return "";
+}
+
+bool LoadEpdPositions(const std::string& path, std::vector<std::string>& fens)
+{
+    std::ifstream file(path);
+    if(!file) return false;
+
+    std::string line;
+    while(std::getline(file, line))
+    {
+        EpdRecord record;
+        if(ParseEpdLine(line, record)) fens.push_back(record.fen);
+    }
+
+    return true;
+}
@@ -0,0 +1,24 @@
+#ifndef CHEESENG_EPD_H
+#define CHEESENG_EPD_H
+
+#include <string>
+#include <vector>
+
+// One line of an EPD file: the four position fields of a FEN and the operations after them
+// ("bm Qxf7#; dm 1; id "x";"). A full FEN line is read as well, its move counters kept.
+struct EpdRecord
+{
+    std::string fen;            // always six fields, "0 1" when the line had no counters
+    std::string operations;
+};
+
+bool ParseEpdLine(const std::string& line, EpdRecord& record);
+
+// The value of an operation without its quotes, empty when the line does not have it
+std::string EpdOperation(const EpdRecord& record, const std::string& name);
+
+// Append the positions of an EPD file (an opening book) in file order, skipping unreadable lines.
+// False when the file cannot be opened.
+bool LoadEpdPositions(const std::string& path, std::vector<std::string>& fens);
+
+#endif //CHEESENG_EPD_H
@@ -0,0 +1,251 @@
+#include "evaluate.hpp"
+#include "bitboard.hpp"
+#include "evaltables.hpp"
+#include "stats.hpp"
+
+// Entries of the per thread caches, powers of two
+#define PAWN_TABLE_SIZE 8192
+#define EVAL_CACHE_SIZE 32768
+
+// The score is kept in the low 16 bits of an evaluation cache entry, the rest is the top of the key
+#define EVAL_CACHE_KEY_MASK (~0xFFFFULL)
+
+// Game phase contributed by each piece type, 24 with all pieces on the board
+static const int PHASE_WEIGHT[6] = {0, 1, 1, 2, 4, 0};
+
+// Central squares of each side's ranks 2 to 4, counted for space
+static const Bitboard SPACE_AREA[PLAYER_COUNT] = {0x000000003C3C3C00ULL, 0x003C3C3C00000000ULL};
+
+// Pawn structure scores depend on the pawns only and are found again for most positions of a search
+struct PawnEntry
+{
+    uint64_t key;
+    int mg, eg;                         // white's terms minus black's
+    Bitboard passed[PLAYER_COUNT];
+};
+
+// Zeroed, so an unused entry reads as the position without pawns: key 0, no terms and no passed pawns
+static thread_local PawnEntry pawnTable[PAWN_TABLE_SIZE];
+static thread_local uint64_t evalCache[EVAL_CACHE_SIZE];
+
+int PieceValue(PieceType type)
+{
+    return type == NO_PIECE ? 0 : MG_VALUE[type];
+}
+
+int GamePhase(const Position& pos)
+{
+    int phase = 0;
+
+    for(int type = KNIGHT; type <= QUEEN; type++)
+        phase += PHASE_WEIGHT[type] * PopCount(pos.pieces[WHITE][type] | pos.pieces[BLACK][type]);
+
+    return phase > MAX_PHASE ? MAX_PHASE : phase;
+}
+
+// The squares in front of a pawn on its file, from its own side
+static Bitboard FrontSpan(int color, int square)
+{
+    return BITBOARDS.ray[color == WHITE ? RAY_N : RAY_S][square];
+}
+
+// Every term that depends on the pawns alone, with the passed pawns of each side
+static void PawnTermCounts(const Position& pos, int counts[TERM_COUNT], Bitboard passed[PLAYER_COUNT])
+{
+    for(int color = WHITE; color <= BLACK; color++)
+    {
+        const int sign = color == WHITE ? 1 : -1;
+        const Bitboard ours = pos.pieces[color][PAWN], theirs = pos.pieces[OTHER_COLOR(color)][PAWN];
+
+        passed[color] = 0;
+
+        for(Bitboard b = ours; b; )
+        {
+            const int square = PopLowestSquare(b), file = square & 7;
+            const Bitboard front = FrontSpan(color, square);
+            const Bitboard neighbours = (file > FILE_A ? FILE_A_BB << (file - 1) : 0) | (file < FILE_H ? FILE_A_BB << (file + 1) : 0);
+
+            // Squares the pawn passes on its way, and those enemy pawns on the next files could take it on
+            Bitboard span = front;
+            if(file > FILE_A) span |= FrontSpan(color, square - 1);
+            if(file < FILE_H) span |= FrontSpan(color, square + 1);
+
+            if(front & ours) counts[TERM_DOUBLED_PAWN] += sign;
+            if(!(neighbours & ours)) counts[TERM_ISOLATED_PAWN] += sign;
+
+            if(!(span & theirs) && !(front & ours))
+            {
+                const int rank = color == WHITE ? square >> 3 : 7 - (square >> 3);
+
+                counts[TERM_PASSED_PAWN + rank] += sign;
+                passed[color] |= SQUARE_BB(square);
+            }
+        }
+    }
+}
+
+// Passed pawns free to advance, which changes with every piece move and is left out of the pawn table
+static void FreePassedCounts(const Position& pos, const Bitboard passed[PLAYER_COUNT], int counts[TERM_COUNT])
+{
+    const Bitboard occupied = pos.occupancy[WHITE] | pos.occupancy[BLACK];
+
+    counts[TERM_FREE_PASSED_PAWN] = PopCount(Shift<8>(passed[WHITE]) & ~occupied) - PopCount(Shift<-8>(passed[BLACK]) & ~occupied);
+}
+
+static Bitboard PawnAttacksOf(int color, Bitboard pawns)
+{
+    return color == WHITE ? Shift<7>(pawns & ~FILE_A_BB) | Shift<9>(pawns & ~FILE_H_BB)
+                          : Shift<-9>(pawns & ~FILE_A_BB) | Shift<-7>(pawns & ~FILE_H_BB);
+}
+
+static Bitboard KingZone(const Position& pos, int color)
+{
+    const Bitboard king = pos.pieces[color][KING];
+    return king ? KingAttacks(LowestSquare(king)) : 0;
+}
+
+// Mobility, king attacks, threats and space, from the squares every piece attacks: one pass over the
+// pieces of each side builds its attack map and counts the per piece terms with popcounts on the way
+static void PieceTermCounts(const Position& pos, int counts[TERM_COUNT])
+{
+    const Bitboard occupied = pos.occupied();
+    Bitboard pawnAttacks[PLAYER_COUNT], attacks[PLAYER_COUNT];
+
+    for(int color = WHITE; color <= BLACK; color++)
+        pawnAttacks[color] = PawnAttacksOf(color, pos.pieces[color][PAWN]);
+
+    for(int color = WHITE; color <= BLACK; color++)
+    {
+        const int sign = color == WHITE ? 1 : -1, them = OTHER_COLOR(color);
+
+        // Squares worth going to: not taken by a piece of the same color, nor where an enemy pawn takes
+        const Bitboard area = ~pos.occupancy[color] & ~pawnAttacks[them];
+        const Bitboard kingZone = KingZone(pos, them);
+
+        attacks[color] = pawnAttacks[color] | KingZone(pos, color);
+
+        for(int type = KNIGHT; type <= QUEEN; type++)
+        {
+            for(Bitboard b = pos.pieces[color][type]; b; )
+            {
+                const int square = PopLowestSquare(b);
+                const Bitboard reach = type == KNIGHT ? KnightAttacks(square) :
+                                       type == BISHOP ? BishopAttacks(square, occupied) :
+                                       type == ROOK   ? RookAttacks(square, occupied) :
+                                                        BishopAttacks(square, occupied) | RookAttacks(square, occupied);
+
+                attacks[color] |= reach;
+                counts[TERM_MOBILITY + type - KNIGHT] += sign * PopCount(reach & area);
+                counts[TERM_KING_ATTACK + type - KNIGHT] += sign * PopCount(reach & kingZone);
+            }
+        }
+    }
+
+    for(int color = WHITE; color <= BLACK; color++)
+    {
+        const int sign = color == WHITE ? 1 : -1, them = OTHER_COLOR(color);
+        const Bitboard targets = pos.occupancy[them] & ~pos.pieces[them][PAWN] & ~pos.pieces[them][KING];
+
+        counts[TERM_PAWN_THREAT] += sign * PopCount(pawnAttacks[color] & targets);
+        counts[TERM_HANGING] += sign * PopCount(attacks[color] & ~attacks[them] & targets);
+        counts[TERM_SPACE] += sign * PopCount(SPACE_AREA[color] & ~pos.pieces[color][PAWN] & ~pawnAttacks[them]);
+    }
+}
+
+static const PawnEntry& ProbePawnTable(const Position& pos)
+{
+    PawnEntry& entry = pawnTable[pos.pawnKey & (PAWN_TABLE_SIZE - 1)];
+
+    STAT_INC(STAT_PAWN_PROBES);
+
+    if(entry.key == pos.pawnKey)
+    {
+        STAT_INC(STAT_PAWN_HITS);
+        return entry;
+    }
+
+    int counts[TERM_COUNT] = {};
+    PawnTermCounts(pos, counts, entry.passed);
+
+    entry.key = pos.pawnKey;
+    entry.mg = entry.eg = 0;
+
+    for(int term = 0; term < TERM_COUNT; term++)
+    {
+        entry.mg += counts[term] * MG_TERMS[term];
+        entry.eg += counts[term] * EG_TERMS[term];
+    }
+
+    return entry;
+}
+
+void EvalTermCounts(const Position& pos, int counts[TERM_COUNT])
+{
+    Bitboard passed[PLAYER_COUNT];
+
+    for(int term = 0; term < TERM_COUNT; term++) counts[term] = 0;
+
+    PawnTermCounts(pos, counts, passed);
+    FreePassedCounts(pos, passed, counts);
+    PieceTermCounts(pos, counts);
+}
+
+int Evaluate(const Position& pos)
+{
+    uint64_t& cached = evalCache[pos.zobristKey & (EVAL_CACHE_SIZE - 1)];
+
+    STAT_INC(STAT_EVAL_PROBES);
+
+    if(((cached ^ pos.zobristKey) & EVAL_CACHE_KEY_MASK) == 0)
+    {
+        STAT_INC(STAT_EVAL_HITS);
+        return static_cast<int16_t>(cached & 0xFFFF);
+    }
+
+    int mg[PLAYER_COUNT] = {0, 0}, eg[PLAYER_COUNT] = {0, 0};
+    int phase = 0;
+
+    for(int color = WHITE; color <= BLACK; color++)
+    {
+        for(int type = PAWN; type <= KING; type++)
+        {
+            for(Bitboard b = pos.pieces[color][type]; b; )
+            {
+                // The tables are from white's side, black reads them mirrored vertically
+                const int square = PopLowestSquare(b) ^ (color == WHITE ? 0 : 56);
+
+                mg[color] += MG_VALUE[type] + MG_PST[type][square];
+                eg[color] += EG_VALUE[type] + EG_PST[type][square];
+                phase += PHASE_WEIGHT[type];
+            }
+        }
+    }
+
+    if(phase > MAX_PHASE) phase = MAX_PHASE;
+
+    const PawnEntry& pawns = ProbePawnTable(pos);
+
+    int counts[TERM_COUNT] = {};
+    FreePassedCounts(pos, pawns.passed, counts);
+    PieceTermCounts(pos, counts);
+
+    int mgScore = mg[WHITE] - mg[BLACK] + pawns.mg, egScore = eg[WHITE] - eg[BLACK] + pawns.eg;
+
+    for(int term = TERM_FREE_PASSED_PAWN; term < TERM_COUNT; term++)
+    {
+        mgScore += counts[term] * MG_TERMS[term];
+        egScore += counts[term] * EG_TERMS[term];
+    }
+
+    if(pos.color_playing == BLACK)
+    {
+        mgScore = -mgScore;
+        egScore = -egScore;
+    }
+
+    const int score = (mgScore * phase + egScore * (MAX_PHASE - phase)) / MAX_PHASE;
+
+    cached = (pos.zobristKey & EVAL_CACHE_KEY_MASK) | static_cast<uint16_t>(score);
+
+    return score;
+}
@@ -0,0 +1,40 @@
+#ifndef CHEESENG_EVALUATE_H
+#define CHEESENG_EVALUATE_H
+
+#include "position.hpp"
+
+// Centipawns, from the side to move's point of view
+#define PAWN_VALUE 100
+
+// Game phase of all the pieces on the board, down to 0 with only pawns and kings
+#define MAX_PHASE 24
+
+// Terms besides the tables, weighted by MG_TERMS and EG_TERMS of evaltables.hpp
+enum EvalTerm
+{
+    TERM_DOUBLED_PAWN,                              // a pawn of the same color further up its file
+    TERM_ISOLATED_PAWN,                             // no pawn of the same color on the files next to it
+    TERM_PASSED_PAWN,                               // by the rank from its own side, TERM_PASSED_PAWN + 1 ... + 6
+    TERM_FREE_PASSED_PAWN = TERM_PASSED_PAWN + 8,   // passed with the square in front of it empty
+    TERM_MOBILITY,                                  // per square a piece reaches, TERM_MOBILITY + type - KNIGHT
+    TERM_KING_ATTACK = TERM_MOBILITY + 4,           // per square next to the enemy king a piece reaches, the same way
+    TERM_PAWN_THREAT = TERM_KING_ATTACK + 4,        // an enemy piece attacked by a pawn
+    TERM_HANGING,                                   // an enemy piece attacked and not defended
+    TERM_SPACE,                                     // a central square on its own side, free of its pawns and safe from enemy ones
+    TERM_COUNT
+};
+
+// Material, piece square tables, pawn structure, mobility and king safety, blended between middlegame and endgame
+// by the material left. Pawn terms are cached per thread by the pawn key and whole evaluations by the position key.
+int Evaluate(const Position& pos);
+
+// How often each term applies to white minus how often to black, the features the tuner weighs
+void EvalTermCounts(const Position& pos, int counts[TERM_COUNT]);
+
+// The weight of the middlegame scores, MAX_PHASE - GamePhase that of the endgame ones
+int GamePhase(const Position& pos);
+
+// Midgame value of a piece type, for move ordering and pruning margins
+int PieceValue(PieceType type);
+
+#endif //CHEESENG_EVALUATE_H
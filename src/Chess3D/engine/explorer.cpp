@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "explorer.hpp"
+
+static const char EXPLORER_MAGIC[8] = {'C', '3', 'D', 'E', 'X', 'P', 'L', 'R'};
+
+struct ExplorerKey
+{
+    uint64_t key;
+    PackedMove move;
+
+    bool operator==(const ExplorerKey& other) const { return key == other.key && move == other.move; }
+};
+
+struct ExplorerKeyHash
+{
+    size_t operator()(const ExplorerKey& k) const { return static_cast<size_t>(k.key ^ (static_cast<uint64_t>(k.move) * 0x9E3779B97F4A7C15ULL)); }
+};
+
+typedef std::unordered_map<ExplorerKey, ExplorerRecord, ExplorerKeyHash> ExplorerMap;
+
+static void AddRecord(ExplorerRecord& into, const ExplorerRecord& from)
+{
+    into.ratingSum += from.ratingSum;
+    into.games += from.games;
+    into.whiteWins += from.whiteWins;
+    into.draws += from.draws;
+    into.blackWins += from.blackWins;
+    into.ratedGames += from.ratedGames;
+}
+
+static void CountGame(const GameRecord& game, int maxPly, ExplorerMap& map)
+{
+    Position pos(game.startFEN.empty() ? PGN_STARTING_FEN : game.startFEN);
+
+    const int plies = std::min(maxPly, static_cast<int>(game.moves.size()));
+
+    for(int ply = 0; ply < plies; ply++)
+    {
+        Move move;
+        if(!MoveFromIndex(pos, game.moves[ply], move)) return;
+
+        ExplorerRecord& record = map[ExplorerKey{pos.zobristKey, PackMove(move)}];
+        const int elo = pos.color_playing == WHITE ? game.whiteElo : game.blackElo;
+
+        record.games++;
+        record.whiteWins += game.result == RESULT_WHITE_WINS;
+        record.draws += game.result == RESULT_DRAW;
+        record.blackWins += game.result == RESULT_BLACK_WINS;
+
+        if(elo > 0)
+        {
+            record.ratedGames++;
+            record.ratingSum += elo;
+        }
+
+        pos.applyMove(move);
+    }
+}
+
+static bool RecordOrder(const ExplorerRecord& a, const ExplorerRecord& b)
+{
+    return a.key != b.key ? a.key < b.key : a.move < b.move;
+}
+
+bool BuildExplorer(const GameDatabase& db, const std::string& path, int maxPly, int threads)
+{
+    if(threads < 1) threads = 1;
+
+    const size_t games = db.gameCount();
+    std::vector<ExplorerMap> maps(threads);
+
+    auto worker = [&](int id)
+    {
+        GameRecord game;
+
+        for(size_t i = games * id / threads; i < games * (id + 1) / threads; i++)
+        {
+            if(db.readGame(static_cast<uint32_t>(i), game)) CountGame(game, maxPly, maps[id]);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for(int i = 0; i < threads; i++) workers.emplace_back(worker, i);
+    for(std::thread& t : workers) t.join();
+
+    // Merge the per-thread maps into the first one
+    for(int i = 1; i < threads; i++)
+    {
+        for(const auto& entry : maps[i])
+        {
+            auto inserted = maps[0].insert(entry);
+            if(!inserted.second) AddRecord(inserted.first->second, entry.second);
+        }
+
+        ExplorerMap().swap(maps[i]);
+    }
+
+    std::vector<ExplorerRecord> records;
+    records.reserve(maps[0].size());
+
+    for(const auto& entry : maps[0])
+    {
+        ExplorerRecord record = entry.second;
+        record.key = entry.first.key;
+        record.move = entry.first.move;
+        record.reserved = 0;
+        records.push_back(record);
+    }
+
+    ExplorerMap().swap(maps[0]);
+    std::sort(records.begin(), records.end(), RecordOrder);
+
+    FILE *out = std::fopen(path.c_str(), "wb");
+    if(!out) return false;
+
+    ExplorerHeader header;
+    std::memcpy(header.magic, EXPLORER_MAGIC, sizeof header.magic);
+    header.version = EXPLORER_VERSION;
+    header.maxPly = maxPly;
+    header.recordCount = records.size();
+
+    std::fwrite(&header, sizeof header, 1, out);
+    std::fwrite(records.data(), sizeof(ExplorerRecord), records.size(), out);
+
+    bool ok = std::ferror(out) == 0;
+    std::fclose(out);
+
+    return ok;
+}
+
+bool ExplorerFile::open(const std::string& path)
+{
+    header = nullptr;
+    records = nullptr;
+
+    if(!file.open(path, ACCESS_RANDOM) || file.size() < sizeof(ExplorerHeader)) return false;
+
+    const ExplorerHeader *h = reinterpret_cast<const ExplorerHeader *>(file.data());
+
+    if(std::memcmp(h->magic, EXPLORER_MAGIC, sizeof h->magic) != 0 || h->version != EXPLORER_VERSION ||
+       sizeof(ExplorerHeader) + h->recordCount * sizeof(ExplorerRecord) > file.size())
+        return false;
+
+    header = h;
+    records = reinterpret_cast<const ExplorerRecord *>(file.data() + sizeof(ExplorerHeader));
+
+    return true;
+}
+
+void ExplorerFile::find(uint64_t key, const ExplorerRecord *& first, const ExplorerRecord *& last) const
+{
+    first = last = records;
+    if(!header) return;
+
+    ExplorerRecord probe = {};
+    probe.key = key;
+
+    auto range = std::equal_range(records, records + header->recordCount, probe,
+                                  [](const ExplorerRecord& a, const ExplorerRecord& b) { return a.key < b.key; });
+
+    first = range.first;
+    last = range.second;
+}
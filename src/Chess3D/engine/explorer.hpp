@@ -0,0 +1,57 @@
+#ifndef CHEESENG_EXPLORER_H
+#define CHEESENG_EXPLORER_H
+
+#include <cstdint>
+#include <string>
+
+#include "gamedb.hpp"
+#include "mappedfile.hpp"
+#include "move.hpp"
+
+// Opening explorer: per (position, move) statistics over a game database,
+// written as records sorted by (key, move) and queried from a memory mapping.
+
+#define EXPLORER_VERSION 1
+
+struct ExplorerRecord
+{
+    uint64_t key;
+    uint64_t ratingSum;   // Elo of the player making the move, summed over rated games
+    uint32_t games;
+    uint32_t whiteWins, draws, blackWins;
+    uint32_t ratedGames;
+    PackedMove move;
+    uint16_t reserved;
+
+    double averageRating() const { return ratedGames ? static_cast<double>(ratingSum) / ratedGames : 0; }
+};
+
+struct ExplorerHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t maxPly;
+    uint64_t recordCount;
+};
+
+// Aggregate the first maxPly moves of every game on `threads` workers and write the sorted result
+bool BuildExplorer(const GameDatabase& db, const std::string& path, int maxPly, int threads);
+
+class ExplorerFile
+{
+public:
+    bool open(const std::string& path);
+
+    size_t size() const { return header ? header->recordCount : 0; }
+    int maxPly() const { return header ? header->maxPly : 0; }
+
+    // Records of every move played from the position with this key, in O(log n)
+    void find(uint64_t key, const ExplorerRecord *& first, const ExplorerRecord *& last) const;
+
+private:
+    MappedFile file;
+    const ExplorerHeader *header = nullptr;
+    const ExplorerRecord *records = nullptr;
+};
+
+#endif //CHEESENG_EXPLORER_H
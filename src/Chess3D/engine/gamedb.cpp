@@ -0,0 +1,549 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <queue>
+#include <thread>
+
+#include "gamedb.hpp"
+#include "san.hpp"
+
+static const char GAMEDB_MAGIC[8]  = {'C', '3', 'D', 'G', 'A', 'M', 'E', 'S'};
+static const char INDEX_MAGIC[8]   = {'C', '3', 'D', 'I', 'N', 'D', 'E', 'X'};
+
+// Games converted per parallel import step, bounds the memory held by encoded records
+static const size_t IMPORT_BLOCK_SIZE = 1 << 16;
+
+// Record flags
+#define RECORD_CUSTOM_START 1
+
+static int MoveSortKey(const Move& move)
+{
+    return (SquareIndex(move.from) * 64 + SquareIndex(move.to)) * 8 + (move.promotionType + 1);
+}
+
+static bool MoveSortOrder(const Move& a, const Move& b)
+{
+    return MoveSortKey(a) < MoveSortKey(b);
+}
+
+void SortedLegalMoves(Position& pos, std::vector<Move>& out)
+{
+    out = pos.createLegalMoves();
+    std::sort(out.begin(), out.end(), MoveSortOrder);
+}
+
+int MoveToIndex(Position& pos, const Move& move)
+{
+    std::vector<Move> moves;
+    SortedLegalMoves(pos, moves);
+
+    for(size_t i = 0; i < moves.size(); i++)
+    {
+        if(CoordEquals(moves[i].from, move.from) && CoordEquals(moves[i].to, move.to) &&
+           moves[i].promotionType == move.promotionType)
+            return static_cast<int>(i);
+    }
+
+    return -1;
+}
+
+bool MoveFromIndex(Position& pos, int index, Move& out)
+{
+    std::vector<Move> moves;
+    SortedLegalMoves(pos, moves);
+
+    if(index < 0 || index >= static_cast<int>(moves.size())) return false;
+
+    out = moves[index];
+    return true;
+}
+
+GameResult GameResultFromString(const std::string& result)
+{
+    if(result == "1-0") return RESULT_WHITE_WINS;
+    if(result == "0-1") return RESULT_BLACK_WINS;
+    if(result == "1/2-1/2") return RESULT_DRAW;
+
+    return RESULT_UNKNOWN;
+}
+
+const char *GameResultString(GameResult result)
+{
+    static const char *RESULT_STRINGS[] = {"*", "1-0", "1/2-1/2", "0-1"};
+
+    return RESULT_STRINGS[result];
+}
+
+const std::string *GameRecord::getTag(const std::string& name) const
+{
+    for(const PgnTag& tag : tags)
+        if(tag.name == name) return &tag.value;
+
+    return nullptr;
+}
+
+bool GameRecordFromPgn(const PgnGame& game, GameRecord& record, PgnError *error)
+{
+    const std::string *resultTag = game.getTag("Result");
+    const std::string *whiteElo = game.getTag("WhiteElo");
+    const std::string *blackElo = game.getTag("BlackElo");
+    const std::string *fen = game.getTag("FEN");
+
+    record.result = GameResultFromString(resultTag ? *resultTag : game.result);
+    record.whiteElo = whiteElo ? std::atoi(whiteElo->c_str()) : 0;
+    record.blackElo = blackElo ? std::atoi(blackElo->c_str()) : 0;
+    record.startFEN = fen ? *fen : "";
+    record.tags = game.tags;
+    record.moves.clear();
+
+    if(fen && !PlausibleFEN(*fen))
+    {
+        if(error) *error = PgnError{game.index, 0, game.line, 1, "", "bad FEN tag"};
+        return false;
+    }
+
+    if(fen && fen->size() > GAMEDB_MAX_FEN)
+    {
+        if(error) *error = PgnError{game.index, 0, game.line, 1, "", "FEN tag too long"};
+        return false;
+    }
+
+    Position pos(fen ? *fen : PGN_STARTING_FEN);
+
+    for(size_t ply = 0; ply < game.moves.size(); ply++)
+    {
+        const std::string& san = game.moves[ply].san;
+        Move move;
+
+        SanResult result = ResolveSAN(pos, san.data(), san.size(), move);
+        int index = result == SAN_OK ? MoveToIndex(pos, move) : -1;
+
+        if(index < 0)
+        {
+            if(error) *error = PgnError{game.index, static_cast<int>(ply + 1), 0, 0, san,
+                                        SanResultString(result == SAN_OK ? SAN_NO_MOVE : result)};
+            return false;
+        }
+
+        record.moves.push_back(static_cast<uint8_t>(index));
+        pos.applyMove(move);
+    }
+
+    return true;
+}
+
+GameDbWriter::GameDbWriter() : file(nullptr), position(0) {}
+
+GameDbWriter::~GameDbWriter()
+{
+    close();
+}
+
+bool GameDbWriter::open(const std::string& path)
+{
+    close();
+
+    file = std::fopen(path.c_str(), "wb");
+    if(!file) return false;
+
+    // Placeholder, rewritten by close()
+    GameDbHeader header = {};
+    std::fwrite(&header, sizeof header, 1, file);
+
+    position = sizeof header;
+    offsets.clear();
+
+    return true;
+}
+
+static void PutU16(std::string& out, unsigned value)
+{
+    out += static_cast<char>(value & 0xFF);
+    out += static_cast<char>((value >> 8) & 0xFF);
+}
+
+static unsigned GetU16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+// Record layout:
+//   u16 plies, u8 result, u8 flags, u16 white elo, u16 black elo, u16 tag bytes,
+//   [u8 FEN length, FEN] if flags & RECORD_CUSTOM_START,
+//   tags as "name\0value\0" pairs, one byte per move
+bool GameDbWriter::encode(const GameRecord& record, std::string& out)
+{
+    out.clear();
+    if(record.startFEN.size() > GAMEDB_MAX_FEN) return false;
+
+    std::string tags;
+    for(const PgnTag& tag : record.tags)
+    {
+        if(tags.size() + tag.name.size() + tag.value.size() + 2 > 0xFFFF) break;
+
+        tags += tag.name;
+        tags += '\0';
+        tags += tag.value;
+        tags += '\0';
+    }
+
+    const bool customStart = !record.startFEN.empty();
+    const size_t plies = std::min<size_t>(record.moves.size(), 0xFFFF);
+
+    PutU16(out, static_cast<unsigned>(plies));
+    out += static_cast<char>(record.result);
+    out += static_cast<char>(customStart ? RECORD_CUSTOM_START : 0);
+    PutU16(out, std::max(0, std::min(record.whiteElo, 0xFFFF)));
+    PutU16(out, std::max(0, std::min(record.blackElo, 0xFFFF)));
+    PutU16(out, static_cast<unsigned>(tags.size()));
+
+    if(customStart)
+    {
+        out += static_cast<char>(record.startFEN.size());
+        out += record.startFEN;
+    }
+
+    out += tags;
+    out.append(reinterpret_cast<const char *>(record.moves.data()), plies);
+
+    return true;
+}
+
+void GameDbWriter::addEncoded(const std::string& bytes)
+{
+    offsets.push_back(position);
+    std::fwrite(bytes.data(), 1, bytes.size(), file);
+    position += bytes.size();
+}
+
+uint32_t GameDbWriter::add(const GameRecord& record)
+{
+    std::string bytes;
+    if(!encode(record, bytes)) return GAMEDB_NO_GAME;
+
+    addEncoded(bytes);
+
+    return static_cast<uint32_t>(offsets.size() - 1);
+}
+
+bool GameDbWriter::close()
+{
+    if(!file) return false;
+
+    // The offset table is read in place from the mapping, keep it aligned
+    static const char padding[8] = {};
+    size_t pad = (8 - position % 8) % 8;
+    std::fwrite(padding, 1, pad, file);
+    position += pad;
+
+    GameDbHeader header;
+    std::memcpy(header.magic, GAMEDB_MAGIC, sizeof header.magic);
+    header.version = GAMEDB_VERSION;
+    header.reserved = 0;
+    header.gameCount = offsets.size();
+    header.offsetTable = position;
+
+    std::fwrite(offsets.data(), sizeof(uint64_t), offsets.size(), file);
+    std::rewind(file);
+    std::fwrite(&header, sizeof header, 1, file);
+
+    bool ok = std::ferror(file) == 0;
+    std::fclose(file);
+    file = nullptr;
+
+    return ok;
+}
+
+bool GameDatabase::open(const std::string& path, FileAccess access)
+{
+    header = nullptr;
+    offsets = nullptr;
+
+    if(!file.open(path, access) || file.size() < sizeof(GameDbHeader)) return false;
+
+    const GameDbHeader *h = reinterpret_cast<const GameDbHeader *>(file.data());
+
+    if(std::memcmp(h->magic, GAMEDB_MAGIC, sizeof h->magic) != 0 || h->version != GAMEDB_VERSION ||
+       h->offsetTable < sizeof(GameDbHeader) || h->offsetTable > file.size() ||
+       h->gameCount > (file.size() - h->offsetTable) / sizeof(uint64_t))
+        return false;
+
+    header = h;
+    offsets = reinterpret_cast<const uint64_t *>(file.data() + h->offsetTable);
+
+    return true;
+}
+
+size_t GameDatabase::gameCount() const
+{
+    return header ? header->gameCount : 0;
+}
+
+bool GameDatabase::readGame(uint32_t id, GameRecord& record) const
+{
+    if(id >= gameCount()) return false;
+
+    // Records lie between the header and the offset table: a corrupt or cut file must not lead past it
+    const uint64_t offset = offsets[id], end = header->offsetTable;
+    if(offset < sizeof(GameDbHeader) || offset > end || end - offset < 10) return false;
+
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(file.data() + offset);
+    const uint8_t *recordEnd = reinterpret_cast<const uint8_t *>(file.data() + end);
+
+    const unsigned plies = GetU16(p);
+    const unsigned flags = p[3];
+    const unsigned tagBytes = GetU16(p + 8);
+
+    if(p[2] > RESULT_BLACK_WINS) return false;
+
+    record.result = static_cast<GameResult>(p[2]);
+    record.whiteElo = GetU16(p + 4);
+    record.blackElo = GetU16(p + 6);
+    p += 10;
+
+    record.startFEN.clear();
+    if(flags & RECORD_CUSTOM_START)
+    {
+        if(recordEnd - p < 1 || recordEnd - p - 1 < p[0]) return false;
+
+        record.startFEN.assign(reinterpret_cast<const char *>(p + 1), p[0]);
+        p += 1 + p[0];
+
+        if(!PlausibleFEN(record.startFEN)) return false;
+    }
+
+    if(static_cast<size_t>(recordEnd - p) < static_cast<size_t>(tagBytes) + plies) return false;
+
+    // Every name and value ends with a '\0' inside the tag bytes
+    auto nextString = [](const char *&text, const char *limit, std::string& out)
+    {
+        const char *zero = static_cast<const char *>(std::memchr(text, '\0', limit - text));
+        if(!zero) return false;
+
+        out.assign(text, zero);
+        text = zero + 1;
+        return true;
+    };
+
+    record.tags.clear();
+    const char *tag = reinterpret_cast<const char *>(p), *tagsEnd = tag + tagBytes;
+    while(tag < tagsEnd)
+    {
+        PgnTag t;
+        if(!nextString(tag, tagsEnd, t.name) || !nextString(tag, tagsEnd, t.value)) return false;
+
+        record.tags.push_back(t);
+    }
+    p += tagBytes;
+
+    record.moves.assign(p, p + plies);
+
+    return true;
+}
+
+bool GameDatabase::replayGame(uint32_t id, const GameVisitor& visitor) const
+{
+    GameRecord record;
+    if(!readGame(id, record)) return false;
+
+    Position pos(record.startFEN.empty() ? PGN_STARTING_FEN : record.startFEN);
+    visitor(pos, 0);
+
+    for(size_t ply = 0; ply < record.moves.size(); ply++)
+    {
+        Move move;
+        if(!MoveFromIndex(pos, record.moves[ply], move)) return false;
+
+        pos.applyMove(move);
+        visitor(pos, static_cast<int>(ply + 1));
+    }
+
+    return true;
+}
+
+GameDbImportStats ImportPgn(const PgnReader& reader, GameDbWriter& writer, int threads, std::vector<PgnError> *errors)
+{
+    if(threads < 1) threads = 1;
+
+    const auto start = std::chrono::steady_clock::now();
+    const size_t games = reader.gameCount();
+
+    GameDbImportStats stats = {0, 0, 0};
+    std::vector<std::string> encoded;
+    std::mutex errorMutex;
+
+    for(size_t blockStart = 0; blockStart < games; blockStart += IMPORT_BLOCK_SIZE)
+    {
+        const size_t blockEnd = std::min(blockStart + IMPORT_BLOCK_SIZE, games);
+        std::atomic<size_t> next(blockStart);
+
+        encoded.assign(blockEnd - blockStart, std::string());
+
+        auto worker = [&]()
+        {
+            PgnGame game;
+            GameRecord record;
+
+            for(size_t index; (index = next++) < blockEnd; )
+            {
+                PgnError error;
+
+                if(!reader.parseGame(index, game, PGN_SKIP_ANNOTATIONS)) continue;
+
+                if(!GameRecordFromPgn(game, record, &error))
+                {
+                    if(errors)
+                    {
+                        if(error.ply > 0)
+                            reader.locate(index, game.offset + game.moves[error.ply - 1].offset, error.line, error.column);
+
+                        std::lock_guard<std::mutex> lock(errorMutex);
+                        errors->push_back(error);
+                    }
+                    continue;
+                }
+
+                GameDbWriter::encode(record, encoded[index - blockStart]);
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for(int i = 0; i < threads; i++) workers.emplace_back(worker);
+        for(std::thread& t : workers) t.join();
+
+        for(const std::string& bytes : encoded)
+        {
+            if(bytes.empty())
+            {
+                stats.failedGames++;
+                continue;
+            }
+
+            writer.addEncoded(bytes);
+            stats.games++;
+        }
+    }
+
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
+
+static bool IndexEntryOrder(const PositionIndexEntry& a, const PositionIndexEntry& b)
+{
+    if(a.key != b.key) return a.key < b.key;
+    if(a.game != b.game) return a.game < b.game;
+
+    return a.ply < b.ply;
+}
+
+bool BuildPositionIndex(const GameDatabase& db, const std::string& path, int threads)
+{
+    if(threads < 1) threads = 1;
+
+    const size_t games = db.gameCount();
+    std::vector<std::vector<PositionIndexEntry>> chunks(threads);
+
+    // Every worker indexes and sorts a contiguous range of games
+    auto worker = [&](int id)
+    {
+        std::vector<PositionIndexEntry>& entries = chunks[id];
+        const uint32_t first = static_cast<uint32_t>(games * id / threads);
+        const uint32_t last  = static_cast<uint32_t>(games * (id + 1) / threads);
+
+        for(uint32_t game = first; game < last; game++)
+        {
+            db.replayGame(game, [&](const Position& pos, int ply)
+            {
+                entries.push_back(PositionIndexEntry{pos.zobristKey, game, static_cast<uint16_t>(ply), 0});
+            });
+        }
+
+        std::sort(entries.begin(), entries.end(), IndexEntryOrder);
+    };
+
+    std::vector<std::thread> workers;
+    for(int i = 0; i < threads; i++) workers.emplace_back(worker, i);
+    for(std::thread& t : workers) t.join();
+
+    FILE *out = std::fopen(path.c_str(), "wb");
+    if(!out) return false;
+
+    PositionIndexHeader header;
+    std::memcpy(header.magic, INDEX_MAGIC, sizeof header.magic);
+    header.version = GAMEDB_VERSION;
+    header.reserved = 0;
+    header.entryCount = 0;
+    for(const auto& chunk : chunks) header.entryCount += chunk.size();
+
+    std::fwrite(&header, sizeof header, 1, out);
+
+    // k-way merge of the sorted chunks
+    typedef std::pair<size_t, int> Cursor;  // (position in chunk, chunk)
+    auto later = [&](const Cursor& a, const Cursor& b)
+    {
+        return IndexEntryOrder(chunks[b.second][b.first], chunks[a.second][a.first]);
+    };
+    std::priority_queue<Cursor, std::vector<Cursor>, decltype(later)> heap(later);
+
+    for(int i = 0; i < threads; i++)
+        if(!chunks[i].empty()) heap.push(Cursor(0, i));
+
+    std::vector<PositionIndexEntry> buffer;
+    buffer.reserve(1 << 16);
+
+    while(!heap.empty())
+    {
+        Cursor c = heap.top();
+        heap.pop();
+
+        buffer.push_back(chunks[c.second][c.first]);
+        if(buffer.size() == buffer.capacity())
+        {
+            std::fwrite(buffer.data(), sizeof(PositionIndexEntry), buffer.size(), out);
+            buffer.clear();
+        }
+
+        if(++c.first < chunks[c.second].size()) heap.push(c);
+    }
+
+    std::fwrite(buffer.data(), sizeof(PositionIndexEntry), buffer.size(), out);
+
+    bool ok = std::ferror(out) == 0;
+    std::fclose(out);
+
+    return ok;
+}
+
+bool PositionIndex::open(const std::string& path)
+{
+    header = nullptr;
+    entries = nullptr;
+
+    if(!file.open(path, ACCESS_RANDOM) || file.size() < sizeof(PositionIndexHeader)) return false;
+
+    const PositionIndexHeader *h = reinterpret_cast<const PositionIndexHeader *>(file.data());
+
+    if(std::memcmp(h->magic, INDEX_MAGIC, sizeof h->magic) != 0 || h->version != GAMEDB_VERSION ||
+       sizeof(PositionIndexHeader) + h->entryCount * sizeof(PositionIndexEntry) > file.size())
+        return false;
+
+    header = h;
+    entries = reinterpret_cast<const PositionIndexEntry *>(file.data() + sizeof(PositionIndexHeader));
+
+    return true;
+}
+
+void PositionIndex::find(uint64_t key, const PositionIndexEntry *& first, const PositionIndexEntry *& last) const
+{
+    first = last = entries;
+    if(!header) return;
+
+    auto range = std::equal_range(entries, entries + header->entryCount, PositionIndexEntry{key, 0, 0, 0},
+                                  [](const PositionIndexEntry& a, const PositionIndexEntry& b) { return a.key < b.key; });
+
+    first = range.first;
+    last = range.second;
+}
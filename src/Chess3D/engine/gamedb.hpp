@@ -0,0 +1,144 @@
+#ifndef CHEESENG_GAMEDB_H
+#define CHEESENG_GAMEDB_H
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "mappedfile.hpp"
+#include "pgn.hpp"
+#include "position.hpp"
+
+// Binary game store (<name>.games) and Zobrist position index (<name>.index).
+// Both files are written in host byte order (little endian on every supported platform).
+
+#define GAMEDB_VERSION 1
+
+// The start FEN of a record is stored after a one byte length
+#define GAMEDB_MAX_FEN 0xFF
+
+// add() result for a record that cannot be stored
+#define GAMEDB_NO_GAME 0xFFFFFFFFu
+
+enum GameResult{RESULT_UNKNOWN, RESULT_WHITE_WINS, RESULT_DRAW, RESULT_BLACK_WINS};
+
+struct GameRecord
+{
+    GameResult result;
+    int whiteElo, blackElo;          // 0 when unknown
+    std::string startFEN;            // empty for the standard starting position
+    std::vector<PgnTag> tags;
+    std::vector<uint8_t> moves;      // index of each move in the sorted legal move list
+
+    const std::string *getTag(const std::string& name) const;
+};
+
+struct GameDbHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t gameCount;
+    uint64_t offsetTable;            // file offset of gameCount uint64_t record offsets
+};
+
+struct PositionIndexHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t entryCount;
+};
+
+struct PositionIndexEntry
+{
+    uint64_t key;
+    uint32_t game;
+    uint16_t ply;
+    uint16_t reserved;
+};
+
+// A position is visited at every ply of a game, starting with ply 0
+typedef std::function<void(const Position& pos, int ply)> GameVisitor;
+
+// Moves are stored as their index in the legal move list sorted by (from, to, promotion)
+void SortedLegalMoves(Position& pos, std::vector<Move>& out);
+int MoveToIndex(Position& pos, const Move& move);
+bool MoveFromIndex(Position& pos, int index, Move& out);
+
+GameResult GameResultFromString(const std::string& result);
+const char *GameResultString(GameResult result);
+
+// Replay a parsed PGN game into a record. Fails at the first illegal move, or on a FEN tag that
+// is malformed or longer than GAMEDB_MAX_FEN.
+bool GameRecordFromPgn(const PgnGame& game, GameRecord& record, PgnError *error);
+
+class GameDbWriter
+{
+public:
+    GameDbWriter();
+    ~GameDbWriter();
+
+    bool open(const std::string& path);
+    uint32_t add(const GameRecord& record);
+    bool close();
+
+    // Fails (out left empty) when the start FEN is longer than GAMEDB_MAX_FEN
+    static bool encode(const GameRecord& record, std::string& out);
+    void addEncoded(const std::string& bytes);
+
+private:
+    FILE *file;
+    uint64_t position;
+    std::vector<uint64_t> offsets;
+};
+
+class GameDatabase
+{
+public:
+    // ACCESS_RANDOM for lookups of single games, the default for passes over the whole file
+    bool open(const std::string& path, FileAccess access=ACCESS_SEQUENTIAL);
+
+    size_t gameCount() const;
+    // Fails on a record that does not fit before the offset table or is malformed (a damaged or cut file)
+    bool readGame(uint32_t id, GameRecord& record) const;
+    bool replayGame(uint32_t id, const GameVisitor& visitor) const;
+
+private:
+    MappedFile file;
+    const GameDbHeader *header = nullptr;
+    const uint64_t *offsets = nullptr;
+};
+
+struct GameDbImportStats
+{
+    size_t games;
+    size_t failedGames;
+    double seconds;
+};
+
+// Convert every game of a PGN file, `threads` games are encoded in parallel and written in order
+GameDbImportStats ImportPgn(const PgnReader& reader, GameDbWriter& writer, int threads, std::vector<PgnError> *errors=nullptr);
+
+// Replay every stored game on `threads` workers and write the sorted (key, game, ply) index
+bool BuildPositionIndex(const GameDatabase& db, const std::string& path, int threads);
+
+class PositionIndex
+{
+public:
+    bool open(const std::string& path);
+
+    size_t size() const { return header ? header->entryCount : 0; }
+
+    // All occurrences of key, sorted by game and ply. Points into the mapped file.
+    void find(uint64_t key, const PositionIndexEntry *& first, const PositionIndexEntry *& last) const;
+
+private:
+    MappedFile file;
+    const PositionIndexHeader *header = nullptr;
+    const PositionIndexEntry *entries = nullptr;
+};
+
+#endif //CHEESENG_GAMEDB_H
@@ -21,8 +21,6 @@ static const PieceData PIECE_DATA[] =
 static const int DIAGONAL_DIRECTIONS[][2] = {{-1, -1}, {1, 1}, {-1, 1}, {1, -1}};
 static const int CROSS_DIRECTIONS[][2]    = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
 
-static const int KNIGHT_MOVES[][2] = {{1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2}};
-
 static const Coord CASTLING_KING_START_COORD[2] = {{FILE_E, RANK_1}, {FILE_E, RANK_8}};
 static const Coord CASTLING_ROOK_START_COORD[2][2] = {{{FILE_H, RANK_1}, {FILE_A, RANK_1}}, {{FILE_H, RANK_8}, {FILE_A, RANK_8}}};
 
@@ -0,0 +1,113 @@
+#include "mappedfile.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile() : data_(nullptr), size_(0), fileHandle_(INVALID_HANDLE_VALUE), mappingHandle_(nullptr) {}
+
+bool MappedFile::open(const std::string& path, FileAccess access)
+{
+    close();
+
+    fileHandle_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, access == ACCESS_RANDOM ? FILE_FLAG_RANDOM_ACCESS : FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if(fileHandle_ == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER fileSize;
+    if(!GetFileSizeEx(fileHandle_, &fileSize) || fileSize.QuadPart == 0)
+    {
+        close();
+        return false;
+    }
+
+    mappingHandle_ = CreateFileMappingA(fileHandle_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(!mappingHandle_)
+    {
+        close();
+        return false;
+    }
+
+    data_ = static_cast<const char *>(MapViewOfFile(mappingHandle_, FILE_MAP_READ, 0, 0, 0));
+    if(!data_)
+    {
+        close();
+        return false;
+    }
+
+    size_ = static_cast<size_t>(fileSize.QuadPart);
+    return true;
+}
+
+void MappedFile::close()
+{
+    if(data_) UnmapViewOfFile(data_);
+    if(mappingHandle_) CloseHandle(mappingHandle_);
+    if(fileHandle_ != INVALID_HANDLE_VALUE) CloseHandle(fileHandle_);
+
+    data_ = nullptr;
+    size_ = 0;
+    mappingHandle_ = nullptr;
+    fileHandle_ = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+MappedFile::MappedFile() : data_(nullptr), size_(0), fd_(-1) {}
+
+bool MappedFile::open(const std::string& path, FileAccess access)
+{
+    close();
+
+    fd_ = ::open(path.c_str(), O_RDONLY);
+    if(fd_ < 0) return false;
+
+    struct stat st;
+    if(fstat(fd_, &st) != 0 || st.st_size == 0)
+    {
+        close();
+        return false;
+    }
+
+    void *mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd_, 0);
+    if(mapping == MAP_FAILED)
+    {
+        close();
+        return false;
+    }
+
+    madvise(mapping, st.st_size, access == ACCESS_RANDOM ? MADV_RANDOM : MADV_SEQUENTIAL);
+
+    data_ = static_cast<const char *>(mapping);
+    size_ = static_cast<size_t>(st.st_size);
+    return true;
+}
+
+void MappedFile::close()
+{
+    if(data_) munmap(const_cast<char *>(data_), size_);
+    if(fd_ >= 0) ::close(fd_);
+
+    data_ = nullptr;
+    size_ = 0;
+    fd_ = -1;
+}
+
+#endif
+
+MappedFile::MappedFile(const std::string& path, FileAccess access) : MappedFile()
+{
+    open(path, access);
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
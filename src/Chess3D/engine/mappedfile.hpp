@@ -0,0 +1,42 @@
+#ifndef CHEESENG_MAPPEDFILE_H
+#define CHEESENG_MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+
+// How the mapping will be read, passed on to the OS readahead: streamed front to back, or looked up
+// at scattered offsets (a binary search over a sorted table)
+enum FileAccess{ACCESS_SEQUENTIAL, ACCESS_RANDOM};
+
+// Read-only memory mapping of a whole file.
+// An empty or missing file leaves the mapping closed (data() == nullptr).
+class MappedFile
+{
+public:
+    MappedFile();
+    MappedFile(const std::string& path, FileAccess access=ACCESS_SEQUENTIAL);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path, FileAccess access=ACCESS_SEQUENTIAL);
+    void close();
+
+    bool isOpen() const { return data_ != nullptr; }
+    const char *data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const char *data_;
+    size_t size_;
+
+#ifdef _WIN32
+    void *fileHandle_;
+    void *mappingHandle_;
+#else
+    int fd_;
+#endif
+};
+
+#endif //CHEESENG_MAPPEDFILE_H
@@ -0,0 +1,369 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <ctime>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include "match.hpp"
+#include "movegen.hpp"
+#include "playout.hpp"
+#include "uciprocess.hpp"
+
+// Milliseconds an engine gets to answer uci, isready and stop
+#define HANDSHAKE_MS 10000
+
+#define PGN_LINE_LENGTH 79
+
+const char *MatchTerminationString(MatchTermination termination)
+{
+    static const char *TERMINATION_STRINGS[] = {"checkmate", "stalemate", "fifty move rule", "threefold repetition",
+                                                "insufficient material", "ply limit", "time forfeit", "illegal move",
+                                                "engine exited"};
+
+    return TERMINATION_STRINGS[termination];
+}
+
+static double ScoreToElo(double score)
+{
+    score = std::min(0.999, std::max(0.001, score));
+    return -400 * std::log10(1 / score - 1);
+}
+
+static double EloToScore(double elo)
+{
+    return 1 / (1 + std::pow(10.0, -elo / 400));
+}
+
+// Mean and variance of the points of one game
+static void ScoreMoments(const MatchScore& score, double& mean, double& variance)
+{
+    const double n = static_cast<double>(score.games());
+
+    mean = (score.wins + 0.5 * score.draws) / n;
+    variance = (score.wins * (1 - mean) * (1 - mean) + score.draws * (0.5 - mean) * (0.5 - mean) +
+                score.losses * mean * mean) / n;
+}
+
+double EloDifference(const MatchScore& score)
+{
+    if(!score.games()) return 0;
+
+    double mean, variance;
+    ScoreMoments(score, mean, variance);
+
+    return ScoreToElo(mean);
+}
+
+double EloMargin(const MatchScore& score)
+{
+    if(!score.games()) return 0;
+
+    double mean, variance;
+    ScoreMoments(score, mean, variance);
+
+    const double deviation = 1.959964 * std::sqrt(variance / score.games());
+
+    return (ScoreToElo(mean + deviation) - ScoreToElo(mean - deviation)) / 2;
+}
+
+double SprtLlr(const MatchScore& score, double elo0, double elo1)
+{
+    if(!score.games()) return 0;
+
+    double mean, variance;
+    ScoreMoments(score, mean, variance);
+
+    if(variance <= 0) return 0;
+
+    const double s0 = EloToScore(elo0), s1 = EloToScore(elo1);
+
+    return score.games() * (s1 - s0) * (2 * mean - s0 - s1) / (2 * variance);
+}
+
+void SprtBounds(double alpha, double beta, double& lower, double& upper)
+{
+    lower = std::log(beta / (1 - alpha));
+    upper = std::log((1 - beta) / alpha);
+}
+
+static bool StartEngine(UciProcess& engine, const std::string& command, const std::vector<std::string>& options)
+{
+    if(!engine.start(command) || !engine.send("uci") || !engine.waitFor("uciok", HANDSHAKE_MS)) return false;
+
+    for(const std::string& option : options)
+    {
+        const size_t equals = option.find('=');
+        if(equals == std::string::npos) engine.send("setoption name " + option);
+        else engine.send("setoption name " + option.substr(0, equals) + " value " + option.substr(equals + 1));
+    }
+
+    return engine.send("isready") && engine.waitFor("readyok", HANDSHAKE_MS);
+}
+
+static void Finish(MatchGame& game, GameResult result, MatchTermination termination)
+{
+    game.result = result;
+    game.termination = termination;
+}
+
+static GameResult Loss(PieceColor color)
+{
+    return color == WHITE ? RESULT_BLACK_WINS : RESULT_WHITE_WINS;
+}
+
+// Play one game; an engine that exited or stopped answering is marked broken, to be restarted
+static void PlayGame(const MatchOptions& options, UciProcess *engines, MatchGame& game, bool *broken)
+{
+    const TimeControl& tc = options.timeControl;
+
+    Position pos(game.startFEN);
+    pos.keyHistory.reserve(pos.keyHistory.size() + options.maxPlies + 1);
+
+    std::string positionCommand = "position fen " + game.startFEN + " moves";
+    int64_t clock[PLAYER_COUNT] = {tc.base, tc.base};
+
+    for(int e = 0; e < 2; e++)
+    {
+        engines[e].send("ucinewgame");
+
+        if(!engines[e].send("isready") || !engines[e].waitFor("readyok", HANDSHAKE_MS))
+        {
+            broken[e] = true;
+            Finish(game, Loss(e == game.white ? WHITE : BLACK), TERMINATION_CRASH);
+            return;
+        }
+    }
+
+    while(true)
+    {
+        MoveList moves;
+        GenerateLegalMoves(pos, moves);
+
+        if(moves.size() == 0)
+        {
+            if(pos.checkers()) Finish(game, Loss(pos.color_playing), TERMINATION_MATE);
+            else Finish(game, RESULT_DRAW, TERMINATION_STALEMATE);
+            return;
+        }
+
+        if(pos.halfmoveClock >= 100)                        { Finish(game, RESULT_DRAW, TERMINATION_FIFTY_MOVES); return; }
+        if(pos.isRepetition(3))                             { Finish(game, RESULT_DRAW, TERMINATION_REPETITION); return; }
+        if(InsufficientMaterial(pos))                       { Finish(game, RESULT_DRAW, TERMINATION_INSUFFICIENT_MATERIAL); return; }
+        if(static_cast<int>(game.moves.size()) >= options.maxPlies) { Finish(game, RESULT_DRAW, TERMINATION_PLY_LIMIT); return; }
+
+        const PieceColor side = pos.color_playing;
+        const int e = side == WHITE ? game.white : 1 - game.white;
+        UciProcess& engine = engines[e];
+
+        std::ostringstream go;
+        go << "go wtime " << clock[WHITE] << " btime " << clock[BLACK] << " winc " << tc.increment << " binc " << tc.increment;
+
+        const auto start = std::chrono::steady_clock::now();
+        std::string line;
+
+        const bool answered = engine.send(positionCommand) && engine.send(go.str()) &&
+                              engine.waitFor("bestmove", clock[side] + options.timeMargin, &line);
+
+        const int64_t elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+        if(!answered)
+        {
+            // Output closed before the time ran out: the engine is gone
+            if(elapsed < clock[side] + options.timeMargin || !engine.running())
+            {
+                broken[e] = true;
+                Finish(game, Loss(side), TERMINATION_CRASH);
+            }
+            else
+            {
+                if(!engine.send("stop") || !engine.waitFor("bestmove", HANDSHAKE_MS)) broken[e] = true;
+                Finish(game, Loss(side), TERMINATION_TIME);
+            }
+
+            return;
+        }
+
+        clock[side] = std::max<int64_t>(0, clock[side] - elapsed) + tc.increment;
+
+        std::istringstream words(line);
+        std::string word, text;
+        words >> word >> text;
+
+        PackedMove chosen = NULL_PACKED_MOVE;
+        for(PackedMove move : moves)
+            if(UciString(move) == text) chosen = move;
+
+        if(chosen == NULL_PACKED_MOVE)
+        {
+            Finish(game, Loss(side), TERMINATION_ILLEGAL_MOVE);
+            return;
+        }
+
+        MoveUndo undo;
+        pos.makeMove(chosen, undo);
+
+        game.moves.push_back(chosen);
+        positionCommand += " " + text;
+    }
+}
+
+bool RunMatch(const MatchOptions& options, const MatchReporter& report, MatchScore& score, std::string& error)
+{
+    const int concurrency = std::max(1, options.concurrency);
+
+    double lower = 0, upper = 0;
+    if(options.sprt) SprtBounds(options.alpha, options.beta, lower, upper);
+
+    std::atomic<uint64_t> next(0);
+    std::atomic<bool> stopped(false);
+    std::mutex mutex;
+
+    score = MatchScore();
+    error.clear();
+
+    auto fail = [&](int e)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if(error.empty()) error = "cannot start " + options.commands[e];
+        stopped = true;
+    };
+
+    auto worker = [&]()
+    {
+        UciProcess engines[2];
+
+        for(int e = 0; e < 2; e++)
+        {
+            if(!StartEngine(engines[e], options.commands[e], options.engineOptions[e]))
+            {
+                fail(e);
+                return;
+            }
+        }
+
+        for(uint64_t number; !stopped && (number = next++) < options.games; )
+        {
+            MatchGame game;
+            game.number = number;
+            game.white = static_cast<int>(number % 2);
+            game.startFEN = options.openings.empty() ? PGN_STARTING_FEN : options.openings[number / 2 % options.openings.size()];
+
+            bool broken[2] = {false, false};
+            PlayGame(options, engines, game, broken);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+
+                if(game.result == RESULT_DRAW) score.draws++;
+                else if((game.result == RESULT_WHITE_WINS) == (game.white == 0)) score.wins++;
+                else score.losses++;
+
+                if(report) report(game, score);
+
+                if(options.sprt)
+                {
+                    const double llr = SprtLlr(score, options.elo0, options.elo1);
+                    if(llr <= lower || llr >= upper) stopped = true;
+                }
+            }
+
+            for(int e = 0; e < 2; e++)
+            {
+                if(broken[e] && !StartEngine(engines[e], options.commands[e], options.engineOptions[e]))
+                {
+                    fail(e);
+                    return;
+                }
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for(int t = 1; t < concurrency; t++) pool.emplace_back(worker);
+    worker();
+    for(std::thread& thread : pool) thread.join();
+
+    return error.empty();
+}
+
+// SAN of a legal move, with the check and mate suffixes
+static std::string SanString(Position& pos, PackedMove packed)
+{
+    Move move = UnpackMove(packed, pos);
+    move.createMoveString(pos);
+
+    // Castling is written with zeros for the board display, PGN wants letters
+    std::string san = move.algebraicNotation;
+    std::replace(san.begin(), san.end(), '0', 'O');
+
+    return san;
+}
+
+std::string MatchGamePgn(const MatchOptions& options, const MatchGame& game)
+{
+    char date[16];
+    const std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof date, "%Y.%m.%d", std::localtime(&now));
+
+    const TimeControl& tc = options.timeControl;
+    std::ostringstream timeControl;
+    timeControl << tc.base / 1000.0 << "+" << tc.increment / 1000.0;
+
+    const char *result = GameResultString(game.result);
+    std::ostringstream out;
+
+    out << "[Event \"Engine match\"]\n";
+    out << "[Site \"local\"]\n";
+    out << "[Date \"" << date << "\"]\n";
+    out << "[Round \"" << game.number + 1 << "\"]\n";
+    out << "[White \"" << options.names[game.white] << "\"]\n";
+    out << "[Black \"" << options.names[1 - game.white] << "\"]\n";
+    out << "[Result \"" << result << "\"]\n";
+
+    if(game.startFEN != PGN_STARTING_FEN)
+    {
+        out << "[SetUp \"1\"]\n";
+        out << "[FEN \"" << game.startFEN << "\"]\n";
+    }
+
+    out << "[TimeControl \"" << timeControl.str() << "\"]\n";
+    out << "[PlyCount \"" << game.moves.size() << "\"]\n\n";
+
+    Position pos(game.startFEN);
+    std::vector<std::string> words;
+
+    for(size_t ply = 0; ply < game.moves.size(); ply++)
+    {
+        if(pos.color_playing == WHITE) words.push_back(std::to_string(pos.fullmoveNumber) + ".");
+        else if(ply == 0) words.push_back(std::to_string(pos.fullmoveNumber) + "...");
+
+        words.push_back(SanString(pos, game.moves[ply]));
+
+        MoveUndo undo;
+        pos.makeMove(game.moves[ply], undo);
+    }
+
+    words.push_back(std::string("{") + MatchTerminationString(game.termination) + "}");
+    words.push_back(result);
+
+    size_t length = 0;
+    for(const std::string& word : words)
+    {
+        if(length && length + 1 + word.size() > PGN_LINE_LENGTH)
+        {
+            out << "\n";
+            length = 0;
+        }
+
+        if(length) out << " ";
+        out << word;
+        length += (length ? 1 : 0) + word.size();
+    }
+
+    out << "\n\n";
+
+    return out.str();
+}
@@ -0,0 +1,92 @@
+#ifndef CHEESENG_MATCH_H
+#define CHEESENG_MATCH_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "gamedb.hpp"
+#include "move.hpp"
+
+struct TimeControl
+{
+    int64_t base = 10000;               // milliseconds per game
+    int64_t increment = 100;            // milliseconds per move
+};
+
+enum MatchTermination
+{
+    TERMINATION_MATE,
+    TERMINATION_STALEMATE,
+    TERMINATION_FIFTY_MOVES,
+    TERMINATION_REPETITION,
+    TERMINATION_INSUFFICIENT_MATERIAL,
+    TERMINATION_PLY_LIMIT,
+    TERMINATION_TIME,
+    TERMINATION_ILLEGAL_MOVE,
+    TERMINATION_CRASH
+};
+
+const char *MatchTerminationString(MatchTermination termination);
+
+struct MatchOptions
+{
+    std::string commands[2];            // program and arguments of each engine
+    std::string names[2];
+    std::vector<std::string> engineOptions[2];  // "Name=Value", sent with setoption
+
+    // Games go in pairs from the same opening with the colors swapped: game i starts from
+    // openings[i / 2 % size], the starting position when there are none, and engine 0 is white in even games
+    std::vector<std::string> openings;
+
+    uint64_t games = 100;
+    int concurrency = 1;
+    TimeControl timeControl;
+    int64_t timeMargin = 100;           // milliseconds past the clock before a loss on time
+    int maxPlies = 600;                 // a draw when reached
+
+    // Stop as soon as the sequential probability ratio test accepts elo0 or elo1
+    bool sprt = false;
+    double elo0 = 0, elo1 = 5;
+    double alpha = 0.05, beta = 0.05;
+};
+
+struct MatchGame
+{
+    uint64_t number;
+    int white;                          // engine playing white
+    std::string startFEN;
+    std::vector<PackedMove> moves;
+    GameResult result;
+    MatchTermination termination;
+};
+
+// Wins, draws and losses of engine 0
+struct MatchScore
+{
+    uint64_t wins = 0, draws = 0, losses = 0;
+
+    uint64_t games() const { return wins + draws + losses; }
+};
+
+// Logistic Elo difference of engine 0 and the half width of its 95% confidence interval
+double EloDifference(const MatchScore& score);
+double EloMargin(const MatchScore& score);
+
+// Log likelihood ratio of elo1 against elo0, normal approximation of the trinomial results
+double SprtLlr(const MatchScore& score, double elo0, double elo1);
+void SprtBounds(double alpha, double beta, double& lower, double& upper);
+
+// Called once per game in the order they finish, never on two threads at once
+typedef std::function<void(const MatchGame& game, const MatchScore& score)> MatchReporter;
+
+// Play the match with options.concurrency games at a time, each pair of engine processes reused from game
+// to game. Games end by the rules of the position, on time, on an illegal move or when an engine exits.
+// False with a message when an engine cannot be started.
+bool RunMatch(const MatchOptions& options, const MatchReporter& report, MatchScore& score, std::string& error);
+
+// A finished game in PGN, moves in SAN
+std::string MatchGamePgn(const MatchOptions& options, const MatchGame& game);
+
+#endif //CHEESENG_MATCH_H
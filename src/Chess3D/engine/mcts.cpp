@@ -0,0 +1,436 @@
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#include "mcts.hpp"
+#include "evaluate.hpp"
+#include "movegen.hpp"
+
+#define MCTS_CPUCT 1.5
+#define MCTS_FPU_REDUCTION 0.2      // unvisited children start this much below their parent's value
+#define MCTS_VIRTUAL_LOSS 3
+#define MCTS_EVAL_SCALE 400.0       // centipawns to a value in [-1, 1]
+#define MCTS_PRIOR_TEMPERATURE 200.0
+#define MCTS_REPORT_SECONDS 1.0
+
+#define VALUE_ONE 65536
+#define NO_NODE 0xFFFFFFFFu
+
+enum NodeState{NODE_LEAF, NODE_EXPANDING, NODE_EXPANDED};
+
+// The static evaluation squashed to an expected result for the side to move
+static double LeafValue(const Position& pos)
+{
+    return 2.0 / (1.0 + std::exp(-Evaluate(pos) / MCTS_EVAL_SCALE)) - 1.0;
+}
+
+static int ValueToCentipawns(double value)
+{
+    value = std::max(-0.999, std::min(0.999, value));
+    return static_cast<int>(-MCTS_EVAL_SCALE * std::log(2.0 / (value + 1.0) - 1.0));
+}
+
+Mcts::Mcts(size_t megabytes) : nodeCapacity(0), nextNode(0), rootIndex(NO_NODE), reporter(nullptr),
+                               softLimit(0), hardLimit(0), stopped(false), ponder(PONDER_OFF), playouts(0), maxDepth(0)
+{
+    resize(megabytes);
+}
+
+void Mcts::resize(size_t megabytes)
+{
+    size_t count = (megabytes ? megabytes : 1) * 1024 * 1024 / sizeof(Node);
+    if(count > NO_NODE) count = NO_NODE;
+
+    if(count != nodeCapacity)
+    {
+        nodes.reset(new Node[count]);
+        nodeCapacity = count;
+    }
+
+    clear();
+}
+
+void Mcts::clear()
+{
+    nextNode = 0;
+    rootIndex = NO_NODE;
+    rootPosition.reset();
+}
+
+size_t Mcts::nodesUsed() const
+{
+    return std::min<size_t>(nextNode, nodeCapacity);
+}
+
+void Mcts::initNode(Node& node, PackedMove move, float prior)
+{
+    node.valueSum.store(0, std::memory_order_relaxed);
+    node.visits.store(0, std::memory_order_relaxed);
+    node.virtualLoss.store(0, std::memory_order_relaxed);
+    node.state.store(NODE_LEAF, std::memory_order_relaxed);
+    node.firstChild = NO_NODE;
+    node.childCount = 0;
+    node.move = move;
+    node.prior = prior;
+}
+
+// A block of count consecutive nodes, NO_NODE once the arena is full
+uint32_t Mcts::allocate(int count)
+{
+    if(nextNode.load(std::memory_order_relaxed) + count > nodeCapacity) return NO_NODE;
+
+    const uint32_t first = nextNode.fetch_add(count);
+    return first + count <= nodeCapacity ? first : NO_NODE;
+}
+
+// Keep the subtree of the new root when it was reached in the last tree. The nodes outside it stay
+// allocated, so a tree that already filled most of the arena is started over instead.
+bool Mcts::reuse(const Position& root)
+{
+    if(!rootPosition || rootIndex == NO_NODE || nodesUsed() > nodeCapacity * 3 / 4) return false;
+
+    uint32_t found = NO_NODE;
+
+    if(rootPosition->zobristKey == root.zobristKey)
+    {
+        found = rootIndex;
+    }
+    else
+    {
+        Position pos = *rootPosition;
+        const Node& oldRoot = nodes[rootIndex];
+
+        if(oldRoot.state.load(std::memory_order_acquire) != NODE_EXPANDED) return false;
+
+        for(uint32_t c = oldRoot.firstChild; c < oldRoot.firstChild + oldRoot.childCount && found == NO_NODE; c++)
+        {
+            MoveUndo undo;
+            pos.makeMove(nodes[c].move, undo);
+
+            if(pos.zobristKey == root.zobristKey) found = c;
+
+            const Node& child = nodes[c];
+
+            if(found == NO_NODE && child.state.load(std::memory_order_acquire) == NODE_EXPANDED)
+            {
+                for(uint32_t g = child.firstChild; g < child.firstChild + child.childCount; g++)
+                {
+                    MoveUndo reply;
+                    pos.makeMove(nodes[g].move, reply);
+                    const bool match = pos.zobristKey == root.zobristKey;
+                    pos.unmakeMove(reply);
+
+                    if(match)
+                    {
+                        found = g;
+                        break;
+                    }
+                }
+            }
+
+            pos.unmakeMove(undo);
+        }
+    }
+
+    if(found == NO_NODE) return false;
+
+    rootIndex = found;
+    *rootPosition = root;
+
+    return true;
+}
+
+SearchResult Mcts::run(const Position& root, const SearchLimits& searchLimits, int threads, const SearchReporter& report)
+{
+    limits = searchLimits;
+    AllocateTime(limits, root.color_playing, softLimit, hardLimit);
+
+    if(!limits.nodes && hardLimit <= 0 && !limits.infinite) limits.nodes = MCTS_DEFAULT_PLAYOUTS;
+
+    if(!reuse(root))
+    {
+        nextNode = 0;
+        rootIndex = allocate(1);
+        initNode(nodes[rootIndex], NULL_PACKED_MOVE, 1.0f);
+        rootPosition.reset(new Position(root));
+    }
+
+    reporter = &report;
+    start = clockStart = std::chrono::steady_clock::now();
+    stopped = false;
+    ponder = limits.ponder ? PONDER_ON : PONDER_OFF;
+    playouts = 0;
+    maxDepth = 0;
+
+    std::vector<std::thread> pool;
+    for(int t = 1; t < threads; t++) pool.emplace_back(&Mcts::worker, this, t);
+    worker(0);
+    for(std::thread& thread : pool) thread.join();
+
+    ponder = PONDER_OFF;
+
+    SearchResult result = {NULL_PACKED_MOVE, NULL_PACKED_MOVE, 0, 0, 0, 0};
+    const SearchInfo last = info();
+
+    if(!last.pv.empty()) result.bestMove = last.pv[0];
+    if(last.pv.size() > 1) result.ponderMove = last.pv[1];
+
+    result.score = last.score;
+    result.depth = last.depth;
+    result.nodes = last.nodes;
+    result.seconds = last.seconds;
+
+    if(report && result.bestMove != NULL_PACKED_MOVE) report(last);
+    reporter = nullptr;
+
+    return result;
+}
+
+bool Mcts::timeUp()
+{
+    // No limit while pondering, the clock starts on the ponderhit
+    if(ponder == PONDER_HIT)
+    {
+        clockStart = std::chrono::steady_clock::now();
+        ponder = PONDER_OFF;
+    }
+
+    if(ponder != PONDER_OFF) return false;
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - clockStart).count();
+
+    // Unlike an iteration, a playout can always be cut short, so the soft limit is the real one
+    return softLimit > 0 && seconds >= softLimit;
+}
+
+void Mcts::worker(int id)
+{
+    Position pos = *rootPosition;
+    pos.keyHistory.reserve(pos.keyHistory.size() + MAX_PLY);
+
+    uint32_t path[MAX_PLY];
+    MoveUndo undos[MAX_PLY];
+    double lastReport = 0;
+
+    while(!stopped)
+    {
+        playout(pos, path, undos);
+
+        const uint64_t count = ++playouts;
+        if(limits.nodes && count >= limits.nodes) stopped = true;
+
+        // The first worker keeps the clock and the reports
+        if(id == 0 && (count & 255) == 0)
+        {
+            if(timeUp()) stopped = true;
+
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            if(reporter && *reporter && seconds - lastReport >= MCTS_REPORT_SECONDS)
+            {
+                (*reporter)(info());
+                lastReport = seconds;
+            }
+        }
+    }
+}
+
+void Mcts::playout(Position& pos, uint32_t *path, MoveUndo *undos)
+{
+    int length = 0;
+    uint32_t index = rootIndex;
+    double value;   // for the side to move at the end of the path
+
+    while(true)
+    {
+        Node& node = nodes[index];
+        path[length++] = index;
+
+        if(length > 1 && (pos.halfmoveClock >= 100 || pos.isRepetition(2)))
+        {
+            value = 0;
+            break;
+        }
+
+        const uint8_t state = node.state.load(std::memory_order_acquire);
+
+        if(state != NODE_EXPANDED)
+        {
+            uint8_t expected = NODE_LEAF;
+
+            // Only one thread expands a leaf, the others just evaluate it
+            if(state == NODE_LEAF && node.state.compare_exchange_strong(expected, NODE_EXPANDING))
+                value = expand(pos, node);
+            else
+                value = LeafValue(pos);
+
+            break;
+        }
+
+        if(node.childCount == 0)
+        {
+            value = pos.checkers() ? -1.0 : 0.0;
+            break;
+        }
+
+        if(length >= MAX_PLY - 1)
+        {
+            value = LeafValue(pos);
+            break;
+        }
+
+        index = select(node);
+        nodes[index].virtualLoss.fetch_add(MCTS_VIRTUAL_LOSS, std::memory_order_relaxed);
+        pos.makeMove(nodes[index].move, undos[length - 1]);
+    }
+
+    // Each node holds the value for the side that moved into it, which flips every ply
+    for(int i = length - 1; i >= 0; i--)
+    {
+        Node& node = nodes[path[i]];
+        value = -value;
+
+        node.valueSum.fetch_add(static_cast<int64_t>(value * VALUE_ONE), std::memory_order_relaxed);
+        node.visits.fetch_add(1, std::memory_order_relaxed);
+
+        if(i > 0)
+        {
+            node.virtualLoss.fetch_sub(MCTS_VIRTUAL_LOSS, std::memory_order_relaxed);
+            pos.unmakeMove(undos[i - 1]);
+        }
+    }
+
+    int deepest = maxDepth.load(std::memory_order_relaxed);
+    while(length - 1 > deepest && !maxDepth.compare_exchange_weak(deepest, length - 1)) {}
+}
+
+// Create the children with their priors and return the leaf's value. A terminal node gets no
+// children, a full arena leaves the node a leaf.
+double Mcts::expand(Position& pos, Node& node)
+{
+    MoveList moves;
+    GenerateLegalMoves(pos, moves);
+
+    if(moves.size() == 0)
+    {
+        node.childCount = 0;
+        node.state.store(NODE_EXPANDED, std::memory_order_release);
+        return pos.checkers() ? -1.0 : 0.0;
+    }
+
+    const double value = LeafValue(pos);
+    const uint32_t first = allocate(moves.size());
+
+    if(first == NO_NODE)
+    {
+        node.state.store(NODE_LEAF, std::memory_order_release);
+        return value;
+    }
+
+    // Priors from material won: captures by victim then attacker, promotions by the new piece
+    double priors[MAX_MOVES], total = 0;
+
+    for(int i = 0; i < moves.size(); i++)
+    {
+        const PackedMove move = moves[i];
+        double gain = PieceValue(static_cast<PieceType>(PackedPromotion(move) ? PackedPromotion(move) : NO_PIECE));
+
+        if(!IsQuietMove(pos, move))
+        {
+            const int from = PackedFrom(move), to = PackedTo(move);
+            const Piece victim = pos.position_grid[to % BOARD_SIZE][to / BOARD_SIZE];
+            const Piece attacker = pos.position_grid[from % BOARD_SIZE][from / BOARD_SIZE];
+
+            gain += PieceValue(victim.type == NO_PIECE ? (PackedPromotion(move) ? NO_PIECE : PAWN) : victim.type);
+            gain -= PieceValue(attacker.type) / 10.0;
+        }
+
+        priors[i] = std::exp(gain / MCTS_PRIOR_TEMPERATURE);
+        total += priors[i];
+    }
+
+    for(int i = 0; i < moves.size(); i++)
+        initNode(nodes[first + i], moves[i], static_cast<float>(priors[i] / total));
+
+    node.firstChild = first;
+    node.childCount = static_cast<uint16_t>(moves.size());
+    node.state.store(NODE_EXPANDED, std::memory_order_release);
+
+    return value;
+}
+
+// PUCT: the child's value plus an exploration term from its prior, which shrinks as it is visited.
+// Virtual losses count as lost visits, so threads in flight push the others to different children.
+uint32_t Mcts::select(const Node& node) const
+{
+    const double parentVisits = node.visits.load(std::memory_order_relaxed) + node.virtualLoss.load(std::memory_order_relaxed);
+    const double explore = MCTS_CPUCT * std::sqrt(std::max(1.0, parentVisits));
+
+    const uint32_t visits = node.visits.load(std::memory_order_relaxed);
+    const double parentValue = visits ? static_cast<double>(node.valueSum.load(std::memory_order_relaxed)) / VALUE_ONE / visits : 0;
+    const double firstPlay = -parentValue - MCTS_FPU_REDUCTION;
+
+    uint32_t best = node.firstChild;
+    double bestScore = -1e9;
+
+    for(uint32_t c = node.firstChild; c < node.firstChild + node.childCount; c++)
+    {
+        const Node& child = nodes[c];
+        const double n = child.visits.load(std::memory_order_relaxed);
+        const double loss = child.virtualLoss.load(std::memory_order_relaxed);
+
+        const double q = n + loss > 0
+                         ? (static_cast<double>(child.valueSum.load(std::memory_order_relaxed)) / VALUE_ONE - loss) / (n + loss)
+                         : firstPlay;
+        const double score = q + explore * child.prior / (1 + n + loss);
+
+        if(score > bestScore)
+        {
+            bestScore = score;
+            best = c;
+        }
+    }
+
+    return best;
+}
+
+// The most visited line from the root
+SearchInfo Mcts::info() const
+{
+    SearchInfo info;
+    info.depth = 0;
+    info.selDepth = maxDepth;
+    info.score = 0;
+    info.nodes = playouts;
+    info.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    uint32_t index = rootIndex;
+
+    while(info.pv.size() < MAX_PLY && nodes[index].state.load(std::memory_order_acquire) == NODE_EXPANDED)
+    {
+        const Node& node = nodes[index];
+        uint32_t best = NO_NODE, bestVisits = 0;
+
+        for(uint32_t c = node.firstChild; c < node.firstChild + node.childCount; c++)
+        {
+            const uint32_t visits = nodes[c].visits.load(std::memory_order_relaxed);
+            if(visits > bestVisits)
+            {
+                bestVisits = visits;
+                best = c;
+            }
+        }
+
+        if(best == NO_NODE) break;
+
+        if(info.pv.empty())
+            info.score = ValueToCentipawns(static_cast<double>(nodes[best].valueSum.load(std::memory_order_relaxed)) / VALUE_ONE / bestVisits);
+
+        info.pv.push_back(nodes[best].move);
+        index = best;
+    }
+
+    info.depth = static_cast<int>(info.pv.size());
+    return info;
+}
@@ -0,0 +1,81 @@
+#ifndef CHEESENG_MCTS_H
+#define CHEESENG_MCTS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "position.hpp"
+#include "search.hpp"
+
+// Playouts when neither a playout count nor a time limit is given
+#define MCTS_DEFAULT_PLAYOUTS 100000
+
+// Monte Carlo tree search with PUCT selection and static evaluation at the leaves. The nodes live in one
+// arena of fixed size, so the memory use is bounded: a full arena only stops the tree from growing.
+// Worker threads share the tree and spread out over it with virtual losses.
+class Mcts
+{
+public:
+    explicit Mcts(size_t megabytes=64);
+
+    void resize(size_t megabytes);
+    void clear();
+
+    // limits.nodes counts playouts, limits.depth is ignored. The tree of the last run is kept when
+    // root is one or two plies below its root.
+    SearchResult run(const Position& root, const SearchLimits& limits, int threads, const SearchReporter& report=SearchReporter());
+    void stop() { stopped = true; }
+
+    // As Search::ponderhit: the playouts go on, now under the time limits
+    bool ponderhit() { return PonderHit(ponder); }
+
+    size_t nodesUsed() const;
+    size_t capacity() const { return nodeCapacity; }
+
+private:
+    // The value sum is from the point of view of the side that played move, in VALUE_ONE units
+    struct Node
+    {
+        std::atomic<int64_t> valueSum;
+        std::atomic<uint32_t> visits;
+        std::atomic<int32_t> virtualLoss;
+        std::atomic<uint8_t> state;
+        uint32_t firstChild;            // written before state becomes expanded, read after
+        uint16_t childCount;
+        PackedMove move;
+        float prior;
+    };
+
+    void initNode(Node& node, PackedMove move, float prior);
+    uint32_t allocate(int count);
+    bool reuse(const Position& root);
+
+    void worker(int id);
+    void playout(Position& pos, uint32_t *path, MoveUndo *undos);
+    double expand(Position& pos, Node& node);
+    uint32_t select(const Node& node) const;
+
+    SearchInfo info() const;
+    bool timeUp();
+
+    std::unique_ptr<Node[]> nodes;
+    size_t nodeCapacity;
+    std::atomic<uint32_t> nextNode;
+
+    uint32_t rootIndex;
+    std::unique_ptr<Position> rootPosition;
+
+    SearchLimits limits;
+    const SearchReporter *reporter;
+    std::chrono::steady_clock::time_point start, clockStart;
+    double softLimit, hardLimit;        // seconds from clockStart
+    std::atomic<bool> stopped;
+    std::atomic<int> ponder;            // PonderState
+    std::atomic<uint64_t> playouts;
+    std::atomic<int> maxDepth;
+};
+
+#endif //CHEESENG_MCTS_H
@@ -1,6 +1,7 @@
 #include <iostream>
 #include <string.h>
 #include <ctype.h>
+#include <cstdlib>
 
 #include "lookups.hpp"
 #include "move.hpp"
@@ -113,12 +114,59 @@ void Move::createMoveString(Position& pos)
 
     switch(played.metadata.state)
     {
-        case CHECK:
-            algebraicNotation += '+';
-            break;
-
         case CHECKMATE:
             algebraicNotation += '#';
             break;
+
+        case CHECK:
+        case NORMAL:
+        case DRAW:
+        case INVALID:
+        case REPETITION:
+            if(played.metadata.inCheck) algebraicNotation += '+';
+            break;
+    }
+}
+
+PackedMove PackMove(const Move& move)
+{
+    const int promotion = move.promotionType == NO_PIECE ? 0 : move.promotionType;
+
+    return static_cast<PackedMove>(SquareIndex(move.from) | SquareIndex(move.to) << 6 | promotion << 12);
+}
+
+Move UnpackMove(PackedMove packed, const Position& pos)
+{
+    const int promotion = packed >> 12;
+    Move move(CoordFromIndex(packed & 63), CoordFromIndex((packed >> 6) & 63),
+              promotion ? static_cast<PieceType>(promotion) : NO_PIECE);
+
+    Piece moving = pos.getPieceAtCoord(move.from);
+
+    if(moving.type == KING && std::abs(move.to.file - move.from.file) == 2)
+    {
+        move.castlingType = move.to.file > move.from.file ? SHORT_CASTLE : LONG_CASTLE;
+    }
+    else if(pos.getPieceAtCoord(move.to).type != NO_PIECE)
+    {
+        move.catpureTarget = move.to;
+    }
+    else if(moving.type == PAWN && move.to.file != move.from.file)
+    {
+        move.catpureTarget = Coord(move.to.file, move.from.rank);
     }
+
+    return move;
+}
+
+std::string UciString(PackedMove move)
+{
+    static const char PROMOTION_CHARS[] = " nbrq";
+
+    const Coord from = CoordFromIndex(PackedFrom(move)), to = CoordFromIndex(PackedTo(move));
+    std::string uci = {from.FileChar(), from.RankChar(), to.FileChar(), to.RankChar()};
+
+    if(PackedPromotion(move)) uci += PROMOTION_CHARS[PackedPromotion(move)];
+
+    return uci;
 }
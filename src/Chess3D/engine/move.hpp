@@ -1,6 +1,7 @@
 #ifndef CHEESENG_MOVE_H
 #define CHEESENG_MOVE_H
 
+#include <cstdint>
 #include <vector>
 #include <string>
 #include <iostream>
@@ -31,4 +32,25 @@ struct Move
     void createMoveString(Position& pos);
 };
 
+// 16 bit move for tables and files: from | to << 6 | promotion << 12 (squares as SquareIndex).
+// Castling is stored as the king move, the position tells the rest.
+typedef uint16_t PackedMove;
+
+#define NULL_PACKED_MOVE 0
+
+inline PackedMove PackSquares(int from, int to, int promotion=0)
+{
+    return static_cast<PackedMove>(from | to << 6 | promotion << 12);
+}
+
+inline int PackedFrom(PackedMove move) { return move & 63; }
+inline int PackedTo(PackedMove move) { return (move >> 6) & 63; }
+inline int PackedPromotion(PackedMove move) { return move >> 12; }
+
+PackedMove PackMove(const Move& move);
+Move UnpackMove(PackedMove packed, const Position& pos);
+
+// Long algebraic notation as used by UCI, e.g. e2e4, e7e8q, e1g1 for castling
+std::string UciString(PackedMove move);
+
 #endif //CHEESENG_MOVE_H
@@ -0,0 +1,475 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "movegen.hpp"
+#include "bitboard.hpp"
+#include "boardstate.hpp"
+#include "stats.hpp"
+#include "alloctrack.hpp"
+
+static inline void AddTargets(MoveList& list, int from, Bitboard targets)
+{
+    while(targets) list.add(PackSquares(from, PopLowestSquare(targets)));
+}
+
+static inline void AddPromotions(MoveList& list, int from, int to)
+{
+    for(int type = QUEEN; type >= KNIGHT; type--) list.add(PackSquares(from, to, type));
+}
+
+// Own pieces standing alone between the king and an enemy slider on the same line
+template<PieceColor Us>
+static Bitboard PinnedPieces(const Position& pos, int king, Bitboard occupied)
+{
+    const Bitboard *them = pos.pieces[ColorTraits<Us>::Them];
+
+    Bitboard snipers = (RookAttacks(king, 0) & (them[ROOK] | them[QUEEN])) |
+                       (BishopAttacks(king, 0) & (them[BISHOP] | them[QUEEN]));
+    Bitboard pinned = 0;
+
+    while(snipers)
+    {
+        const Bitboard blockers = Between(king, PopLowestSquare(snipers)) & occupied;
+
+        if(blockers && !(blockers & (blockers - 1))) pinned |= blockers & pos.occupancy[Us];
+    }
+
+    return pinned;
+}
+
+template<PieceColor Us, GenType Type>
+static void GeneratePawnMoves(const Position& pos, MoveList& list, int king, Bitboard pinned, Bitboard checkMask)
+{
+    typedef ColorTraits<Us> Traits;
+    const int Up = Traits::Up;
+
+    const Bitboard occupied = pos.occupied();
+    const Bitboard enemies = pos.occupancy[Traits::Them];
+    const Bitboard pawns = pos.pieces[Us][PAWN];
+
+    // A pinned pawn may only move along the pin line
+    auto add = [&](int from, int to)
+    {
+        if((pinned & SQUARE_BB(from)) && !(Line(king, from) & SQUARE_BB(to))) return;
+
+        if(SQUARE_BB(to) & Traits::PromotionRank)
+            AddPromotions(list, from, to);
+        else
+            list.add(PackSquares(from, to));
+    };
+
+    // Promotions go with the captures, the other pushes are the quiet moves
+    const Bitboard singlePush = Shift<Up>(pawns) & ~occupied;
+    Bitboard push = singlePush & checkMask;
+    Bitboard doublePush = 0;
+
+    if(Type == GEN_CAPTURES) push &= Traits::PromotionRank;
+    if(Type == GEN_QUIETS)   push &= ~Traits::PromotionRank;
+    if(Type != GEN_CAPTURES) doublePush = Shift<Up>(singlePush & Traits::DoublePushRank) & ~occupied & checkMask;
+
+    while(push)
+    {
+        const int to = PopLowestSquare(push);
+        add(to - Up, to);
+    }
+
+    while(doublePush)
+    {
+        const int to = PopLowestSquare(doublePush);
+        add(to - 2 * Up, to);
+    }
+
+    if(Type == GEN_QUIETS) return;
+
+    // Captures towards the a file and towards the h file
+    Bitboard west = Shift<Up - 1>(pawns & ~FILE_A_BB) & enemies & checkMask;
+    Bitboard east = Shift<Up + 1>(pawns & ~FILE_H_BB) & enemies & checkMask;
+
+    while(west)
+    {
+        const int to = PopLowestSquare(west);
+        add(to - (Up - 1), to);
+    }
+
+    while(east)
+    {
+        const int to = PopLowestSquare(east);
+        add(to - (Up + 1), to);
+    }
+
+    if(!validCoord(pos.en_passant) || !pos.pieces[Us][KING]) return;
+
+    // En passant removes two pieces from a line at once, so it is checked directly: with the pawns
+    // moved, the king may not be attacked (this covers the pin along the rank and check evasion)
+    const int to = SquareIndex(pos.en_passant), captured = to - Up;
+    const Bitboard *them = pos.pieces[Traits::Them];
+
+    for(Bitboard candidates = PawnAttacks(Traits::Them, to) & pawns; candidates; )
+    {
+        const int from = PopLowestSquare(candidates);
+        const Bitboard after = (occupied ^ SQUARE_BB(from) ^ SQUARE_BB(captured)) | SQUARE_BB(to);
+
+        const Bitboard attackers = (KnightAttacks(king) & them[KNIGHT]) |
+                                   (PawnAttacks(Us, king) & them[PAWN] & ~SQUARE_BB(captured)) |
+                                   (BishopAttacks(king, after) & (them[BISHOP] | them[QUEEN])) |
+                                   (RookAttacks(king, after) & (them[ROOK] | them[QUEEN]));
+
+        if(!attackers) list.add(PackSquares(from, to));
+    }
+}
+
+template<PieceColor Us, GenType Type>
+void GenerateMoves(const Position& pos, MoveList& list)
+{
+    typedef ColorTraits<Us> Traits;
+    const PieceColor Them = Traits::Them;
+
+    const Bitboard us = pos.occupancy[Us];
+    const Bitboard occupied = pos.occupied();
+
+    // Squares the moves of this type may land on
+    const Bitboard typeMask = Type == GEN_CAPTURES ? pos.occupancy[Them] : Type == GEN_QUIETS ? ~occupied : ~us;
+
+    // Positions without a king (editor setups) get pseudo legal moves
+    const bool hasKing = pos.pieces[Us][KING] != 0;
+    const int king = hasKing ? LowestSquare(pos.pieces[Us][KING]) : 0;
+
+    Bitboard checkers = 0, pinned = 0;
+    Bitboard checkMask = ~Bitboard(0);
+
+    if(hasKing)
+    {
+        checkers = pos.attackersTo<Them>(king, occupied);
+
+        // The king itself may not block the ray of a slider it is stepping away from
+        const Bitboard withoutKing = occupied ^ SQUARE_BB(king);
+
+        for(Bitboard targets = KingAttacks(king) & typeMask; targets; )
+        {
+            const int to = PopLowestSquare(targets);
+            if(!pos.attackersTo<Them>(to, withoutKing)) list.add(PackSquares(king, to));
+        }
+
+        // Only the king moves out of a double check
+        if(checkers & (checkers - 1)) return;
+
+        if(checkers) checkMask = Between(king, LowestSquare(checkers)) | checkers;
+
+        pinned = PinnedPieces<Us>(pos, king, occupied);
+    }
+
+    GeneratePawnMoves<Us, Type>(pos, list, king, pinned, checkMask);
+
+    const Bitboard targetMask = typeMask & checkMask;
+
+    // A pinned knight can never move
+    for(Bitboard knights = pos.pieces[Us][KNIGHT] & ~pinned; knights; )
+    {
+        const int from = PopLowestSquare(knights);
+        AddTargets(list, from, KnightAttacks(from) & targetMask);
+    }
+
+    for(int type = BISHOP; type <= QUEEN; type++)
+    {
+        for(Bitboard sliders = pos.pieces[Us][type]; sliders; )
+        {
+            const int from = PopLowestSquare(sliders);
+
+            Bitboard targets = 0;
+            if(type != ROOK)   targets |= BishopAttacks(from, occupied);
+            if(type != BISHOP) targets |= RookAttacks(from, occupied);
+
+            targets &= targetMask;
+            if(pinned & SQUARE_BB(from)) targets &= Line(king, from);
+
+            AddTargets(list, from, targets);
+        }
+    }
+
+    if(Type == GEN_CAPTURES || !hasKing || checkers || king != Traits::KingStart) return;
+
+    const Bitboard rooks = pos.pieces[Us][ROOK];
+
+    if(pos.castling_rights[Us][SHORT_CASTLE] && (rooks & SQUARE_BB(Traits::ShortRookStart)) &&
+       !(Between(king, Traits::ShortRookStart) & occupied) &&
+       !pos.attackersTo<Them>(king + 1, occupied) && !pos.attackersTo<Them>(king + 2, occupied))
+        list.add(PackSquares(king, Traits::ShortKingTarget));
+
+    if(pos.castling_rights[Us][LONG_CASTLE] && (rooks & SQUARE_BB(Traits::LongRookStart)) &&
+       !(Between(king, Traits::LongRookStart) & occupied) &&
+       !pos.attackersTo<Them>(king - 1, occupied) && !pos.attackersTo<Them>(king - 2, occupied))
+        list.add(PackSquares(king, Traits::LongKingTarget));
+}
+
+template void GenerateMoves<WHITE, GEN_ALL>(const Position& pos, MoveList& list);
+template void GenerateMoves<BLACK, GEN_ALL>(const Position& pos, MoveList& list);
+template void GenerateMoves<WHITE, GEN_CAPTURES>(const Position& pos, MoveList& list);
+template void GenerateMoves<BLACK, GEN_CAPTURES>(const Position& pos, MoveList& list);
+template void GenerateMoves<WHITE, GEN_QUIETS>(const Position& pos, MoveList& list);
+template void GenerateMoves<BLACK, GEN_QUIETS>(const Position& pos, MoveList& list);
+
+void GenerateMoves(const Position& pos, MoveList& list, GenType type)
+{
+    const bool white = pos.color_playing == WHITE;
+
+    STAT_INC(static_cast<StatCounter>(STAT_GEN_ALL + type));
+
+    switch(type)
+    {
+        case GEN_ALL:      white ? GenerateMoves<WHITE, GEN_ALL>(pos, list)      : GenerateMoves<BLACK, GEN_ALL>(pos, list); break;
+        case GEN_CAPTURES: white ? GenerateMoves<WHITE, GEN_CAPTURES>(pos, list) : GenerateMoves<BLACK, GEN_CAPTURES>(pos, list); break;
+        case GEN_QUIETS:   white ? GenerateMoves<WHITE, GEN_QUIETS>(pos, list)   : GenerateMoves<BLACK, GEN_QUIETS>(pos, list); break;
+    }
+}
+
+void GenerateLegalMoves(const Position& pos, MoveList& list)
+{
+    GenerateMoves(pos, list, GEN_ALL);
+}
+
+// The checks of GenerateMoves, stopping at the first legal move. The king steps come first: they are
+// the only moves out of a double check, and one of them exists whenever castling is legal.
+template<PieceColor Us>
+static bool HasLegalMoveColor(const Position& pos)
+{
+    typedef ColorTraits<Us> Traits;
+    const PieceColor Them = Traits::Them;
+
+    const Bitboard us = pos.occupancy[Us];
+    const Bitboard occupied = pos.occupied();
+    const int king = LowestSquare(pos.pieces[Us][KING]);
+    const Bitboard withoutKing = occupied ^ SQUARE_BB(king);
+
+    for(Bitboard targets = KingAttacks(king) & ~us; targets; )
+        if(!pos.attackersTo<Them>(PopLowestSquare(targets), withoutKing)) return true;
+
+    const Bitboard checkers = pos.attackersTo<Them>(king, occupied);
+    if(checkers & (checkers - 1)) return false;
+
+    const Bitboard checkMask = checkers ? Between(king, LowestSquare(checkers)) | checkers : ~Bitboard(0);
+    const Bitboard pinned = PinnedPieces<Us>(pos, king, occupied);
+    const Bitboard targetMask = ~us & checkMask;
+
+    for(Bitboard knights = pos.pieces[Us][KNIGHT] & ~pinned; knights; )
+        if(KnightAttacks(PopLowestSquare(knights)) & targetMask) return true;
+
+    for(int type = BISHOP; type <= QUEEN; type++)
+    {
+        for(Bitboard sliders = pos.pieces[Us][type]; sliders; )
+        {
+            const int from = PopLowestSquare(sliders);
+
+            Bitboard targets = 0;
+            if(type != ROOK)   targets |= BishopAttacks(from, occupied);
+            if(type != BISHOP) targets |= RookAttacks(from, occupied);
+
+            targets &= targetMask;
+            if(pinned & SQUARE_BB(from)) targets &= Line(king, from);
+
+            if(targets) return true;
+        }
+    }
+
+    MoveList pawnMoves;
+    GeneratePawnMoves<Us, GEN_ALL>(pos, pawnMoves, king, pinned, checkMask);
+
+    return pawnMoves.size() != 0;
+}
+
+bool HasLegalMove(const Position& pos)
+{
+    // Positions without a king (editor setups) get the pseudo legal moves of the generator
+    if(!pos.pieces[pos.color_playing][KING])
+    {
+        MoveList moves;
+        GenerateLegalMoves(pos, moves);
+        return moves.size() != 0;
+    }
+
+    return pos.color_playing == WHITE ? HasLegalMoveColor<WHITE>(pos) : HasLegalMoveColor<BLACK>(pos);
+}
+
+template<PieceColor Us>
+static bool IsLegalMoveColor(const Position& pos, PackedMove move)
+{
+    typedef ColorTraits<Us> Traits;
+    const PieceColor Them = Traits::Them;
+
+    const int from = PackedFrom(move), to = PackedTo(move), promotion = PackedPromotion(move);
+    const Piece moving = pos.position_grid[from % BOARD_SIZE][from / BOARD_SIZE];
+    const Bitboard occupied = pos.occupied();
+    const Bitboard enemies = pos.occupancy[Them];
+
+    if(from == to || moving.type == NO_PIECE || moving.color != Us || (pos.occupancy[Us] & SQUARE_BB(to)))
+        return false;
+
+    // Promotions: exactly the pawn moves onto the last rank, to N, B, R or Q
+    const bool promotes = moving.type == PAWN && (SQUARE_BB(to) & Traits::PromotionRank);
+    if(promotes != (promotion != 0) || (promotion && (promotion < KNIGHT || promotion > QUEEN))) return false;
+
+    const bool hasKing = pos.pieces[Us][KING] != 0;
+    const int king = hasKing ? LowestSquare(pos.pieces[Us][KING]) : 0;
+    int captured = (enemies & SQUARE_BB(to)) ? to : -1;
+
+    switch(moving.type)
+    {
+        case PAWN:
+        {
+            const bool enPassant = validCoord(pos.en_passant) && to == SquareIndex(pos.en_passant);
+
+            if(to == from + Traits::Up)
+            {
+                if(occupied & SQUARE_BB(to)) return false;
+            }
+            else if(to == from + 2 * Traits::Up)
+            {
+                if(!(SQUARE_BB(from + Traits::Up) & Traits::DoublePushRank) ||
+                   (occupied & (SQUARE_BB(to) | SQUARE_BB(from + Traits::Up))))
+                    return false;
+            }
+            else if(PawnAttacks(Us, from) & SQUARE_BB(to))
+            {
+                if(enPassant) captured = to - Traits::Up;
+                else if(captured < 0) return false;
+            }
+            else
+            {
+                return false;
+            }
+            break;
+        }
+
+        case KNIGHT: if(!(KnightAttacks(from) & SQUARE_BB(to))) return false; break;
+        case BISHOP: if(!(BishopAttacks(from, occupied) & SQUARE_BB(to))) return false; break;
+        case ROOK:   if(!(RookAttacks(from, occupied) & SQUARE_BB(to))) return false; break;
+        case QUEEN:  if(!((BishopAttacks(from, occupied) | RookAttacks(from, occupied)) & SQUARE_BB(to))) return false; break;
+
+        case KING:
+        {
+            if(KingAttacks(from) & SQUARE_BB(to)) break;
+
+            // Castling: the quiet generator has all the conditions
+            if(from != Traits::KingStart || (to != Traits::ShortKingTarget && to != Traits::LongKingTarget)) return false;
+
+            MoveList quiets;
+            GenerateMoves<Us, GEN_QUIETS>(pos, quiets);
+            for(PackedMove quiet : quiets) if(quiet == move) return true;
+            return false;
+        }
+
+        default: return false;
+    }
+
+    if(!hasKing) return true;
+
+    // Play it on the occupancy and look for attackers of the king, ignoring a captured piece
+    Bitboard after = (occupied ^ SQUARE_BB(from)) | SQUARE_BB(to);
+    Bitboard removed = 0;
+
+    if(captured >= 0)
+    {
+        removed = SQUARE_BB(captured);
+        after &= ~removed | SQUARE_BB(to);
+    }
+
+    const int kingAfter = moving.type == KING ? to : king;
+
+    return !(pos.attackersTo<Them>(kingAfter, after) & ~removed);
+}
+
+bool IsLegalMove(const Position& pos, PackedMove move)
+{
+    return pos.color_playing == WHITE ? IsLegalMoveColor<WHITE>(pos, move) : IsLegalMoveColor<BLACK>(pos, move);
+}
+
+bool IsQuietMove(const Position& pos, PackedMove move)
+{
+    const int from = PackedFrom(move), to = PackedTo(move);
+
+    if(PackedPromotion(move) || (pos.occupied() & SQUARE_BB(to))) return false;
+
+    // A pawn changing file onto an empty square takes en passant
+    return !((pos.pieces[WHITE][PAWN] | pos.pieces[BLACK][PAWN]) & SQUARE_BB(from)) || (from - to) % BOARD_SIZE == 0;
+}
+
+template<PieceColor Us>
+static uint64_t PerftColor(Position& pos, int depth)
+{
+    MoveList moves;
+    GenerateMoves<Us, GEN_ALL>(pos, moves);
+
+    // Counting the last ply needs no make / unmake
+    if(depth == 1) return moves.size();
+
+    uint64_t nodes = 0;
+    MoveUndo undo;
+
+    for(PackedMove move : moves)
+    {
+        pos.makeMove<Us>(move, undo);
+        nodes += PerftColor<ColorTraits<Us>::Them>(pos, depth - 1);
+        pos.unmakeMove<Us>(undo);
+    }
+
+    return nodes;
+}
+
+uint64_t Perft(Position& pos, int depth)
+{
+    if(depth <= 0) return 1;
+
+    // Room for every key make pushes, so the tree walk itself never allocates
+    pos.keyHistory.reserve(pos.keyHistory.size() + depth);
+
+    ALLOC_SCOPE(ALLOC_PERFT);
+    return pos.color_playing == WHITE ? PerftColor<WHITE>(pos, depth) : PerftColor<BLACK>(pos, depth);
+}
+
+uint64_t PerftParallel(const Position& pos, int depth, int threads)
+{
+    ALLOC_SCOPE(ALLOC_PERFT_ROOT);
+
+    if(depth <= 1 || threads <= 1)
+    {
+        Position copy = pos;
+        return Perft(copy, depth);
+    }
+
+    MoveList moves;
+    GenerateLegalMoves(pos, moves);
+
+    // The children are plain bytes, the workers build their own Position from them
+    std::vector<BoardState> children;
+    Position root = pos;
+
+    for(PackedMove move : moves)
+    {
+        MoveUndo undo;
+        root.makeMove(move, undo);
+        children.push_back(BoardStateFromPosition(root));
+        root.unmakeMove(undo);
+    }
+
+    std::atomic<size_t> next(0);
+    std::atomic<uint64_t> nodes(0);
+    std::vector<std::thread> workers;
+
+    for(int t = 0; t < threads; t++)
+    {
+        workers.emplace_back([&]()
+        {
+            ALLOC_SCOPE(ALLOC_PERFT_ROOT);
+
+            for(size_t i; (i = next++) < children.size(); )
+            {
+                Position child(children[i]);
+                nodes += Perft(child, depth - 1);
+            }
+        });
+    }
+
+    for(std::thread& worker : workers) worker.join();
+
+    return nodes;
+}
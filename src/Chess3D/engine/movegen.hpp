@@ -0,0 +1,51 @@
+#ifndef CHEESENG_MOVEGEN_H
+#define CHEESENG_MOVEGEN_H
+
+#include <cstdint>
+
+#include "move.hpp"
+#include "position.hpp"
+
+// No legal chess position has more than 218 moves
+#define MAX_MOVES 256
+
+struct MoveList
+{
+    PackedMove moves[MAX_MOVES];
+    int count = 0;
+
+    void add(PackedMove move) { moves[count++] = move; }
+    int size() const { return count; }
+
+    PackedMove operator[](int i) const { return moves[i]; }
+    const PackedMove *begin() const { return moves; }
+    const PackedMove *end() const { return moves + count; }
+};
+
+// GEN_CAPTURES: captures, en passant and all promotions. GEN_QUIETS: everything else, castling included.
+enum GenType{GEN_ALL, GEN_CAPTURES, GEN_QUIETS};
+
+// Legal moves of the side to move, castling as the king move. Pins and checks are resolved with
+// the between / line masks, so no move is made to test it. Dispatches once on the side to move.
+void GenerateLegalMoves(const Position& pos, MoveList& list);
+void GenerateMoves(const Position& pos, MoveList& list, GenType type);
+
+template<PieceColor Us, GenType Type>
+void GenerateMoves(const Position& pos, MoveList& list);
+
+// Does the side to move have a legal move: the mate / stalemate test, stopping at the first one found
+bool HasLegalMove(const Position& pos);
+
+// Is a move from a table (hash move, killer) legal here, without generating the moves
+bool IsLegalMove(const Position& pos, PackedMove move);
+
+// Not a capture, en passant or promotion: the moves GEN_QUIETS produces
+bool IsQuietMove(const Position& pos, PackedMove move);
+
+// Number of leaf nodes of the legal move tree, the standard move generator check
+uint64_t Perft(Position& pos, int depth);
+
+// The same count with the root moves shared out to `threads` workers, each starting from a BoardState copy
+uint64_t PerftParallel(const Position& pos, int depth, int threads);
+
+#endif //CHEESENG_MOVEGEN_H
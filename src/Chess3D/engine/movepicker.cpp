@@ -0,0 +1,149 @@
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+#include "movepicker.hpp"
+
+// History scores saturate at this bound, so recent cutoffs keep their weight
+#define HISTORY_MAX 16384
+
+void HistoryTable::clear()
+{
+    std::memset(scores, 0, sizeof scores);
+}
+
+void HistoryTable::update(PieceColor color, PackedMove move, int bonus)
+{
+    int& score = scores[color][PackedFrom(move)][PackedTo(move)];
+
+    if(bonus > HISTORY_MAX) bonus = HISTORY_MAX;
+    if(bonus < -HISTORY_MAX) bonus = -HISTORY_MAX;
+
+    score += bonus - score * std::abs(bonus) / HISTORY_MAX;
+}
+
+MovePicker::MovePicker(const Position& pos, PackedMove ttMove, const PackedMove *killers, const HistoryTable *history)
+    : pos(pos), ttMove(ttMove), history(history), skipQuiets(false), currentStage(STAGE_TT), current(0), killerIndex(0)
+{
+    this->killers[0] = killers ? killers[0] : NULL_PACKED_MOVE;
+    this->killers[1] = killers ? killers[1] : NULL_PACKED_MOVE;
+}
+
+MovePicker::MovePicker(const Position& pos, PackedMove ttMove, bool inCheck)
+    : pos(pos), ttMove(ttMove), history(nullptr), skipQuiets(!inCheck), currentStage(STAGE_TT), current(0), killerIndex(0)
+{
+    killers[0] = killers[1] = NULL_PACKED_MOVE;
+}
+
+// Most valuable victim first, then least valuable attacker. Promotions count as winning the new piece.
+void MovePicker::scoreCaptures()
+{
+    for(int i = 0; i < moves.size(); i++)
+    {
+        const int from = PackedFrom(moves[i]), to = PackedTo(moves[i]);
+        const Piece attacker = pos.position_grid[from % BOARD_SIZE][from / BOARD_SIZE];
+        const Piece victim = pos.position_grid[to % BOARD_SIZE][to / BOARD_SIZE];
+
+        // An empty target square on a capture is en passant
+        const int victimType = victim.type == NO_PIECE ? (PackedPromotion(moves[i]) ? -1 : PAWN) : victim.type;
+
+        scores[i] = (victimType + 1) * 8 - attacker.type;
+        if(PackedPromotion(moves[i])) scores[i] += PackedPromotion(moves[i]) * 8;
+    }
+}
+
+void MovePicker::scoreQuiets()
+{
+    for(int i = 0; i < moves.size(); i++)
+        scores[i] = history ? history->get(pos.color_playing, moves[i]) : 0;
+}
+
+// Selection of the best remaining move: cheap when only the first few moves are ever looked at
+PackedMove MovePicker::pickBest()
+{
+    int best = current;
+
+    for(int i = current + 1; i < moves.size(); i++)
+        if(scores[i] > scores[best]) best = i;
+
+    std::swap(moves.moves[current], moves.moves[best]);
+    std::swap(scores[current], scores[best]);
+
+    return moves[current++];
+}
+
+bool MovePicker::isTried(PackedMove move) const
+{
+    return move == ttMove || (currentStage == STAGE_QUIETS && (move == killers[0] || move == killers[1]));
+}
+
+PackedMove MovePicker::next()
+{
+    switch(currentStage)
+    {
+        case STAGE_TT:
+            currentStage = STAGE_CAPTURES_INIT;
+
+            // A quiet hash move in quiescence is left out like every other quiet move
+            if(ttMove != NULL_PACKED_MOVE && IsLegalMove(pos, ttMove) && !(skipQuiets && IsQuietMove(pos, ttMove)))
+                return ttMove;
+
+            return next();
+
+        case STAGE_CAPTURES_INIT:
+            moves.count = 0;
+            current = 0;
+            GenerateMoves(pos, moves, GEN_CAPTURES);
+            scoreCaptures();
+            currentStage = STAGE_CAPTURES;
+            return next();
+
+        case STAGE_CAPTURES:
+            while(current < moves.size())
+            {
+                PackedMove move = pickBest();
+                if(!isTried(move)) return move;
+            }
+
+            currentStage = skipQuiets ? STAGE_DONE : STAGE_KILLERS;
+            return next();
+
+        case STAGE_KILLERS:
+            // Killers are quiet moves that cut off at the same ply elsewhere; they may not even be legal here
+            while(killerIndex < 2)
+            {
+                PackedMove killer = killers[killerIndex++];
+
+                if(killer == NULL_PACKED_MOVE || killer == ttMove) continue;
+                if(killerIndex == 2 && killer == killers[0]) continue;
+
+                if(IsQuietMove(pos, killer) && IsLegalMove(pos, killer)) return killer;
+            }
+
+            currentStage = STAGE_QUIETS_INIT;
+            return next();
+
+        case STAGE_QUIETS_INIT:
+            moves.count = 0;
+            current = 0;
+            GenerateMoves(pos, moves, GEN_QUIETS);
+            scoreQuiets();
+            currentStage = STAGE_QUIETS;
+            return next();
+
+        case STAGE_QUIETS:
+            while(current < moves.size())
+            {
+                PackedMove move = pickBest();
+                if(!isTried(move)) return move;
+            }
+
+            currentStage = STAGE_DONE;
+            return NULL_PACKED_MOVE;
+
+        case STAGE_DONE:
+            break;
+    }
+
+    return NULL_PACKED_MOVE;
+}
@@ -0,0 +1,57 @@
+#ifndef CHEESENG_MOVEPICKER_H
+#define CHEESENG_MOVEPICKER_H
+
+#include <cstdint>
+
+#include "movegen.hpp"
+#include "position.hpp"
+
+// Quiet move scores by [color][from][to], raised on beta cutoffs by the search
+struct HistoryTable
+{
+    int scores[PLAYER_COUNT][64][64];
+
+    void clear();
+    void update(PieceColor color, PackedMove move, int bonus);
+    int get(PieceColor color, PackedMove move) const { return scores[color][PackedFrom(move)][PackedTo(move)]; }
+};
+
+enum PickStage{STAGE_TT, STAGE_CAPTURES_INIT, STAGE_CAPTURES, STAGE_KILLERS, STAGE_QUIETS_INIT, STAGE_QUIETS, STAGE_DONE};
+
+// Hands out the legal moves of a node one at a time, generating each group only when it is reached:
+// the hash move (validated, not generated), captures and promotions by MVV-LVA, the killers,
+// then the quiet moves by history. A cutoff in an early stage skips the later generation entirely.
+class MovePicker
+{
+public:
+    MovePicker(const Position& pos, PackedMove ttMove, const PackedMove *killers, const HistoryTable *history);
+
+    // Quiescence: hash move and captures only, unless in check where every evasion is needed
+    MovePicker(const Position& pos, PackedMove ttMove, bool inCheck);
+
+    // NULL_PACKED_MOVE once every move was returned
+    PackedMove next();
+
+    PickStage stage() const { return currentStage; }
+
+private:
+    void scoreCaptures();
+    void scoreQuiets();
+    PackedMove pickBest();
+    bool isTried(PackedMove move) const;
+
+    const Position& pos;
+    PackedMove ttMove;
+    PackedMove killers[2];
+    const HistoryTable *history;
+    bool skipQuiets;
+
+    PickStage currentStage;
+    int current;
+    int killerIndex;
+
+    MoveList moves;
+    int scores[MAX_MOVES];
+};
+
+#endif //CHEESENG_MOVEPICKER_H
@@ -0,0 +1,499 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cctype>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include "pgn.hpp"
+#include "move.hpp"
+#include "san.hpp"
+
+// Games handed to a worker at a time
+static const size_t PGN_BATCH_SIZE = 64;
+
+// Suffix annotations and their NAG equivalents
+static const struct { const char *symbol; int nag; } SUFFIX_NAGS[] =
+{
+    {"!!", 3}, {"??", 4}, {"!?", 5}, {"?!", 6}, {"!", 1}, {"?", 2}
+};
+
+void PgnGame::clear()
+{
+    tags.clear();
+    moves.clear();
+    comment.clear();
+    result.clear();
+}
+
+const std::string *PgnGame::getTag(const std::string& name) const
+{
+    for(const PgnTag& tag : tags)
+        if(tag.name == name) return &tag.value;
+
+    return nullptr;
+}
+
+std::string PgnGame::startingFEN() const
+{
+    const std::string *fen = getTag("FEN");
+
+    return fen ? *fen : PGN_STARTING_FEN;
+}
+
+static bool IsResultToken(const char *p, const char *end, size_t& length)
+{
+    static const char *RESULTS[] = {"1-0", "0-1", "1/2-1/2", "*"};
+
+    for(const char *result : RESULTS)
+    {
+        size_t n = std::strlen(result);
+        if(static_cast<size_t>(end - p) >= n && std::memcmp(p, result, n) == 0)
+        {
+            length = n;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Skip a balanced (...) variation, p points at the opening bracket
+static const char *SkipVariation(const char *p, const char *end)
+{
+    int depth = 0;
+
+    for(; p < end; p++)
+    {
+        if(*p == '{')
+        {
+            const char *close = static_cast<const char *>(std::memchr(p, '}', end - p));
+            if(!close) return end;
+            p = close;
+        }
+        else if(*p == '(') depth++;
+        else if(*p == ')' && --depth == 0) return p + 1;
+    }
+
+    return end;
+}
+
+bool ParsePgnGame(const char *begin, const char *end, PgnGame& game, PgnAnnotationMode mode)
+{
+    const bool keep = mode == PGN_KEEP_ANNOTATIONS;
+    const char *p = begin;
+
+    game.clear();
+
+    while(p < end)
+    {
+        char c = *p;
+
+        if(std::isspace(static_cast<unsigned char>(c)))
+        {
+            p++;
+        }
+        else if(c == '[')
+        {
+            // [Name "Value"]
+            PgnTag tag;
+            for(p++; p < end && std::isspace(static_cast<unsigned char>(*p)); p++);
+            for(; p < end && !std::isspace(static_cast<unsigned char>(*p)) && *p != '"' && *p != ']'; p++) tag.name += *p;
+            for(; p < end && *p != '"' && *p != ']'; p++);
+
+            if(p < end && *p == '"')
+            {
+                for(p++; p < end && *p != '"'; p++)
+                {
+                    if(*p == '\\' && p + 1 < end) p++;
+                    tag.value += *p;
+                }
+            }
+
+            for(; p < end && *p != ']' && *p != '\n'; p++);
+            if(p < end && *p == ']') p++;
+
+            game.tags.push_back(tag);
+        }
+        else if(c == '{')
+        {
+            const char *close = static_cast<const char *>(std::memchr(p, '}', end - p));
+            if(!close) close = end;
+
+            if(keep)
+            {
+                std::string& target = game.moves.empty() ? game.comment : game.moves.back().comment;
+                if(!target.empty()) target += ' ';
+                target.append(p + 1, close);
+            }
+
+            p = close < end ? close + 1 : end;
+        }
+        else if(c == ';' || (c == '%' && (p == begin || p[-1] == '\n')))
+        {
+            const char *eol = static_cast<const char *>(std::memchr(p, '\n', end - p));
+            p = eol ? eol + 1 : end;
+        }
+        else if(c == '(')
+        {
+            const char *close = SkipVariation(p, end);
+
+            if(keep && !game.moves.empty())
+                game.moves.back().variations.push_back(std::string(p + 1, close - (close[-1] == ')')));
+
+            p = close;
+        }
+        else if(c == '$')
+        {
+            int nag = 0;
+            for(p++; p < end && std::isdigit(static_cast<unsigned char>(*p)); p++) nag = nag * 10 + (*p - '0');
+
+            if(keep && !game.moves.empty()) game.moves.back().nags.push_back(nag);
+        }
+        else
+        {
+            size_t resultLength;
+            if(IsResultToken(p, end, resultLength))
+            {
+                game.result.assign(p, resultLength);
+                p += resultLength;
+                continue;
+            }
+
+            if(std::isdigit(static_cast<unsigned char>(c)) && c != '0')
+            {
+                // Move number: "12." or "12..."
+                const char *q = p;
+                while(q < end && std::isdigit(static_cast<unsigned char>(*q))) q++;
+                if(q == end || *q == '.' || std::isspace(static_cast<unsigned char>(*q)))
+                {
+                    for(p = q; p < end && *p == '.'; p++);
+                    continue;
+                }
+            }
+
+            const char *tokenEnd = p;
+            while(tokenEnd < end && !std::isspace(static_cast<unsigned char>(*tokenEnd)) &&
+                  !std::strchr("{}();$[", *tokenEnd))
+                tokenEnd++;
+
+            if(tokenEnd == p)
+            {
+                // Stray closing bracket or similar, ignore it
+                p++;
+                continue;
+            }
+
+            PgnMove move;
+            move.offset = p - begin;
+
+            const char *sanEnd = tokenEnd;
+            while(sanEnd > p && (sanEnd[-1] == '!' || sanEnd[-1] == '?')) sanEnd--;
+            move.san.assign(p, sanEnd);
+
+            if(keep && sanEnd != tokenEnd)
+            {
+                std::string suffix(sanEnd, tokenEnd);
+                for(const auto& entry : SUFFIX_NAGS)
+                {
+                    if(suffix == entry.symbol)
+                    {
+                        move.nags.push_back(entry.nag);
+                        break;
+                    }
+                }
+            }
+
+            game.moves.push_back(move);
+            p = tokenEnd;
+        }
+    }
+
+    return !game.tags.empty() || !game.moves.empty();
+}
+
+static bool AllDigits(const std::string& text)
+{
+    return !text.empty() && text.size() <= 9 && std::all_of(text.begin(), text.end(), [](char c) { return c >= '0' && c <= '9'; });
+}
+
+bool PlausibleFEN(const std::string& fen)
+{
+    std::istringstream in(fen);
+    std::string placement, side, castling, enPassant, halfmove, fullmove, extra;
+
+    if(!(in >> placement >> side >> castling >> enPassant)) return false;
+    if(in >> halfmove && (!AllDigits(halfmove) || (in >> fullmove && !AllDigits(fullmove)) || in >> extra))
+        return false;
+
+    if(side != "w" && side != "b") return false;
+
+    if(castling != "-")
+    {
+        if(castling.size() > 4) return false;
+
+        for(char c : castling)
+            if(!c || !std::strchr("KQkq", c)) return false;
+    }
+
+    if(enPassant != "-" && (enPassant.size() != 2 || enPassant[0] < 'a' || enPassant[0] > 'h' ||
+                            enPassant[1] != (side == "w" ? '6' : '3')))
+        return false;
+
+    int ranks = 1, files = 0;
+
+    for(char c : placement)
+    {
+        if(c == '/')
+        {
+            if(files != BOARD_SIZE) return false;
+
+            ranks++;
+            files = 0;
+        }
+        else if(c >= '1' && c <= '8')
+        {
+            files += c - '0';
+        }
+        else if(c && std::strchr("pnbrqkPNBRQK", c))
+        {
+            files++;
+        }
+        else
+        {
+            return false;
+        }
+
+        if(files > BOARD_SIZE) return false;
+    }
+
+    return ranks == BOARD_SIZE && files == BOARD_SIZE;
+}
+
+bool ReplayPgnGame(const PgnGame& game, const PgnPositionVisitor& visitor, int worker, PgnError *error,
+                   bool validateSuffixes)
+{
+    const std::string fen = game.startingFEN();
+
+    if(!PlausibleFEN(fen))
+    {
+        if(error) *error = PgnError{game.index, 0, game.line, 1, "", "bad FEN tag"};
+        return false;
+    }
+
+    Position pos(fen);
+
+    if(visitor) visitor(worker, game, pos, 0);
+
+    for(size_t ply = 0; ply < game.moves.size(); ply++)
+    {
+        const PgnMove& pgnMove = game.moves[ply];
+        Move move;
+
+        SanResult result = ResolveSAN(pos, pgnMove.san.data(), pgnMove.san.size(), move, validateSuffixes);
+        if(result != SAN_OK)
+        {
+            if(error) *error = PgnError{game.index, static_cast<int>(ply + 1), 0, 0, pgnMove.san, SanResultString(result)};
+            return false;
+        }
+
+        pos.applyMove(move);
+
+        if(visitor) visitor(worker, game, pos, static_cast<int>(ply + 1));
+    }
+
+    return true;
+}
+
+PgnReader::PgnReader() {}
+
+bool PgnReader::open(const std::string& path)
+{
+    gameOffsets.clear();
+    gameLines.clear();
+
+    if(!file.open(path)) return false;
+
+    splitGames();
+    return true;
+}
+
+// A game starts at the first tag line that follows movetext (or at the start of the file).
+// Braced comments may span lines and are skipped so a '[' inside them does not split a game.
+void PgnReader::splitGames()
+{
+    const char *data = file.data();
+    const size_t size = file.size();
+
+    bool sawMovetext = true;
+    bool lineStart = true;
+    int line = 1;
+
+    for(size_t i = 0; i < size; i++)
+    {
+        char c = data[i];
+
+        if(c == '\n')
+        {
+            line++;
+            lineStart = true;
+            continue;
+        }
+
+        if(lineStart && c == '[')
+        {
+            if(sawMovetext)
+            {
+                gameOffsets.push_back(i);
+                gameLines.push_back(line);
+                sawMovetext = false;
+            }
+
+            // Skip the rest of the tag line
+            const char *eol = static_cast<const char *>(std::memchr(data + i, '\n', size - i));
+            i = eol ? (eol - data) - 1 : size;
+            lineStart = false;
+            continue;
+        }
+
+        lineStart = false;
+
+        if(std::isspace(static_cast<unsigned char>(c))) continue;
+
+        if(gameOffsets.empty())
+        {
+            // Movetext without a tag section at the start of the file
+            gameOffsets.push_back(i);
+            gameLines.push_back(line);
+        }
+
+        sawMovetext = true;
+
+        if(c == '{')
+        {
+            for(i++; i < size && data[i] != '}'; i++)
+                if(data[i] == '\n') line++;
+        }
+    }
+}
+
+bool PgnReader::parseGame(size_t index, PgnGame& game, PgnAnnotationMode mode) const
+{
+    if(index >= gameOffsets.size()) return false;
+
+    size_t begin = gameOffsets[index];
+    size_t end = index + 1 < gameOffsets.size() ? gameOffsets[index + 1] : file.size();
+
+    bool ok = ParsePgnGame(file.data() + begin, file.data() + end, game, mode);
+
+    game.index = index;
+    game.offset = begin;
+    game.line = gameLines[index];
+
+    return ok;
+}
+
+void PgnReader::locate(size_t index, size_t offset, int& line, int& column) const
+{
+    line = gameLines[index];
+    column = 1;
+
+    for(size_t i = gameOffsets[index]; i < offset && i < file.size(); i++)
+    {
+        if(file.data()[i] == '\n')
+        {
+            line++;
+            column = 1;
+        }
+        else column++;
+    }
+}
+
+PgnStats PgnReader::replay(const PgnReplayOptions& options, const PgnPositionVisitor& visitor,
+                           std::vector<PgnError> *errors, std::ostream *progress) const
+{
+    const int threads = options.threads < 1 ? 1 : options.threads;
+
+    std::atomic<size_t> nextGame(0), gamesDone(0), failedGames(0), plies(0);
+    std::mutex errorMutex;
+
+    // The progress loop waits on this, so it wakes as soon as the last worker is done
+    int running = threads;
+    std::mutex runningMutex;
+    std::condition_variable finished;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    auto worker = [&](int id)
+    {
+        PgnGame game;
+        size_t localPlies = 0;
+
+        for(;;)
+        {
+            size_t first = nextGame.fetch_add(PGN_BATCH_SIZE);
+            if(first >= gameOffsets.size()) break;
+
+            size_t last = std::min(first + PGN_BATCH_SIZE, gameOffsets.size());
+
+            for(size_t index = first; index < last; index++)
+            {
+                PgnError error;
+
+                if(!parseGame(index, game, options.annotations)) continue;
+
+                if(ReplayPgnGame(game, visitor, id, &error, options.validateSuffixes))
+                {
+                    localPlies += game.moves.size();
+                }
+                else
+                {
+                    failedGames++;
+                    localPlies += error.ply > 0 ? error.ply - 1 : 0;
+
+                    if(errors)
+                    {
+                        if(error.ply > 0)
+                            locate(index, game.offset + game.moves[error.ply - 1].offset, error.line, error.column);
+
+                        std::lock_guard<std::mutex> lock(errorMutex);
+                        errors->push_back(error);
+                    }
+                }
+            }
+
+            gamesDone += last - first;
+        }
+
+        plies += localPlies;
+
+        std::lock_guard<std::mutex> lock(runningMutex);
+        if(--running == 0) finished.notify_all();
+    };
+
+    std::vector<std::thread> workers;
+    for(int i = 0; i < threads; i++) workers.emplace_back(worker, i);
+
+    for(std::unique_lock<std::mutex> lock(runningMutex); progress; )
+    {
+        if(finished.wait_for(lock, std::chrono::seconds(1), [&]() { return running == 0; })) break;
+
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        size_t done = gamesDone;
+        *progress << done << "/" << gameOffsets.size() << " games, "
+                  << static_cast<size_t>(done / elapsed) << " games/s\n";
+    }
+
+    for(std::thread& t : workers) t.join();
+
+    PgnStats stats;
+    stats.games = gamesDone;
+    stats.failedGames = failedGames;
+    stats.plies = plies;
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    return stats;
+}
@@ -0,0 +1,120 @@
+#ifndef CHEESENG_PGN_H
+#define CHEESENG_PGN_H
+
+#include <cstddef>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "mappedfile.hpp"
+#include "position.hpp"
+
+#define PGN_STARTING_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+
+enum PgnAnnotationMode{PGN_SKIP_ANNOTATIONS, PGN_KEEP_ANNOTATIONS};
+
+struct PgnTag
+{
+    std::string name;
+    std::string value;
+};
+
+struct PgnMove
+{
+    std::string san;
+    size_t offset;  // byte offset of the SAN token in the input
+
+    // Only filled with PGN_KEEP_ANNOTATIONS
+    std::vector<int> nags;
+    std::string comment;
+    std::vector<std::string> variations;
+};
+
+struct PgnGame
+{
+    size_t index;   // game number in the input, starting from 0
+    size_t offset;  // byte offset of the first character of the game
+    int line;       // line of the first character of the game, starting from 1
+
+    std::vector<PgnTag> tags;
+    std::vector<PgnMove> moves;
+    std::string comment;  // comment before the first move (PGN_KEEP_ANNOTATIONS only)
+    std::string result;
+
+    void clear();
+    const std::string *getTag(const std::string& name) const;
+    std::string startingFEN() const;
+};
+
+struct PgnError
+{
+    size_t game;
+    int ply;         // ply of the offending move, starting from 1
+    int line, column;
+    std::string san;
+    std::string message;
+};
+
+struct PgnReplayOptions
+{
+    int threads;
+    PgnAnnotationMode annotations;
+    bool validateSuffixes;  // reject moves with a wrong or missing +/# suffix
+};
+
+struct PgnStats
+{
+    size_t games;
+    size_t failedGames;
+    size_t plies;
+    double seconds;
+
+    double gamesPerSecond() const { return seconds > 0 ? games / seconds : 0; }
+};
+
+// Called for every position of a game, starting with the initial position (ply 0).
+// Runs on the worker threads, worker is in [0, threads).
+typedef std::function<void(int worker, const PgnGame& game, const Position& pos, int ply)> PgnPositionVisitor;
+
+// Sanity check for FEN from untrusted input before Position(fen): eight ranks of eight squares with valid
+// piece letters (the constructor writes the board unchecked), a side to move (it aborts without one),
+// castling and en passant fields, and optional numeric clocks (missing ones read as 0 and 1)
+bool PlausibleFEN(const std::string& fen);
+
+// Parse the game text in [begin, end). Returns false if no movetext or tags were found.
+bool ParsePgnGame(const char *begin, const char *end, PgnGame& game, PgnAnnotationMode mode);
+
+// Replay the main line of a parsed game. Stops at the first illegal move and fills error (if given).
+// The positions passed to the visitor do not have their metadata computed.
+bool ReplayPgnGame(const PgnGame& game, const PgnPositionVisitor& visitor, int worker, PgnError *error,
+                   bool validateSuffixes=false);
+
+class PgnReader
+{
+public:
+    PgnReader();
+
+    // Map the file and locate the game boundaries
+    bool open(const std::string& path);
+
+    size_t gameCount() const { return gameOffsets.size(); }
+    bool parseGame(size_t index, PgnGame& game, PgnAnnotationMode mode) const;
+
+    // Replay every game on options.threads workers. Errors are appended to errors (if given),
+    // progress is printed to progress (if given) about once per second.
+    PgnStats replay(const PgnReplayOptions& options, const PgnPositionVisitor& visitor,
+                    std::vector<PgnError> *errors=nullptr, std::ostream *progress=nullptr) const;
+
+    // Line and column (starting from 1) of a byte offset inside game index
+    void locate(size_t index, size_t offset, int& line, int& column) const;
+
+private:
+    MappedFile file;
+    std::vector<size_t> gameOffsets;
+    std::vector<int> gameLines;
+
+    void splitGames();
+};
+
+#endif //CHEESENG_PGN_H
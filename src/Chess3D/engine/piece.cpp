@@ -3,6 +3,7 @@
 #include "coord.hpp"
 #include "position.hpp"
 #include "lookups.hpp"
+#include "bitboard.hpp"
 
 #include <cctype>
 
@@ -81,17 +82,14 @@ std::vector<Move> CrossMove(const Position& pos, Coord from, PieceColor color)
 }
 
 
-std::vector<Move> KnightMove(const Position& pos, Coord from, PieceColor color)
+// Knight and king targets come from the precomputed attack tables
+static std::vector<Move> LeaperMove(const Position& pos, Coord from, PieceColor color, Bitboard targets)
 {
     std::vector<Move> moves;
 
-    for(int move=0; move < 8; move++)
+    while(targets)
     {
-        Coord current = from;
-
-        COORD_ADD_DIRECTION(current, KNIGHT_MOVES[move]);
-
-        if(!validCoord(current)) continue;
+        Coord current = CoordFromIndex(PopLowestSquare(targets));
 
         Piece pieceAtCurrent = pos.getPieceAtCoord(current);
 
@@ -107,6 +105,11 @@ std::vector<Move> KnightMove(const Position& pos, Coord from, PieceColor color)
     return moves;
 }
 
+std::vector<Move> KnightMove(const Position& pos, Coord from, PieceColor color)
+{
+    return LeaperMove(pos, from, color, KnightAttacks(SquareIndex(from)));
+}
+
 std::vector<Move> PawnMove(const Position& pos, Coord from, PieceColor color)
 {
     std::vector<Move> moves;
@@ -186,30 +189,5 @@ std::vector<Move> PawnMove(const Position& pos, Coord from, PieceColor color)
 
 std::vector<Move> KingMove(const Position& pos, Coord from, PieceColor color)
 {
-    std::vector<Move> moves;
-    
-    for(int file=-1; file <= 1; file++)
-        for(int rank=-1; rank <= 1; rank++)
-        {
-            if(file == 0 && rank == 0) continue;
-
-            Coord current(from.file + file, from.rank + rank);
-
-            if(!validCoord(current)) continue;
-
-            Piece pieceAtCurrent = pos.getPieceAtCoord(current);
-
-            if(pieceAtCurrent.type == NO_PIECE || pieceAtCurrent.color != color)
-            {
-                Move newMove(from, current);
-
-                if(pieceAtCurrent.type != NO_PIECE) newMove.catpureTarget = current;
-
-                moves.push_back(newMove);
-            }
-
-        }
-
-    return moves;
+    return LeaperMove(pos, from, color, KingAttacks(SquareIndex(from)));
 }
-
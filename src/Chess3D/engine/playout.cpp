@@ -0,0 +1,143 @@
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "playout.hpp"
+#include "bitboard.hpp"
+#include "movegen.hpp"
+
+// Games handed to a worker at a time
+#define PLAYOUT_CHUNK 64
+
+static const char *PLAYOUT_RESULT_NAMES[PLAYOUT_RESULT_COUNT] =
+{
+    "white mates",
+    "black mates",
+    "stalemate",
+    "fifty moves",
+    "repetition",
+    "insufficient material",
+    "ply limit",
+};
+
+const char *PlayoutResultName(PlayoutResult result)
+{
+    return PLAYOUT_RESULT_NAMES[result];
+}
+
+bool InsufficientMaterial(const Position& pos)
+{
+    const Bitboard *white = pos.pieces[WHITE], *black = pos.pieces[BLACK];
+
+    if(white[PAWN] | black[PAWN] | white[ROOK] | black[ROOK] | white[QUEEN] | black[QUEEN]) return false;
+
+    const Bitboard knights = white[KNIGHT] | black[KNIGHT];
+    const Bitboard bishops = white[BISHOP] | black[BISHOP];
+
+    if(PopCount(knights | bishops) <= 1) return true;
+    if(knights) return false;
+
+    return !(bishops & DARK_SQUARES_BB) || !(bishops & ~DARK_SQUARES_BB);
+}
+
+PlayoutResult RandomPlayout(Position& pos, Xorshift& rng, MoveUndo *undos, int& plies)
+{
+    PlayoutResult result;
+    plies = 0;
+
+    while(true)
+    {
+        MoveList moves;
+        GenerateLegalMoves(pos, moves);
+
+        // A mate on the hundredth half move still counts, so it is looked for first
+        if(moves.size() == 0)
+        {
+            result = !pos.checkers() ? PLAYOUT_STALEMATE : pos.color_playing == WHITE ? PLAYOUT_BLACK_MATES : PLAYOUT_WHITE_MATES;
+            break;
+        }
+
+        if(pos.halfmoveClock >= 100) { result = PLAYOUT_FIFTY_MOVES; break; }
+        if(pos.isRepetition(3)) { result = PLAYOUT_REPETITION; break; }
+        if(InsufficientMaterial(pos)) { result = PLAYOUT_INSUFFICIENT_MATERIAL; break; }
+        if(plies == PLAYOUT_MAX_PLIES) { result = PLAYOUT_PLY_LIMIT; break; }
+
+        pos.makeMove(moves[rng.below(moves.size())], undos[plies++]);
+    }
+
+    for(int i = plies - 1; i >= 0; i--) pos.unmakeMove(undos[i]);
+
+    return result;
+}
+
+void PlayoutStats::add(PlayoutResult result, int gamePlies)
+{
+    games++;
+    plies += gamePlies;
+    minPlies = std::min(minPlies, gamePlies);
+    maxPlies = std::max(maxPlies, gamePlies);
+    results[result]++;
+    lengths[gamePlies / PLAYOUT_BUCKET_PLIES]++;
+}
+
+void PlayoutStats::merge(const PlayoutStats& other)
+{
+    games += other.games;
+    plies += other.plies;
+    minPlies = std::min(minPlies, other.minPlies);
+    maxPlies = std::max(maxPlies, other.maxPlies);
+
+    for(int i = 0; i < PLAYOUT_RESULT_COUNT; i++) results[i] += other.results[i];
+    for(int i = 0; i < PLAYOUT_BUCKETS; i++) lengths[i] += other.lengths[i];
+}
+
+uint64_t GameSeed(uint64_t seed, uint64_t game)
+{
+    uint64_t z = seed + (game + 1) * 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+
+    return z ^ (z >> 31);
+}
+
+PlayoutStats RunPlayouts(const Position& start, uint64_t games, int threads, uint64_t seed)
+{
+    std::atomic<uint64_t> next(0);
+    std::mutex mutex;
+    PlayoutStats total;
+
+    auto worker = [&]()
+    {
+        Position pos = start;
+        pos.keyHistory.reserve(pos.keyHistory.size() + PLAYOUT_MAX_PLIES);
+
+        std::vector<MoveUndo> undos(PLAYOUT_MAX_PLIES);
+        PlayoutStats stats;
+
+        for(uint64_t first; (first = next.fetch_add(PLAYOUT_CHUNK)) < games; )
+        {
+            const uint64_t last = std::min(games, first + PLAYOUT_CHUNK);
+
+            for(uint64_t game = first; game < last; game++)
+            {
+                Xorshift rng(GameSeed(seed, game));
+                int plies;
+
+                PlayoutResult result = RandomPlayout(pos, rng, undos.data(), plies);
+                stats.add(result, plies);
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        total.merge(stats);
+    };
+
+    std::vector<std::thread> pool;
+    for(int t = 1; t < threads; t++) pool.emplace_back(worker);
+    worker();
+    for(std::thread& thread : pool) thread.join();
+
+    return total;
+}
@@ -0,0 +1,76 @@
+#ifndef CHEESENG_PLAYOUT_H
+#define CHEESENG_PLAYOUT_H
+
+#include <cstdint>
+
+#include "position.hpp"
+
+// Longest random game played out, the undo stack of RandomPlayout needs this many entries
+#define PLAYOUT_MAX_PLIES 1024
+
+// Game lengths are counted in buckets of this many plies
+#define PLAYOUT_BUCKET_PLIES 50
+#define PLAYOUT_BUCKETS (PLAYOUT_MAX_PLIES / PLAYOUT_BUCKET_PLIES + 1)
+
+// xorshift64*: a few instructions per number, plenty for picking moves
+struct Xorshift
+{
+    uint64_t state;
+
+    explicit Xorshift(uint64_t seed) : state(seed ? seed : 0x9E3779B97F4A7C15ULL) {}
+
+    uint64_t next()
+    {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+
+        return state * 0x2545F4914F6CDD1DULL;
+    }
+
+    // Uniform in [0, bound) without a division
+    uint32_t below(uint32_t bound) { return static_cast<uint32_t>(((next() >> 32) * bound) >> 32); }
+};
+
+// splitmix64 of the game number, so neighbouring games get unrelated seeds
+uint64_t GameSeed(uint64_t seed, uint64_t game);
+
+enum PlayoutResult
+{
+    PLAYOUT_WHITE_MATES,
+    PLAYOUT_BLACK_MATES,
+    PLAYOUT_STALEMATE,
+    PLAYOUT_FIFTY_MOVES,
+    PLAYOUT_REPETITION,
+    PLAYOUT_INSUFFICIENT_MATERIAL,
+    PLAYOUT_PLY_LIMIT,
+    PLAYOUT_RESULT_COUNT
+};
+
+const char *PlayoutResultName(PlayoutResult result);
+
+// Neither side can mate: kings with at most one minor piece, or bishops all on one square color
+bool InsufficientMaterial(const Position& pos);
+
+// Random legal moves from pos until the game ends by rule or reaches PLAYOUT_MAX_PLIES, then every move is
+// taken back. Needs no allocation once pos.keyHistory has room for the plies.
+PlayoutResult RandomPlayout(Position& pos, Xorshift& rng, MoveUndo *undos, int& plies);
+
+struct PlayoutStats
+{
+    uint64_t games = 0;
+    uint64_t plies = 0;
+    int minPlies = PLAYOUT_MAX_PLIES;
+    int maxPlies = 0;
+    uint64_t results[PLAYOUT_RESULT_COUNT] = {};
+    uint64_t lengths[PLAYOUT_BUCKETS] = {};
+
+    void add(PlayoutResult result, int gamePlies);
+    void merge(const PlayoutStats& other);
+};
+
+// games random games from start on threads threads. Game i is seeded from seed and i alone, so the
+// totals are the same for any thread count.
+PlayoutStats RunPlayouts(const Position& start, uint64_t games, int threads, uint64_t seed);
+
+#endif //CHEESENG_PLAYOUT_H
@@ -1,10 +1,17 @@
+#include <algorithm>
 #include <iostream>
 #include <cstdio>
+#include <cstring>
 #include <vector>
 
 #include "position.hpp"
 #include "move.hpp"
 #include "lookups.hpp"
+#include "zobrist.hpp"
+#include "bitboard.hpp"
+#include "movegen.hpp"
+#include "boardstate.hpp"
+#include "alloctrack.hpp"
 
 
 const char castleTypes[] = {'K', 'Q', 'k', 'q'};
@@ -41,13 +48,20 @@ void Position::DebugPrint() const
 
 Position::Position(const std::string& fen) : FEN(fen)
 {
+    ALLOC_SCOPE(ALLOC_POSITION_SETUP);
+
     int file = 0, rank = BOARD_SIZE -1;
     int fi;
     char FEN_CHAR;
 
     valid_metadata = false;
+    valid_moves = false;
     kingPositions[0] = DEFAULT_INVALID_COORD; kingPositions[1] = DEFAULT_INVALID_COORD;
     en_passant = DEFAULT_INVALID_COORD;
+    halfmoveClock = 0;
+    fullmoveNumber = 1;
+    castling_rights[WHITE][SHORT_CASTLE] = castling_rights[WHITE][LONG_CASTLE] = false;
+    castling_rights[BLACK][SHORT_CASTLE] = castling_rights[BLACK][LONG_CASTLE] = false;
 
     // Position data
     for(fi=0; fi < FEN.length() && !(rank == 0 && file == BOARD_SIZE); ++fi)
@@ -80,11 +94,14 @@ Position::Position(const std::string& fen) : FEN(fen)
 
     // skip space
     /* assert(row == 0 && file == BOARD_SIZE); */
+    // Fields past the end of a short FEN read as '\0': no castling, no en passant, default clocks
+    auto fenChar = [&](int i) { return i < static_cast<int>(FEN.length()) ? FEN[i] : '\0'; };
+
     /* assert(*FEN == ' '); */
     fi++;
     // turn
 
-    switch(FEN[fi++])
+    switch(fenChar(fi++))
     {
         case 'w': color_playing = WHITE; break;
         case 'b': color_playing = BLACK; break;
@@ -109,7 +126,7 @@ Position::Position(const std::string& fen) : FEN(fen)
     /* assert(*FEN == ' '); */
     fi++;
 
-    if(FEN[fi] == '-')
+    if(fenChar(fi) == '-' || !fenChar(fi) || !fenChar(fi + 1))
     {
         en_passant = DEFAULT_INVALID_COORD;
         fi++;
@@ -123,29 +140,87 @@ Position::Position(const std::string& fen) : FEN(fen)
 
     /* assert(*FEN == ' '); */
     fi++;
-    std::sscanf(&FEN[fi], "%d %d", &halfmoveClock, &fullmoveNumber);
+    if(fi < static_cast<int>(FEN.length())) std::sscanf(&FEN[fi], "%d %d", &halfmoveClock, &fullmoveNumber);
+
+    computeBitboards();
+
+    // Like makeMove, keep the en passant square only when a pawn can take there, or the same position
+    // reached by moves and read from a FEN would hash differently
+    if(validCoord(en_passant) &&
+       !(PawnAttacks(OTHER_COLOR(color_playing), SquareIndex(en_passant)) & pieces[color_playing][PAWN]))
+        en_passant = DEFAULT_INVALID_COORD;
+
+    zobristKey = computeZobristKey();
+    pawnKey = computePawnKey();
 
-    CreateMetadata();
     findKings();
-    createMoveStrings();
+    CreateMetadata();
+}
+
+Position::Position(const BoardState& state)
+{
+    ALLOC_SCOPE(ALLOC_POSITION_SETUP);
+
+    valid_metadata = false;
+    valid_moves = false;
+
+    for(int square = 0; square < BOARD_SIZE * BOARD_SIZE; square++)
+        position_grid[square % BOARD_SIZE][square / BOARD_SIZE] = PieceFromCode(state.board[square]);
+
+    color_playing = static_cast<PieceColor>(state.colorPlaying);
+
+    for(int i = 0; i < 4; i++) castling_rights[i/2][i%2] = (state.castling >> i) & 1;
+
+    en_passant = state.enPassant == NO_SQUARE ? DEFAULT_INVALID_COORD : CoordFromIndex(state.enPassant);
+    halfmoveClock = state.halfmoveClock;
+    fullmoveNumber = state.fullmoveNumber;
+
+    for(int color = WHITE; color <= BLACK; color++)
+    {
+        kingPositions[color] = state.kingSquares[color] == NO_SQUARE ? DEFAULT_INVALID_COORD
+                                                                      : CoordFromIndex(state.kingSquares[color]);
+    }
+
+    computeBitboards();
+    zobristKey = state.zobristKey;
+    pawnKey = computePawnKey();
+    FEN = CreateFENString();
+
+    CreateMetadata();
+}
+
+void Position::computeBitboards()
+{
+    std::memset(pieces, 0, sizeof pieces);
+    std::memset(occupancy, 0, sizeof occupancy);
+
+    for(int square = 0; square < BOARD_SIZE * BOARD_SIZE; square++)
+    {
+        Piece piece = position_grid[square % BOARD_SIZE][square / BOARD_SIZE];
+        if(piece.type == NO_PIECE) continue;
+
+        pieces[piece.color][piece.type] |= SQUARE_BB(square);
+        occupancy[piece.color] |= SQUARE_BB(square);
+    }
 }
-/*
-void Position::CreateFENString()
+std::string Position::CreateFENString() const
 {
-    FEN = ""; 
+    ALLOC_SCOPE(ALLOC_FEN);
 
-    for(int row = BOARD_SIZE-1; row >= 0; row--)
+    std::string fen;
+
+    for(int rank = BOARD_SIZE-1; rank >= 0; rank--)
     {
         int noPieceRunning = 0;
         for(int file = 0; file < BOARD_SIZE; file++)
         {
-            Piece currentPiece = getPieceAtCoord((Coord){file, row});
+            Piece currentPiece = position_grid[file][rank];
 
             if(currentPiece.type != NO_PIECE)
             {
-                if(noPieceRunning) printf("%d", noPieceRunning);
+                if(noPieceRunning) fen += static_cast<char>('0' + noPieceRunning);
 
-                putchar(currentPiece.GetFENChar());
+                fen += currentPiece.GetFENChar();
                 noPieceRunning = 0;
             }
             else
@@ -155,37 +230,43 @@ void Position::CreateFENString()
 
         }
 
-        if(noPieceRunning) printf("%d", noPieceRunning);
+        if(noPieceRunning) fen += static_cast<char>('0' + noPieceRunning);
 
-        if(row != 0) putchar('/');
+        if(rank != 0) fen += '/';
 
     }
 
-    printf(" %c ", color_playing == WHITE ? 'w' : 'b');
+    fen += color_playing == WHITE ? " w " : " b ";
 
     bool anyCastlingRights = false;
     for(int i=0; i < 4; i++)
     {
         if(castling_rights[i/2][i%2])
         {
-            putchar(castleTypes[i]);
+            fen += castleTypes[i];
             anyCastlingRights = true;
         }
     }
 
-    if(!anyCastlingRights) putchar('-');
+    if(!anyCastlingRights) fen += '-';
 
-    putchar(' ');
+    fen += ' ';
 
-    if(validCoord(pos->en_passant))
-        PrintCoordAlgebraic(pos->en_passant);
+    if(validCoord(en_passant))
+    {
+        fen += en_passant.FileChar();
+        fen += en_passant.RankChar();
+    }
     else
-        putchar('-');
+    {
+        fen += '-';
+    }
 
-    printf(" %d %d", pos->halfmoveClock, pos->fullmoveNumber);
+    fen += " " + std::to_string(halfmoveClock) + " " + std::to_string(fullmoveNumber);
 
+    return fen;
 }
-*/
+
 Piece Position::getPieceAtCoord(Coord coord) const
 {
     return validCoord(coord) ? position_grid[coord.file][coord.rank] : NO_PIECE_LITERAL;
@@ -193,7 +274,66 @@ Piece Position::getPieceAtCoord(Coord coord) const
 
 void Position::setPieceAtCoord(Coord coord, Piece piece)
 {
-    if(validCoord(coord)) position_grid[coord.file][coord.rank] = piece;
+    if(!validCoord(coord)) return;
+
+    setPieceAtSquare(SquareIndex(coord), piece);
+}
+
+// The only place the placement changes after construction: grid, bitboards and hash are updated together
+void Position::setPieceAtSquare(int square, Piece piece)
+{
+    const ZobristKeys& keys = Zobrist();
+    Piece& current = position_grid[square % BOARD_SIZE][square / BOARD_SIZE];
+
+    if(current.type != NO_PIECE)
+    {
+        pieces[current.color][current.type] ^= SQUARE_BB(square);
+        occupancy[current.color] ^= SQUARE_BB(square);
+        zobristKey ^= keys.pieces[current.color][current.type][square];
+        if(current.type == PAWN) pawnKey ^= keys.pieces[current.color][PAWN][square];
+    }
+
+    if(piece.type != NO_PIECE)
+    {
+        pieces[piece.color][piece.type] ^= SQUARE_BB(square);
+        occupancy[piece.color] ^= SQUARE_BB(square);
+        zobristKey ^= keys.pieces[piece.color][piece.type][square];
+        if(piece.type == PAWN) pawnKey ^= keys.pieces[piece.color][PAWN][square];
+    }
+
+    current = piece;
+}
+
+uint64_t Position::computeZobristKey() const
+{
+    const ZobristKeys& keys = Zobrist();
+    uint64_t key = 0;
+    Coord current;
+
+    for(current.file = FILE_A; current.file <= FILE_H; current.file++)
+        for(current.rank = RANK_1; current.rank <= RANK_8; current.rank++)
+            key ^= ZobristPiece(getPieceAtCoord(current), current);
+
+    for(int color = WHITE; color <= BLACK; color++)
+        for(int type = SHORT_CASTLE; type <= LONG_CASTLE; type++)
+            if(castling_rights[color][type]) key ^= keys.castling[color][type];
+
+    if(validCoord(en_passant)) key ^= keys.enPassantFile[en_passant.file];
+    if(color_playing == BLACK) key ^= keys.blackToMove;
+
+    return key;
+}
+
+uint64_t Position::computePawnKey() const
+{
+    const ZobristKeys& keys = Zobrist();
+    uint64_t key = 0;
+
+    for(int color = WHITE; color <= BLACK; color++)
+        for(Bitboard b = pieces[color][PAWN]; b; )
+            key ^= keys.pieces[color][PAWN][PopLowestSquare(b)];
+
+    return key;
 }
 
 
@@ -231,6 +371,161 @@ int Position::AttackersTargetingCoord(Coord target, PieceColor color, MoveTypes
     return numberOfAttacks;
 }
 
+// Is target attacked by any piece of color attacker (bitboard lookups, no move generation)
+bool Position::isSquareAttacked(Coord target, PieceColor attacker) const
+{
+    if(!validCoord(target)) return false;
+
+    const int square = SquareIndex(target);
+
+    return (attacker == WHITE ? attackersTo<WHITE>(square, occupied()) : attackersTo<BLACK>(square, occupied())) != 0;
+}
+
+// Squares holding piece (knight, bishop, rook, queen or king) that reach target, ignoring pins.
+// Writes at most maxOut coords and returns how many were found.
+int Position::PiecesAttackingCoord(Coord target, Piece piece, Coord *out, int maxOut) const
+{
+    int found = 0;
+
+    auto add = [&](Coord c)
+    {
+        if(found < maxOut) out[found] = c;
+        found++;
+    };
+
+    if(piece.type == KNIGHT || piece.type == KING)
+    {
+        Bitboard squares = piece.type == KNIGHT ? KnightAttacks(SquareIndex(target)) : KingAttacks(SquareIndex(target));
+
+        while(squares)
+        {
+            Coord c = CoordFromIndex(PopLowestSquare(squares));
+            if(PieceEquals(getPieceAtCoord(c), piece)) add(c);
+        }
+
+        return found;
+    }
+
+    const bool diagonal = piece.type == BISHOP || piece.type == QUEEN;
+    const bool cross    = piece.type == ROOK   || piece.type == QUEEN;
+
+    for(int set = 0; set < 2; set++)
+    {
+        if(!(set == 0 ? diagonal : cross)) continue;
+
+        const int (*dirs)[2] = set == 0 ? DIAGONAL_DIRECTIONS : CROSS_DIRECTIONS;
+
+        for(int dir = 0; dir < 4; dir++)
+        {
+            Coord c(target.file + dirs[dir][0], target.rank + dirs[dir][1]);
+
+            for(; validCoord(c); c.file += dirs[dir][0], c.rank += dirs[dir][1])
+            {
+                Piece atC = getPieceAtCoord(c);
+                if(atC.type == NO_PIECE) continue;
+
+                if(PieceEquals(atC, piece)) add(c);
+                break;
+            }
+        }
+    }
+
+    return found;
+}
+
+bool Position::canCastle(CastlingMove type) const
+{
+    const PieceColor us = color_playing, them = OTHER_COLOR(color_playing);
+    const Coord kingStart = CASTLING_KING_START_COORD[us];
+    const Coord rookStart = CASTLING_ROOK_START_COORD[us][type];
+    const Coord kingTarget = CASTLING_KING_TARGET_COORD[us][type];
+
+    if(!castling_rights[us][type] ||
+       !PieceEquals(getPieceAtCoord(kingStart), Piece{KING, us}) ||
+       !PieceEquals(getPieceAtCoord(rookStart), Piece{ROOK, us}))
+        return false;
+
+    const int step = rookStart.file > kingStart.file ? 1 : -1;
+
+    for(Coord c(kingStart.file + step, kingStart.rank); c.file != rookStart.file; c.file += step)
+        if(getPieceAtCoord(c).type != NO_PIECE) return false;
+
+    // The king may not castle out of, through or into check
+    for(Coord c = kingStart; ; c.file += step)
+    {
+        if(isSquareAttacked(c, them)) return false;
+        if(c.file == kingTarget.file) break;
+    }
+
+    return true;
+}
+
+// Does a pseudo legal (non castling) move of the side to move keep its king safe.
+// The move is made on the board and taken back, nothing is allocated.
+bool Position::isMoveLegal(const Move& move)
+{
+    const PieceColor us = color_playing;
+
+    Piece moving = getPieceAtCoord(move.from);
+    Piece onTarget = getPieceAtCoord(move.to);
+
+    const bool enPassant = validCoord(move.catpureTarget) && !CoordEquals(move.catpureTarget, move.to);
+    Piece captured = enPassant ? getPieceAtCoord(move.catpureTarget) : NO_PIECE_LITERAL;
+
+    if(enPassant) setPieceAtCoord(move.catpureTarget, NO_PIECE_LITERAL);
+    setPieceAtCoord(move.to, moving);
+    setPieceAtCoord(move.from, NO_PIECE_LITERAL);
+
+    Coord king = moving.type == KING ? move.to : kingPositions[us];
+    bool legal = !isSquareAttacked(king, OTHER_COLOR(us));
+
+    setPieceAtCoord(move.from, moving);
+    setPieceAtCoord(move.to, onTarget);
+    if(enPassant) setPieceAtCoord(move.catpureTarget, captured);
+
+    return legal;
+}
+
+// Does a legal move of the side to move attack the enemy king. Made and taken back in place.
+bool Position::givesCheck(const Move& move)
+{
+    const PieceColor us = color_playing, them = OTHER_COLOR(color_playing);
+    Piece saved[4];
+    Coord squares[4];
+    int n = 0;
+
+    auto put = [&](Coord c, Piece p)
+    {
+        squares[n] = c;
+        saved[n++] = getPieceAtCoord(c);
+        setPieceAtCoord(c, p);
+    };
+
+    if(move.castlingType != NO_CASTLE)
+    {
+        put(CASTLING_KING_START_COORD[us], NO_PIECE_LITERAL);
+        put(CASTLING_ROOK_START_COORD[us][move.castlingType], NO_PIECE_LITERAL);
+        put(CASTLING_KING_TARGET_COORD[us][move.castlingType], Piece{KING, us});
+        put(CASTLING_ROOK_TARGET_COORD[us][move.castlingType], Piece{ROOK, us});
+    }
+    else
+    {
+        Piece moving = getPieceAtCoord(move.from);
+        if(move.promotionType != NO_PIECE) moving.type = move.promotionType;
+
+        if(validCoord(move.catpureTarget) && !CoordEquals(move.catpureTarget, move.to))
+            put(move.catpureTarget, NO_PIECE_LITERAL);
+        put(move.from, NO_PIECE_LITERAL);
+        put(move.to, moving);
+    }
+
+    bool check = isSquareAttacked(kingPositions[them], us);
+
+    while(n--) setPieceAtCoord(squares[n], saved[n]);
+
+    return check;
+}
+
 PositionState Position::getPositionState()
 {
     PieceColor colorNotPlaying = OTHER_COLOR(color_playing);
@@ -245,10 +540,27 @@ bool Position::isInCheck(PieceColor color)
     if(CoordEquals(kingPositions[color], DEFAULT_INVALID_COORD))
             findKings();
     
-    return AttackersTargetingCoord(kingPositions[color], OTHER_COLOR(color), ALL_TYPES) != 0;
+    return isSquareAttacked(kingPositions[color], OTHER_COLOR(color));
 }
 
 
+// Has the current position occurred count times (including now).
+// Only positions since the last irreversible move (pawn move or capture) can repeat, and only
+// every second ply with the same side to move, so the scan is short.
+bool Position::isRepetition(int count) const
+{
+    const int history = static_cast<int>(keyHistory.size());
+    const int reach = halfmoveClock < history ? halfmoveClock : history;
+    int found = 1;
+
+    for(int back = 4; back <= reach && found < count; back += 2)
+    {
+        if(keyHistory[history - back] == zobristKey) found++;
+    }
+
+    return found >= count;
+}
+
 bool Position::isLegal()
 {
 
@@ -282,256 +594,365 @@ void Position::findKings()
 }
 
 
+// Compute the position state. Only looks for a single legal move, the move list is built by CreateMoveList.
 void Position::CreateMetadata()
 {
     if(valid_metadata) return;
 
     valid_metadata = true;
 
-    metadata.legalMoves = createLegalMoves();
+    metadata.inCheck = isInCheck(color_playing);
+
+    // A draw by rule does not hide a check, and a mate on the move that reaches one still counts
+    const bool fiftyMoves = halfmoveClock >= DRAW_HALFMOVES, repetition = isRepetition(3);
+    metadata.drawByRule = fiftyMoves || repetition;
 
     PieceColor colorNotPlaying = OTHER_COLOR(color_playing);
 
-    //printf("meta-check\n");
     // If the color not playing is in check, the position is invalid
     if(isInCheck(colorNotPlaying))
+    {
         metadata.state =  INVALID;
+        return;
+    }
 
-    else if(halfmoveClock >= DRAW_HALFMOVES)
-        metadata.state = DRAW;
-
-    else
-    {
-        /* Check for checks and legal moves.
-     * If in check and no legal moves -> checkmate, if legal moves -> check.
+    /* If in check and no legal moves -> checkmate, if legal moves -> check.
      * If not in check and no legal moves -> draw*/
 
-        bool inCheck = isInCheck(color_playing);
+    bool anyLegalMove = hasAnyLegalMove();
 
-        int legalMoveCount = metadata.legalMoves.size();
+    if(metadata.inCheck)
+        metadata.state = anyLegalMove ? CHECK : CHECKMATE;
+    else if(!anyLegalMove || fiftyMoves)
+        metadata.state = DRAW;
+    else
+        metadata.state = repetition ? REPETITION : NORMAL;
+}
 
+void Position::CreateMoveList()
+{
+    if(valid_moves) return;
 
-        if(inCheck)
-            metadata.state = legalMoveCount > 0 ? CHECK : CHECKMATE;
-        else
-            metadata.state = legalMoveCount > 0 ? NORMAL : DRAW;
-    }
+    valid_moves = true;
+
+    metadata.legalMoves = createLegalMoves();
+    IndexLegalMoves();
+}
 
+bool Position::hasAnyLegalMove()
+{
+    return HasLegalMove(*this);
 }
 
 std::vector<Move> Position::MovesFromSquare(Coord square)
 {
-    std::vector<Move> moves;
+    ALLOC_SCOPE(ALLOC_LEGACY_MOVES);
 
-    Piece pieceAtCurrent = getPieceAtCoord(square);
+    std::vector<Move> moves;
 
-    if (pieceAtCurrent.color != color_playing) return moves;
+    if(getPieceAtCoord(square).color != color_playing) return moves;
 
-    for (int type = 0; type < 5; type++) {
-        if (!PIECE_DATA[pieceAtCurrent.type].move_types.move_types[type]) continue;
+    MoveList legal;
+    GenerateLegalMoves(*this, legal);
 
-        std::vector<Move> extra = MOVE_TYPE_FUNCTION_LOOKUP[type](*this, square, color_playing);
-    
-        for(Move& move : extra)
-        {
-            Position check = *this;
-            playMove(move, check);
-            
-            if(check.isLegal()) moves.push_back(move);
-        }
-    }
+    for(PackedMove move : legal)
+        if(PackedFrom(move) == SquareIndex(square)) moves.push_back(UnpackMove(move, *this));
 
     return moves;
 }
 
 void Position::playMove(const Move& move, Position& newPosition)
 {
-    Coord enPassantCache = en_passant;
     newPosition = *this;
+    newPosition.applyMove(move);
 
+    CreateMetadata();
+    findKings();
+    if(this == &newPosition) createMoveStrings();
+}
 
-    newPosition.en_passant = DEFAULT_INVALID_COORD;
-    newPosition.valid_metadata = false;
+// Play the move in place. Only the board state is updated, the metadata is left invalid.
+void Position::applyMove(const Move& move)
+{
+    MoveUndo undo;
 
-    newPosition.halfmoveClock++;
-    if(color_playing == BLACK) newPosition.fullmoveNumber++;
+    makeMove(PackMove(move), undo);
+}
 
-    if(move.castlingType != NO_CASTLE)
-    {
+void Position::makeMove(PackedMove move, MoveUndo& undo)
+{
+    if(color_playing == WHITE)
+        makeMove<WHITE>(move, undo);
+    else
+        makeMove<BLACK>(move, undo);
+}
 
-        newPosition.setPieceAtCoord(CASTLING_KING_START_COORD[color_playing], NO_PIECE_LITERAL);
-        newPosition.setPieceAtCoord(CASTLING_ROOK_START_COORD[color_playing][move.castlingType], NO_PIECE_LITERAL);
+void Position::unmakeMove(const MoveUndo& undo)
+{
+    // The side that made the move is the one not to move now
+    if(color_playing == WHITE)
+        unmakeMove<BLACK>(undo);
+    else
+        unmakeMove<WHITE>(undo);
+}
 
-        newPosition.setPieceAtCoord(CASTLING_KING_TARGET_COORD[color_playing][move.castlingType], Piece{KING, newPosition.color_playing});
-        newPosition.setPieceAtCoord(CASTLING_ROOK_TARGET_COORD[color_playing][move.castlingType], Piece{ROOK, newPosition.color_playing});
+template<PieceColor Us>
+void Position::makeMove(PackedMove move, MoveUndo& undo)
+{
+    typedef ColorTraits<Us> Traits;
+    typedef ColorTraits<Traits::Them> ThemTraits;
 
-        newPosition.castling_rights[newPosition.color_playing][SHORT_CASTLE] = false;
-        newPosition.castling_rights[newPosition.color_playing][LONG_CASTLE]  = false;
+    const ZobristKeys& keys = Zobrist();
+    const int from = PackedFrom(move), to = PackedTo(move), promotion = PackedPromotion(move);
+    const Piece moving = position_grid[from % BOARD_SIZE][from / BOARD_SIZE];
 
-        newPosition.kingPositions[color_playing] = CASTLING_KING_TARGET_COORD[color_playing][move.castlingType];
-    }
-    else
+    undo.move = move;
+    undo.captured = position_grid[to % BOARD_SIZE][to / BOARD_SIZE];
+    undo.capturedSquare = to;
+    undo.en_passant = en_passant;
+    std::memcpy(undo.castling_rights, castling_rights, sizeof castling_rights);
+    undo.halfmoveClock = halfmoveClock;
+    undo.zobristKey = zobristKey;
+
+    if(keyHistory.size() == keyHistory.capacity()) STAT_INC(STAT_POSITION_ALLOCATIONS);
+    keyHistory.push_back(zobristKey);
+
+    // Pieces are hashed by setPieceAtSquare, the rest is swapped out here and back in at the end
+    for(int color = WHITE; color <= BLACK; color++)
+        for(int type = SHORT_CASTLE; type <= LONG_CASTLE; type++)
+            if(castling_rights[color][type]) zobristKey ^= keys.castling[color][type];
+
+    if(validCoord(en_passant)) zobristKey ^= keys.enPassantFile[en_passant.file];
+
+    en_passant = DEFAULT_INVALID_COORD;
+    valid_metadata = false;
+    valid_moves = false;
+
+    halfmoveClock++;
+    if(Us == BLACK) fullmoveNumber++;
+
+    if(moving.type == KING)
     {
-        Piece pieceMoving = getPieceAtCoord(move.from);
+        castling_rights[Us][SHORT_CASTLE] = false;
+        castling_rights[Us][LONG_CASTLE] = false;
 
-        if(pieceMoving.type == KING)
-        {
-            newPosition.castling_rights[color_playing][SHORT_CASTLE] = false;
-            newPosition.castling_rights[color_playing][LONG_CASTLE] = false;
+        kingPositions[Us] = CoordFromIndex(to);
 
-            newPosition.kingPositions[color_playing] = move.to;
-        }
-        else if(pieceMoving.type == ROOK)
+        // Castling is stored as the king move
+        if(to - from == 2)
         {
-            for(int castleType = SHORT_CASTLE; castleType <= LONG_CASTLE; castleType++)
-            {
-                if(CoordEquals(move.from, CASTLING_ROOK_START_COORD[color_playing][castleType]))
-                {
-                    newPosition.castling_rights[color_playing][castleType] = false;
-                }
-            }
+            setPieceAtSquare(Traits::ShortRookStart, NO_PIECE_LITERAL);
+            setPieceAtSquare(Traits::ShortRookTarget, Piece{ROOK, Us});
         }
-        else if(pieceMoving.type == PAWN)
+        else if(from - to == 2)
         {
-            newPosition.halfmoveClock = 0;
+            setPieceAtSquare(Traits::LongRookStart, NO_PIECE_LITERAL);
+            setPieceAtSquare(Traits::LongRookTarget, Piece{ROOK, Us});
+        }
+    }
+    else if(moving.type == ROOK)
+    {
+        if(from == Traits::ShortRookStart) castling_rights[Us][SHORT_CASTLE] = false;
+        if(from == Traits::LongRookStart)  castling_rights[Us][LONG_CASTLE] = false;
+    }
+    else if(moving.type == PAWN)
+    {
+        halfmoveClock = 0;
 
-            if(move.from.rank == PAWN_STARTING_RANK[color_playing] &&
-                    move.to.rank == (PAWN_STARTING_RANK[color_playing] + 2 * PAWN_MOVING_DIRECTION[color_playing]) &&
-                    (PieceEquals(getPieceAtCoord(Coord(move.to.file-1, move.to.rank)), Piece{PAWN, OTHER_COLOR(color_playing)}) ||
-                     PieceEquals(getPieceAtCoord(Coord(move.to.file+1, move.to.rank)), Piece{PAWN, OTHER_COLOR(color_playing)}) ))
-            {
-                newPosition.en_passant = Coord(move.from.file, move.from.rank + PAWN_MOVING_DIRECTION[color_playing]);
-            }
+        // The en passant square is only set when an enemy pawn could take, like applyMove always did
+        if(to - from == 2 * Traits::Up)
+        {
+            if(PawnAttacks(Us, from + Traits::Up) & pieces[Traits::Them][PAWN])
+                en_passant = CoordFromIndex(from + Traits::Up);
+        }
+        else if(undo.captured.type == NO_PIECE && (from - to) % BOARD_SIZE != 0)
+        {
+            undo.captured = Piece{PAWN, Traits::Them};
+            undo.capturedSquare = to - Traits::Up;
+            setPieceAtSquare(undo.capturedSquare, NO_PIECE_LITERAL);
         }
+    }
 
-        if(getPieceAtCoord(move.to).type != NO_PIECE) newPosition.halfmoveClock = 0;
+    if(undo.captured.type != NO_PIECE)
+    {
+        halfmoveClock = 0;
 
-        // order is important here
-        if(!CoordEquals(move.catpureTarget, DEFAULT_INVALID_COORD))
-                newPosition.setPieceAtCoord(move.catpureTarget, NO_PIECE_LITERAL);
+        // Capturing a rook on its starting square takes the castling right with it
+        if(to == ThemTraits::ShortRookStart) castling_rights[Traits::Them][SHORT_CASTLE] = false;
+        if(to == ThemTraits::LongRookStart)  castling_rights[Traits::Them][LONG_CASTLE] = false;
+    }
 
-        newPosition.setPieceAtCoord(move.to, pieceMoving);
-        newPosition.setPieceAtCoord(move.from, NO_PIECE_LITERAL);
+    setPieceAtSquare(from, NO_PIECE_LITERAL);
+    setPieceAtSquare(to, promotion ? Piece{static_cast<PieceType>(promotion), Us} : moving);
 
+    color_playing = Traits::Them;
 
-        if(move.promotionType != NO_PIECE) newPosition.setPieceAtCoord(move.to, Piece{move.promotionType, color_playing});
-    }
+    for(int color = WHITE; color <= BLACK; color++)
+        for(int type = SHORT_CASTLE; type <= LONG_CASTLE; type++)
+            if(castling_rights[color][type]) zobristKey ^= keys.castling[color][type];
 
-    newPosition.color_playing = OTHER_COLOR(newPosition.color_playing);
-    
-    CreateMetadata();
-    findKings();
-    if(this == &newPosition) createMoveStrings();
+    if(validCoord(en_passant)) zobristKey ^= keys.enPassantFile[en_passant.file];
+    zobristKey ^= keys.blackToMove;
 }
 
-std::vector<Move> Position::createLegalMoves()
+template<PieceColor Us>
+void Position::unmakeMove(const MoveUndo& undo)
 {
-    std::vector<Move> allMoves;
-    Coord current;
+    typedef ColorTraits<Us> Traits;
 
-    for(current.file = FILE_A; current.file <= FILE_H; current.file++) {
-        for (current.rank = RANK_1; current.rank <= RANK_8; current.rank++)
-        {
-            Piece pieceAtCurrent = getPieceAtCoord(current);
+    const int from = PackedFrom(undo.move), to = PackedTo(undo.move);
+    const Piece moved = PackedPromotion(undo.move) ? Piece{PAWN, Us} : position_grid[to % BOARD_SIZE][to / BOARD_SIZE];
 
-            if (pieceAtCurrent.color != color_playing) continue;
+    color_playing = Us;
 
-            std::vector<Move> movesToAdd = MovesFromSquare(current);
+    setPieceAtSquare(to, NO_PIECE_LITERAL);
+    setPieceAtSquare(from, moved);
 
-            allMoves.insert(allMoves.end(), movesToAdd.begin(), movesToAdd.end());
-        }
-    }
+    if(undo.captured.type != NO_PIECE) setPieceAtSquare(undo.capturedSquare, undo.captured);
 
-    // short castle
-    if(castling_rights[color_playing][SHORT_CASTLE] &&
-       PieceEquals(getPieceAtCoord(CASTLING_KING_START_COORD[color_playing]), {KING, color_playing}) &&
-       PieceEquals(getPieceAtCoord(CASTLING_ROOK_START_COORD[color_playing][SHORT_CASTLE]), {ROOK, color_playing}))
+    if(moved.type == KING)
     {
-        Coord current = CASTLING_KING_START_COORD[color_playing];
-        current.file++;
-        bool valid = true;
+        kingPositions[Us] = CoordFromIndex(from);
 
-        for(; current.file < CASTLING_ROOK_START_COORD[color_playing][SHORT_CASTLE].file; current.file++)
+        if(to - from == 2)
         {
-            if(getPieceAtCoord(current).type != NO_PIECE)
-            {
-                valid = false;
-                break;
-            }
-
-            if(current.file <= CASTLING_KING_TARGET_COORD[color_playing][SHORT_CASTLE].file &&
-               AttackersTargetingCoord(current, OTHER_COLOR(color_playing), ALL_TYPES) > 0)
-            {
-                valid = false;
-                break;
-            }
+            setPieceAtSquare(Traits::ShortRookTarget, NO_PIECE_LITERAL);
+            setPieceAtSquare(Traits::ShortRookStart, Piece{ROOK, Us});
         }
-
-        if(valid)
+        else if(from - to == 2)
         {
-            Move castling;
-            castling.from = CASTLING_KING_START_COORD[color_playing];
-            castling.to   = CASTLING_KING_TARGET_COORD[color_playing][SHORT_CASTLE];
-            castling.castlingType = SHORT_CASTLE;
-
-            allMoves.push_back(castling);
+            setPieceAtSquare(Traits::LongRookTarget, NO_PIECE_LITERAL);
+            setPieceAtSquare(Traits::LongRookStart, Piece{ROOK, Us});
         }
     }
-    
 
-    // long castle
-    if(castling_rights[color_playing][LONG_CASTLE] &&
-       PieceEquals(getPieceAtCoord(CASTLING_KING_START_COORD[color_playing]), {KING, color_playing}) &&
-       PieceEquals(getPieceAtCoord(CASTLING_ROOK_START_COORD[color_playing][LONG_CASTLE]), {ROOK, color_playing}))
-    {
-        Coord current = CASTLING_KING_START_COORD[color_playing];
-        current.file--;
-        bool valid = true;
+    en_passant = undo.en_passant;
+    std::memcpy(castling_rights, undo.castling_rights, sizeof castling_rights);
+    halfmoveClock = undo.halfmoveClock;
+    if(Us == BLACK) fullmoveNumber--;
 
-        for(; current.file > CASTLING_ROOK_START_COORD[color_playing][LONG_CASTLE].file; current.file--)
-        {
-            if(getPieceAtCoord(current).type != NO_PIECE)
-            {
-                valid = false;
-                break;
-            }
+    zobristKey = undo.zobristKey;
+    keyHistory.pop_back();
 
-            if(current.file >= CASTLING_KING_TARGET_COORD[color_playing][LONG_CASTLE].file &&
-               AttackersTargetingCoord(current, OTHER_COLOR(color_playing), ALL_TYPES) > 0)
-            {
-                valid = false;
-                break;
-            }
-        }
+    valid_metadata = false;
+    valid_moves = false;
+}
 
-        if(valid)
-        {
-            Move castling;
-            castling.from = CASTLING_KING_START_COORD[color_playing];
-            castling.to   = CASTLING_KING_TARGET_COORD[color_playing][LONG_CASTLE];
-            castling.castlingType = LONG_CASTLE; 
+void Position::makeNullMove(MoveUndo& undo)
+{
+    const ZobristKeys& keys = Zobrist();
 
-            allMoves.push_back(castling);
-        }
-    }
+    undo.move = NULL_PACKED_MOVE;
+    undo.captured = NO_PIECE_LITERAL;
+    undo.en_passant = en_passant;
+    undo.halfmoveClock = halfmoveClock;
+    undo.zobristKey = zobristKey;
+
+    if(keyHistory.size() == keyHistory.capacity()) STAT_INC(STAT_POSITION_ALLOCATIONS);
+    keyHistory.push_back(zobristKey);
+
+    if(validCoord(en_passant)) zobristKey ^= keys.enPassantFile[en_passant.file];
+    zobristKey ^= keys.blackToMove;
+
+    en_passant = DEFAULT_INVALID_COORD;
+    halfmoveClock = 0;
+    color_playing = OTHER_COLOR(color_playing);
+
+    valid_metadata = false;
+    valid_moves = false;
+}
+
+void Position::unmakeNullMove(const MoveUndo& undo)
+{
+    color_playing = OTHER_COLOR(color_playing);
+    en_passant = undo.en_passant;
+    halfmoveClock = undo.halfmoveClock;
+    zobristKey = undo.zobristKey;
+
+    keyHistory.pop_back();
+
+    valid_metadata = false;
+    valid_moves = false;
+}
+
+Bitboard Position::checkers() const
+{
+    const Bitboard king = pieces[color_playing][KING];
+
+    if(!king) return 0;
+
+    return color_playing == WHITE ? attackersTo<BLACK>(LowestSquare(king), occupied())
+                                  : attackersTo<WHITE>(LowestSquare(king), occupied());
+}
+
+template void Position::makeMove<WHITE>(PackedMove move, MoveUndo& undo);
+template void Position::makeMove<BLACK>(PackedMove move, MoveUndo& undo);
+template void Position::unmakeMove<WHITE>(const MoveUndo& undo);
+template void Position::unmakeMove<BLACK>(const MoveUndo& undo);
+
+std::vector<Move> Position::createLegalMoves()
+{
+    ALLOC_SCOPE(ALLOC_LEGACY_MOVES);
+
+    std::vector<Move> allMoves;
+
+    MoveList legal;
+    GenerateLegalMoves(*this, legal);
+
+    allMoves.reserve(legal.size());
+    for(PackedMove move : legal) allMoves.push_back(UnpackMove(move, *this));
 
     return allMoves;
 }
 
 void Position::createMoveStrings()
 {
+    ALLOC_SCOPE(ALLOC_LEGACY_MOVES);
+
+    CreateMoveList();
+
     for(Move& move : metadata.legalMoves) move.createMoveString(*this);
 }
 
+// Group the legal moves by origin square and build the per square target masks
+void Position::IndexLegalMoves()
+{
+    std::vector<Move>& moves = metadata.legalMoves;
+
+    std::stable_sort(moves.begin(), moves.end(), [](const Move& a, const Move& b)
+    {
+        return SquareIndex(a.from) < SquareIndex(b.from);
+    });
+
+    std::memset(metadata.targets, 0, sizeof metadata.targets);
+
+    for(int i = static_cast<int>(moves.size()) - 1; i >= 0; i--)
+    {
+        const int from = SquareIndex(moves[i].from);
+
+        metadata.targets[from] |= 1ULL << SquareIndex(moves[i].to);
+        metadata.firstMove[from] = static_cast<uint8_t>(i);
+    }
+}
+
 bool Position::doesMoveExist(Move& move)
 {
-    CreateMetadata();
+    CreateMoveList();
+
+    if(!validCoord(move.from) || !validCoord(move.to)) return false;
+
+    const int from = SquareIndex(move.from);
 
-    for(Move& validMove : metadata.legalMoves)
+    if(!(metadata.targets[from] & (1ULL << SquareIndex(move.to)))) return false;
+
+    // Only the (at most 27) moves of the origin square are looked at
+    for(size_t i = metadata.firstMove[from]; i < metadata.legalMoves.size(); i++)
     {
-        if(CoordEquals(validMove.from, move.from) && 
-           CoordEquals(validMove.to, move.to)     &&
-           validMove.promotionType == move.promotionType)
+        Move& validMove = metadata.legalMoves[i];
+
+        if(!CoordEquals(validMove.from, move.from)) break;
+
+        if(CoordEquals(validMove.to, move.to) && validMove.promotionType == move.promotionType)
         {
             move = validMove;
             return true;
@@ -543,6 +964,8 @@ bool Position::doesMoveExist(Move& move)
 
 void Position::printLegalMoves()
 {
+    CreateMoveList();
+
     int i = 1;
     for(Move& move : metadata.legalMoves)
     {
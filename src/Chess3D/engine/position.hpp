@@ -1,23 +1,62 @@
 #ifndef CHEESENG_POSITION_H
 #define CHEESENG_POSITION_H
+#include <cstdint>
 #include <iostream>
 #include <vector>
 
+#include "bitboard.hpp"
 #include "coord.hpp"
 #include "piecetypes.hpp"
 #include "move.hpp"
+#include "stats.hpp"
 
 #define BOARD_SIZE 8
 #define MAX_PIECES 32
 #define PLAYER_COUNT 2
 
-enum PositionState{NORMAL, CHECK, CHECKMATE, DRAW, INVALID};
+enum PositionState{NORMAL, CHECK, CHECKMATE, DRAW, INVALID, REPETITION};
 
 struct PositionMetadata
 {
-    std::vector<Move> legalMoves;
+    std::vector<Move> legalMoves;   // grouped by origin square
     PositionState state;
+    bool inCheck;                   // side to move is in check
+    bool drawByRule;                // fifty moves or threefold repetition; state stays CHECK or CHECKMATE when it applies
 
+    // Legal target squares (bit SquareIndex(to)) of each origin square,
+    // and the index of the origin's first move in legalMoves
+    uint64_t targets[BOARD_SIZE * BOARD_SIZE];
+    uint8_t firstMove[BOARD_SIZE * BOARD_SIZE];
+};
+
+// Compile time constants of a side for the color templated generator and make / unmake (squares as SquareIndex)
+template<PieceColor Us>
+struct ColorTraits
+{
+    static constexpr PieceColor Them = Us == WHITE ? BLACK : WHITE;
+    static constexpr int Up = Us == WHITE ? 8 : -8;
+
+    static constexpr int KingStart       = Us == WHITE ? 4 : 60;
+    static constexpr int ShortKingTarget = KingStart + 2, LongKingTarget = KingStart - 2;
+    static constexpr int ShortRookStart  = KingStart + 3, LongRookStart  = KingStart - 4;
+    static constexpr int ShortRookTarget = KingStart + 1, LongRookTarget = KingStart - 1;
+
+    static constexpr Bitboard DoublePushRank = Us == WHITE ? RANK_1_BB << 16 : RANK_1_BB << 40;  // after the first step
+    static constexpr Bitboard PromotionRank  = Us == WHITE ? RANK_8_BB : RANK_1_BB;
+};
+
+struct BoardState;
+
+// Everything makeMove changes that unmakeMove cannot work out from the move itself
+struct MoveUndo
+{
+    PackedMove move;
+    Piece captured;
+    int capturedSquare;
+    Coord en_passant;
+    bool castling_rights[PLAYER_COUNT][2];
+    int halfmoveClock;
+    uint64_t zobristKey;
 };
 
 class Position
@@ -31,42 +70,106 @@ public:
     
     Coord kingPositions[2];
 
+    // The same placement as bitboards, kept in step with position_grid by setPieceAtSquare
+    Bitboard pieces[PLAYER_COUNT][6];   // [color][type]
+    Bitboard occupancy[PLAYER_COUNT];
+
+    // Zobrist hash, kept up to date by setPieceAtCoord and applyMove
+    uint64_t zobristKey;
+
+    // The same piece keys over the pawns alone, for the pawn structure cache
+    uint64_t pawnKey;
+
+    // Keys of the positions before this one, indexed by ply. Pushed by applyMove.
+    std::vector<uint64_t> keyHistory;
+
+    // state and inCheck are valid with valid_metadata, the move list and its index with valid_moves
     PositionMetadata metadata;
     bool valid_metadata;
+    bool valid_moves;
 
     std::string FEN; 
 
+#ifdef ENGINE_STATS
+    CopyCounter<STAT_POSITION_COPIES> copies;
+#endif
+
     // Constructors
     Position(const std::string& fen);
+    explicit Position(const BoardState& state);
 
     Piece getPieceAtCoord(Coord coord) const;
     void setPieceAtCoord(Coord coord, Piece piece);
+    void setPieceAtSquare(int square, Piece piece);
+    Bitboard occupied() const { return occupancy[WHITE] | occupancy[BLACK]; }
 
     bool isLegal();
     bool isPlayable();
     bool isInCheck(PieceColor color);
+    bool isRepetition(int count) const;
+    bool hasAnyLegalMove();
     PositionState getPositionState();
     
 
-    std::string CreateFENString();
+    std::string CreateFENString() const;
     void CreateMetadata();
-    void CreateState();
-    void ClearMetadata();
+    void CreateMoveList();
+    void IndexLegalMoves();
     
     void findKings();
+    void computeBitboards();
+    uint64_t computeZobristKey() const;
+    uint64_t computePawnKey() const;
 
     void DebugPrint() const;
 
     bool doesMoveExist(Move& move);
     void createMoveStrings();
     void playMove(const Move& move, Position& newPosition);
+    void applyMove(const Move& move);
+
+    // In place make / unmake for the search. The move must be legal, unmakeMove takes back the last made move.
+    void makeMove(PackedMove move, MoveUndo& undo);
+    void unmakeMove(const MoveUndo& undo);
+
+    template<PieceColor Us> void makeMove(PackedMove move, MoveUndo& undo);
+    template<PieceColor Us> void unmakeMove(const MoveUndo& undo);
+
+    // Pass the turn (null move pruning). Repetitions are not looked for across a null move.
+    void makeNullMove(MoveUndo& undo);
+    void unmakeNullMove(const MoveUndo& undo);
+
+    // Enemy pieces giving check to the side to move
+    Bitboard checkers() const;
 
     void printLegalMoves();
 
     std::vector<Move> createLegalMoves();
     int AttackersTargetingCoord(Coord target, PieceColor color, MoveTypes castingTypes, std::vector<Coord> *out_moves=nullptr) const;
     std::vector<Move> MovesFromSquare(Coord square);
+
+    // Non allocating queries for the hot loops (SAN resolution, replay)
+    bool isSquareAttacked(Coord target, PieceColor attacker) const;
+    int PiecesAttackingCoord(Coord target, Piece piece, Coord *out, int maxOut) const;
+    bool canCastle(CastlingMove type) const;
+    bool isMoveLegal(const Move& move);
+    bool givesCheck(const Move& move);
+
+    template<PieceColor Attacker> Bitboard attackersTo(int square, Bitboard occupied) const;
 };
 
+// Pieces of Attacker that reach square, with the sliders blocked by occupied
+template<PieceColor Attacker>
+inline Bitboard Position::attackersTo(int square, Bitboard occupied) const
+{
+    const Bitboard *p = pieces[Attacker];
+
+    return (PawnAttacks(ColorTraits<Attacker>::Them, square) & p[PAWN]) |
+           (KnightAttacks(square) & p[KNIGHT]) |
+           (KingAttacks(square) & p[KING]) |
+           (BishopAttacks(square, occupied) & (p[BISHOP] | p[QUEEN])) |
+           (RookAttacks(square, occupied) & (p[ROOK] | p[QUEEN]));
+}
+
 
 #endif //CHEESENG_POSITION_H
@@ -0,0 +1,254 @@
+#include <cstdlib>
+
+#include "san.hpp"
+#include "position.hpp"
+#include "lookups.hpp"
+
+// Candidate origins for one SAN token, more than enough for any legal position
+#define MAX_SAN_CANDIDATES 10
+
+static PieceType PieceFromSANChar(char c)
+{
+    switch(c)
+    {
+        case 'N': return KNIGHT;
+        case 'B': return BISHOP;
+        case 'R': return ROOK;
+        case 'Q': return QUEEN;
+        case 'K': return KING;
+        default:  return NO_PIECE;
+    }
+}
+
+static bool IsFileChar(char c) { return c >= 'a' && c <= 'h'; }
+static bool IsRankChar(char c) { return c >= '1' && c <= '8'; }
+
+SanResult ParseSAN(const char *san, size_t length, SanMove& out)
+{
+    const char *begin = san, *end = san + length;
+
+    out.piece = PAWN;
+    out.castlingType = NO_CASTLE;
+    out.to = DEFAULT_INVALID_COORD;
+    out.fromFile = -1;
+    out.fromRank = -1;
+    out.promotionType = NO_PIECE;
+    out.capture = false;
+    out.suffix = 0;
+
+    while(end > begin && (end[-1] == '!' || end[-1] == '?')) end--;
+
+    while(end > begin && (end[-1] == '+' || end[-1] == '#'))
+    {
+        // "#" wins over "+" for "+#" style typos
+        if(out.suffix != '#') out.suffix = end[-1];
+        end--;
+    }
+
+    if(end == begin) return SAN_SYNTAX_ERROR;
+
+    // Castling: O-O, O-O-O (or with zeros)
+    if(*begin == 'O' || *begin == '0')
+    {
+        int castles = 0;
+
+        for(const char *p = begin; p < end; p++)
+        {
+            if(*p == 'O' || *p == '0') castles++;
+            else if(*p != '-') return SAN_SYNTAX_ERROR;
+        }
+
+        if(castles != 2 && castles != 3) return SAN_SYNTAX_ERROR;
+
+        out.piece = KING;
+        out.castlingType = castles == 2 ? SHORT_CASTLE : LONG_CASTLE;
+        return SAN_OK;
+    }
+
+    PieceType piece = PieceFromSANChar(*begin);
+    if(piece != NO_PIECE)
+    {
+        out.piece = piece;
+        begin++;
+    }
+
+    // Promotion: "=Q" or a bare "Q" after the target rank
+    if(end - begin >= 3)
+    {
+        PieceType promotion = PieceFromSANChar(end[-1]);
+
+        if(promotion == NO_PIECE && end[-2] == '=')
+            promotion = PieceFromSANChar(end[-1] - 'a' + 'A');
+
+        if(promotion != NO_PIECE && promotion != KING)
+        {
+            out.promotionType = promotion;
+            end--;
+            if(end[-1] == '=') end--;
+        }
+    }
+
+    if(end - begin < 2 || !IsFileChar(end[-2]) || !IsRankChar(end[-1])) return SAN_SYNTAX_ERROR;
+
+    out.to = Coord(end[-2] - 'a', end[-1] - '1');
+    end -= 2;
+
+    // What is left is the disambiguation and the capture / long algebraic separators
+    for(const char *p = begin; p < end; p++)
+    {
+        if(*p == 'x' || *p == ':') out.capture = true;
+        else if(*p == '-') continue;
+        else if(IsFileChar(*p) && out.fromFile < 0) out.fromFile = *p - 'a';
+        else if(IsRankChar(*p) && out.fromRank < 0) out.fromRank = *p - '1';
+        else return SAN_SYNTAX_ERROR;
+    }
+
+    if(out.piece == PAWN && out.capture && out.fromFile < 0) return SAN_SYNTAX_ERROR;
+
+    return SAN_OK;
+}
+
+static SanResult ResolvePawnMove(Position& pos, const SanMove& san, Move& out)
+{
+    const PieceColor us = pos.color_playing;
+    const int dir = PAWN_MOVING_DIRECTION[us];
+    const Piece ourPawn{PAWN, us};
+    const Coord to = san.to;
+
+    Move move(DEFAULT_INVALID_COORD, to, san.promotionType);
+
+    if(san.fromFile >= 0 && san.fromFile != to.file)
+    {
+        if(std::abs(san.fromFile - to.file) != 1) return SAN_NO_MOVE;
+
+        move.from = Coord(san.fromFile, to.rank - dir);
+        if(!PieceEquals(pos.getPieceAtCoord(move.from), ourPawn)) return SAN_NO_MOVE;
+
+        Piece target = pos.getPieceAtCoord(to);
+
+        if(target.type != NO_PIECE && target.color != us)
+            move.catpureTarget = to;
+        else if(target.type == NO_PIECE && CoordEquals(to, pos.en_passant))
+            move.catpureTarget = Coord(to.file, move.from.rank);
+        else
+            return SAN_NO_MOVE;
+    }
+    else
+    {
+        if(pos.getPieceAtCoord(to).type != NO_PIECE) return SAN_NO_MOVE;
+
+        Coord single(to.file, to.rank - dir);
+
+        if(PieceEquals(pos.getPieceAtCoord(single), ourPawn))
+            move.from = single;
+        else if(pos.getPieceAtCoord(single).type == NO_PIECE &&
+                to.rank == PAWN_STARTING_RANK[us] + 2 * dir &&
+                PieceEquals(pos.getPieceAtCoord(Coord(to.file, to.rank - 2 * dir)), ourPawn))
+            move.from = Coord(to.file, to.rank - 2 * dir);
+        else
+            return SAN_NO_MOVE;
+    }
+
+    if((to.rank == PAWN_PROMOTION_RANK[us]) != (san.promotionType != NO_PIECE)) return SAN_NO_MOVE;
+
+    if(!pos.isMoveLegal(move)) return SAN_NO_MOVE;
+
+    out = move;
+    return SAN_OK;
+}
+
+static SanResult ResolvePieceMove(Position& pos, const SanMove& san, Move& out)
+{
+    const PieceColor us = pos.color_playing;
+    const Coord to = san.to;
+
+    if(san.promotionType != NO_PIECE) return SAN_NO_MOVE;
+
+    Piece target = pos.getPieceAtCoord(to);
+    if(target.type != NO_PIECE && target.color == us) return SAN_NO_MOVE;
+
+    Coord candidates[MAX_SAN_CANDIDATES];
+    int count = pos.PiecesAttackingCoord(to, Piece{san.piece, us}, candidates, MAX_SAN_CANDIDATES);
+    if(count > MAX_SAN_CANDIDATES) count = MAX_SAN_CANDIDATES;
+
+    int legal = 0;
+
+    for(int i = 0; i < count; i++)
+    {
+        const Coord from = candidates[i];
+
+        if(san.fromFile >= 0 && from.file != san.fromFile) continue;
+        if(san.fromRank >= 0 && from.rank != san.fromRank) continue;
+
+        Move move(from, to);
+        if(target.type != NO_PIECE) move.catpureTarget = to;
+
+        if(!pos.isMoveLegal(move)) continue;
+
+        if(legal++ == 0) out = move;
+    }
+
+    if(legal == 0) return SAN_NO_MOVE;
+
+    return legal == 1 ? SAN_OK : SAN_AMBIGUOUS;
+}
+
+static SanResult ValidateSuffix(Position& pos, const SanMove& san, const Move& move)
+{
+    const bool check = pos.givesCheck(move);
+
+    if(!check) return san.suffix == 0 ? SAN_OK : SAN_BAD_SUFFIX;
+    if(san.suffix == 0) return SAN_BAD_SUFFIX;
+
+    Position next(pos);
+    next.applyMove(move);
+
+    const bool mate = next.getPositionState() == CHECKMATE;
+
+    return mate == (san.suffix == '#') ? SAN_OK : SAN_BAD_SUFFIX;
+}
+
+SanResult ResolveSAN(Position& pos, const SanMove& san, Move& out, bool validateSuffix)
+{
+    SanResult result;
+
+    if(san.castlingType != NO_CASTLE)
+    {
+        if(!pos.canCastle(san.castlingType)) return SAN_NO_MOVE;
+
+        out = Move(CASTLING_KING_START_COORD[pos.color_playing],
+                   CASTLING_KING_TARGET_COORD[pos.color_playing][san.castlingType]);
+        out.castlingType = san.castlingType;
+        result = SAN_OK;
+    }
+    else if(san.piece == PAWN)
+        result = ResolvePawnMove(pos, san, out);
+    else
+        result = ResolvePieceMove(pos, san, out);
+
+    if(result == SAN_OK && validateSuffix) result = ValidateSuffix(pos, san, out);
+
+    return result;
+}
+
+SanResult ResolveSAN(Position& pos, const char *san, size_t length, Move& out, bool validateSuffix)
+{
+    SanMove decoded;
+    SanResult result = ParseSAN(san, length, decoded);
+
+    return result == SAN_OK ? ResolveSAN(pos, decoded, out, validateSuffix) : result;
+}
+
+const char *SanResultString(SanResult result)
+{
+    switch(result)
+    {
+        case SAN_OK:           return "ok";
+        case SAN_SYNTAX_ERROR: return "unreadable move";
+        case SAN_NO_MOVE:      return "illegal move";
+        case SAN_AMBIGUOUS:    return "ambiguous move";
+        case SAN_BAD_SUFFIX:   return "wrong check suffix";
+    }
+
+    return "";
+}
@@ -0,0 +1,36 @@
+#ifndef CHEESENG_SAN_H
+#define CHEESENG_SAN_H
+
+#include <cstddef>
+
+#include "coord.hpp"
+#include "move.hpp"
+#include "piecetypes.hpp"
+
+class Position;
+
+enum SanResult{SAN_OK, SAN_SYNTAX_ERROR, SAN_NO_MOVE, SAN_AMBIGUOUS, SAN_BAD_SUFFIX};
+
+// A decoded SAN token, before it is matched against a position
+struct SanMove
+{
+    PieceType piece;
+    CastlingMove castlingType;
+    Coord to;
+    int fromFile, fromRank;  // disambiguation, -1 when not given
+    PieceType promotionType;
+    bool capture;
+    char suffix;             // '+', '#' or 0
+};
+
+// Decode a SAN token ("Nbd7", "exd6", "e8=Q+", "O-O-O", ...). Trailing !? annotations are ignored.
+SanResult ParseSAN(const char *san, size_t length, SanMove& out);
+
+// Find the single legal move matching san. The +/# suffix is only checked with validateSuffix.
+// Nothing is allocated unless a mate suffix is validated.
+SanResult ResolveSAN(Position& pos, const SanMove& san, Move& out, bool validateSuffix=false);
+SanResult ResolveSAN(Position& pos, const char *san, size_t length, Move& out, bool validateSuffix=false);
+
+const char *SanResultString(SanResult result);
+
+#endif //CHEESENG_SAN_H
@@ -0,0 +1,519 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "search.hpp"
+#include "evaluate.hpp"
+#include "movegen.hpp"
+#include "stats.hpp"
+#include "alloctrack.hpp"
+
+#define ASPIRATION_WINDOW 25
+#define ASPIRATION_MIN_DEPTH 5
+
+#define REVERSE_FUTILITY_DEPTH 6
+#define REVERSE_FUTILITY_MARGIN 80
+#define FUTILITY_DEPTH 3
+#define FUTILITY_MARGIN 150
+#define DELTA_MARGIN 200
+
+#define NULL_MOVE_MIN_DEPTH 3
+#define LMR_MIN_DEPTH 3
+#define LMR_MIN_MOVES 4
+
+// Base late move reduction by remaining depth and move number
+struct ReductionTable
+{
+    int values[MAX_PLY][64];
+};
+
+// Built by the initializer of a function local static, which runs once even with searches created on several threads
+static const int (&Reductions())[MAX_PLY][64]
+{
+    static const ReductionTable table = []()
+    {
+        ReductionTable built = {};
+
+        for(int depth = 1; depth < MAX_PLY; depth++)
+            for(int moves = 1; moves < 64; moves++)
+                built.values[depth][moves] = static_cast<int>(0.75 + std::log(depth) * std::log(moves) / 2.25);
+
+        return built;
+    }();
+
+    return table.values;
+}
+
+// Mate scores are stored relative to the node, so they stay right when found through another path
+static inline int ScoreToTT(int score, int ply)
+{
+    return score >= SCORE_MATE_IN_MAX_PLY ? score + ply : score <= -SCORE_MATE_IN_MAX_PLY ? score - ply : score;
+}
+
+static inline int ScoreFromTT(int score, int ply)
+{
+    return score >= SCORE_MATE_IN_MAX_PLY ? score - ply : score <= -SCORE_MATE_IN_MAX_PLY ? score + ply : score;
+}
+
+// The zugzwang guard of null move pruning: with only king and pawns passing is often the best move
+static inline bool HasNonPawnMaterial(const Position& pos, PieceColor color)
+{
+    return (pos.pieces[color][KNIGHT] | pos.pieces[color][BISHOP] | pos.pieces[color][ROOK] | pos.pieces[color][QUEEN]) != 0;
+}
+
+// An even share of the clock, stretched up to three times when an iteration is running
+void AllocateTime(const SearchLimits& limits, PieceColor us, double& softLimit, double& hardLimit)
+{
+    softLimit = hardLimit = 0;
+
+    if(limits.moveTime > 0)
+    {
+        softLimit = hardLimit = limits.moveTime / 1000.0;
+    }
+    else if(limits.time[us] > 0 && !limits.infinite)
+    {
+        const double left = limits.time[us] / 1000.0, increment = limits.increment[us] / 1000.0;
+        const double share = left / (limits.movesToGo > 0 ? limits.movesToGo : 30) + increment * 0.75;
+
+        hardLimit = std::max(0.01, std::min(left - 0.05, share * 3));
+        softLimit = std::min(hardLimit, share);
+    }
+}
+
+std::string UciScore(int score)
+{
+    if(score >= SCORE_MATE_IN_MAX_PLY)  return "mate " + std::to_string((SCORE_MATE - score + 1) / 2);
+    if(score <= -SCORE_MATE_IN_MAX_PLY) return "mate " + std::to_string(-(SCORE_MATE + score) / 2);
+
+    return "cp " + std::to_string(score);
+}
+
+Search::Search(TranspositionTable& tt) : tt(tt), pos(nullptr), softLimit(0), hardLimit(0), stopped(false), ponder(PONDER_OFF),
+                                         nodes(0), selDepth(0)
+{
+    Reductions();
+    clear();
+}
+
+void Search::clear()
+{
+    history.clear();
+    std::memset(killers, 0, sizeof killers);
+}
+
+double Search::elapsed() const
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+double Search::clockElapsed() const
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - clockStart).count();
+}
+
+// False while pondering; on the ponderhit the clock is started from zero
+bool Search::clockRunning()
+{
+    if(ponder == PONDER_HIT)
+    {
+        clockStart = std::chrono::steady_clock::now();
+        ponder = PONDER_OFF;
+    }
+
+    return ponder == PONDER_OFF;
+}
+
+void Search::checkLimits()
+{
+    if(limits.nodes && nodes >= limits.nodes) stopped = true;
+    if(hardLimit > 0 && clockRunning() && clockElapsed() >= hardLimit) stopped = true;
+}
+
+void Search::updatePv(int ply, PackedMove move)
+{
+    pv[ply][ply] = move;
+
+    for(int i = ply + 1; i < pvLength[ply + 1]; i++) pv[ply][i] = pv[ply + 1][i];
+
+    pvLength[ply] = std::max(pvLength[ply + 1], ply + 1);
+}
+
+SearchResult Search::run(const Position& root, const SearchLimits& searchLimits, const SearchReporter& report)
+{
+    ALLOC_SCOPE(ALLOC_SEARCH_ROOT);
+
+    Position position = root;
+    pos = &position;
+
+    // Make and null moves push a key per ply; reserving them here keeps negamax free of allocations
+    position.keyHistory.reserve(position.keyHistory.size() + MAX_PLY);
+
+    limits = searchLimits;
+    start = clockStart = std::chrono::steady_clock::now();
+    stopped = false;
+    ponder = limits.ponder ? PONDER_ON : PONDER_OFF;
+    nodes = 0;
+    AllocateTime(limits, root.color_playing, softLimit, hardLimit);
+
+    std::memset(pvLength, 0, sizeof pvLength);
+    std::memset(pv, 0, sizeof pv);
+
+    SearchResult result = {NULL_PACKED_MOVE, NULL_PACKED_MOVE, 0, 0, 0, 0};
+
+    // Always have a move to play, even when stopped during the first iteration
+    MoveList rootMoves;
+    GenerateLegalMoves(position, rootMoves);
+    if(rootMoves.size()) result.bestMove = rootMoves[0];
+    else result.score = position.checkers() ? -SCORE_MATE : SCORE_DRAW;
+
+    int score = 0;
+
+    for(int depth = 1; depth <= limits.depth && rootMoves.size(); depth++)
+    {
+        selDepth = 0;
+
+        int delta = ASPIRATION_WINDOW;
+        int alpha = -SCORE_INFINITE, beta = SCORE_INFINITE;
+
+        if(options.aspiration && depth >= ASPIRATION_MIN_DEPTH)
+        {
+            alpha = std::max(score - delta, -SCORE_INFINITE);
+            beta = std::min(score + delta, SCORE_INFINITE);
+        }
+
+        // Widen the window on the failing side until the score falls inside it
+        while(true)
+        {
+            score = negamax(depth, 0, alpha, beta, false);
+
+            if(stopped) break;
+
+            if(score <= alpha)
+            {
+                beta = (alpha + beta) / 2;
+                alpha = std::max(score - delta, -SCORE_INFINITE);
+            }
+            else if(score >= beta)
+            {
+                beta = std::min(score + delta, SCORE_INFINITE);
+            }
+            else
+            {
+                break;
+            }
+
+            delta += delta / 2;
+        }
+
+        // An unfinished iteration is only trusted for its move, when it already changed its mind about the best
+        // one; its score is the 0 of the cut off search, so score and depth stay those of the last full iteration
+        if(stopped)
+        {
+            if(pvLength[0] && depth > 1 && pv[0][0] != result.bestMove)
+            {
+                result.bestMove = pv[0][0];
+                result.ponderMove = pvLength[0] > 1 ? pv[0][1] : NULL_PACKED_MOVE;
+            }
+
+            break;
+        }
+
+        result.bestMove = pv[0][0];
+        result.ponderMove = pvLength[0] > 1 ? pv[0][1] : NULL_PACKED_MOVE;
+        result.score = score;
+        result.depth = depth;
+
+        if(report)
+        {
+            SearchInfo info = {depth, selDepth, score, nodes, elapsed(), std::vector<PackedMove>(pv[0], pv[0] + pvLength[0])};
+            report(info);
+        }
+
+        // A new iteration would likely not finish in time
+        if(softLimit > 0 && clockRunning() && clockElapsed() >= softLimit * 0.6) break;
+    }
+
+    result.nodes = nodes;
+    result.seconds = elapsed();
+    pos = nullptr;
+    ponder = PONDER_OFF;
+
+    return result;
+}
+
+int Search::negamax(int depth, int ply, int alpha, int beta, bool nullAllowed)
+{
+    ALLOC_SCOPE(ALLOC_SEARCH);
+
+    Position& pos = *this->pos;
+    const bool pvNode = beta - alpha > 1;
+    const bool rootNode = ply == 0;
+    const bool inCheck = pos.checkers() != 0;
+
+    pvLength[ply] = ply;
+
+    if(inCheck && options.checkExtensions) depth++;
+
+    if(depth <= 0) return quiescence(ply, alpha, beta);
+
+    nodes++;
+    STAT_INC(STAT_NODES);
+    if((nodes & 1023) == 0) checkLimits();
+    if(stopped) return 0;
+
+    if(ply > selDepth) selDepth = ply;
+
+    if(!rootNode)
+    {
+        if(pos.halfmoveClock >= 100 || pos.isRepetition(2)) return SCORE_DRAW;
+        if(ply >= MAX_PLY - 1) return inCheck ? SCORE_DRAW : Evaluate(pos);
+
+        // Mate distance pruning: no score here can beat a shorter mate already found
+        alpha = std::max(alpha, -SCORE_MATE + ply);
+        beta = std::min(beta, SCORE_MATE - ply - 1);
+        if(alpha >= beta) return alpha;
+    }
+
+    TTEntry entry;
+    const bool ttHit = tt.probe(pos.zobristKey, entry);
+    const PackedMove ttMove = ttHit ? entry.move : NULL_PACKED_MOVE;
+
+    STAT_INC(STAT_TT_PROBES);
+    if(ttHit) STAT_INC(STAT_TT_HITS);
+
+    if(ttHit && !pvNode && entry.depth >= depth)
+    {
+        const int ttScore = ScoreFromTT(entry.score, ply);
+
+        if(entry.bound == BOUND_EXACT || (entry.bound == BOUND_LOWER && ttScore >= beta) ||
+           (entry.bound == BOUND_UPPER && ttScore <= alpha))
+        {
+            STAT_INC(STAT_TT_CUTOFFS);
+            return ttScore;
+        }
+    }
+
+    const int staticEval = inCheck ? -SCORE_INFINITE : ttHit ? entry.eval : Evaluate(pos);
+
+    if(!pvNode && !inCheck)
+    {
+        if(options.reverseFutility && depth <= REVERSE_FUTILITY_DEPTH &&
+           staticEval - REVERSE_FUTILITY_MARGIN * depth >= beta && std::abs(beta) < SCORE_MATE_IN_MAX_PLY)
+            return staticEval;
+
+        if(options.nullMove && nullAllowed && depth >= NULL_MOVE_MIN_DEPTH && staticEval >= beta &&
+           HasNonPawnMaterial(pos, pos.color_playing))
+        {
+            const int reduction = 3 + depth / 6;
+            MoveUndo undo;
+            STAT_INC(STAT_NULL_MOVE_TRIES);
+
+            pos.makeNullMove(undo);
+            int score = -negamax(depth - 1 - reduction, ply + 1, -beta, -beta + 1, false);
+            pos.unmakeNullMove(undo);
+
+            if(stopped) return 0;
+
+            // Unproven mates from a null move search are not returned
+            if(score >= beta)
+            {
+                STAT_INC(STAT_NULL_MOVE_CUTOFFS);
+                return score >= SCORE_MATE_IN_MAX_PLY ? beta : score;
+            }
+        }
+    }
+
+    const bool futile = options.futility && !pvNode && !inCheck && depth <= FUTILITY_DEPTH &&
+                        staticEval + FUTILITY_MARGIN * depth <= alpha;
+
+    MovePicker picker(pos, ttMove, killers[ply], &history);
+    PackedMove quietsTried[MAX_MOVES];
+    int quietCount = 0, moveCount = 0;
+
+    int bestScore = -SCORE_INFINITE;
+    PackedMove bestMove = NULL_PACKED_MOVE;
+    const int originalAlpha = alpha;
+
+    for(PackedMove move; (move = picker.next()) != NULL_PACKED_MOVE; )
+    {
+        const bool quiet = IsQuietMove(pos, move);
+        moveCount++;
+
+        MoveUndo undo;
+        pos.makeMove(move, undo);
+
+        const bool givesCheck = pos.checkers() != 0;
+
+        if(futile && quiet && !givesCheck && moveCount > 1 && bestScore > -SCORE_MATE_IN_MAX_PLY)
+        {
+            pos.unmakeMove(undo);
+            continue;
+        }
+
+        const int newDepth = depth - 1;
+        int reduction = 0;
+
+        if(options.lmr && depth >= LMR_MIN_DEPTH && moveCount >= LMR_MIN_MOVES && quiet && !inCheck && !givesCheck)
+        {
+            reduction = Reductions()[std::min(depth, MAX_PLY - 1)][std::min(moveCount, 63)];
+
+            // History moves the reduction by up to two plies either way
+            reduction -= history.get(OTHER_COLOR(pos.color_playing), move) / 8192;
+            if(pvNode) reduction--;
+
+            reduction = std::max(0, std::min(reduction, newDepth - 1));
+        }
+
+        int score = 0;
+        bool fullDepth = true;
+
+        if(reduction > 0)
+        {
+            STAT_INC(STAT_LMR_REDUCTIONS);
+
+            score = -negamax(newDepth - reduction, ply + 1, -alpha - 1, -alpha, true);
+            fullDepth = score > alpha;
+
+            if(fullDepth) STAT_INC(STAT_LMR_RESEARCHES);
+        }
+
+        if(fullDepth)
+        {
+            if(options.pvs && moveCount > 1)
+            {
+                score = -negamax(newDepth, ply + 1, -alpha - 1, -alpha, true);
+
+                if(score > alpha && score < beta)
+                {
+                    STAT_INC(STAT_PVS_RESEARCHES);
+                    score = -negamax(newDepth, ply + 1, -beta, -alpha, true);
+                }
+            }
+            else
+            {
+                score = -negamax(newDepth, ply + 1, -beta, -alpha, true);
+            }
+        }
+
+        pos.unmakeMove(undo);
+
+        if(stopped) return 0;
+
+        if(score > bestScore)
+        {
+            bestScore = score;
+
+            if(score > alpha)
+            {
+                bestMove = move;
+                alpha = score;
+                updatePv(ply, move);
+
+                if(score >= beta)
+                {
+                    STAT_INC(STAT_BETA_CUTOFFS);
+                    if(moveCount == 1) STAT_INC(STAT_FIRST_MOVE_CUTOFFS);
+
+                    if(quiet)
+                    {
+                        if(killers[ply][0] != move)
+                        {
+                            killers[ply][1] = killers[ply][0];
+                            killers[ply][0] = move;
+                        }
+
+                        // The cutoff move gains, the quiet moves tried before it lose
+                        history.update(pos.color_playing, move, depth * depth);
+                        for(int i = 0; i < quietCount; i++) history.update(pos.color_playing, quietsTried[i], -depth * depth);
+                    }
+
+                    break;
+                }
+            }
+        }
+
+        if(quiet && quietCount < MAX_MOVES) quietsTried[quietCount++] = move;
+    }
+
+    if(moveCount == 0) return inCheck ? -SCORE_MATE + ply : SCORE_DRAW;
+
+    const TTBound bound = bestScore >= beta ? BOUND_LOWER : alpha > originalAlpha ? BOUND_EXACT : BOUND_UPPER;
+    tt.store(pos.zobristKey, bestMove, ScoreToTT(bestScore, ply), inCheck ? 0 : staticEval, depth, bound);
+
+    return bestScore;
+}
+
+int Search::quiescence(int ply, int alpha, int beta)
+{
+    Position& pos = *this->pos;
+    const bool inCheck = pos.checkers() != 0;
+
+    pvLength[ply] = ply;
+
+    nodes++;
+    STAT_INC(STAT_NODES);
+    STAT_INC(STAT_QNODES);
+    if((nodes & 1023) == 0) checkLimits();
+    if(stopped) return 0;
+
+    if(ply > selDepth) selDepth = ply;
+    if(ply >= MAX_PLY - 1) return inCheck ? SCORE_DRAW : Evaluate(pos);
+
+    TTEntry entry;
+    const PackedMove ttMove = tt.probe(pos.zobristKey, entry) ? entry.move : NULL_PACKED_MOVE;
+
+    int bestScore = -SCORE_INFINITE, standPat = 0;
+
+    // Standing pat: the side to move is assumed to have a quiet move at least as good as the evaluation
+    if(!inCheck)
+    {
+        standPat = Evaluate(pos);
+        if(standPat >= beta) return standPat;
+
+        alpha = std::max(alpha, standPat);
+        bestScore = standPat;
+    }
+
+    MovePicker picker(pos, ttMove, inCheck);
+    int moveCount = 0;
+
+    for(PackedMove move; (move = picker.next()) != NULL_PACKED_MOVE; )
+    {
+        moveCount++;
+
+        // Delta pruning: even winning the piece on the target square would not reach alpha
+        if(!inCheck && !PackedPromotion(move))
+        {
+            const int to = PackedTo(move);
+            const int gain = PieceValue(pos.position_grid[to % BOARD_SIZE][to / BOARD_SIZE].type);
+
+            if(standPat + (gain ? gain : PAWN_VALUE) + DELTA_MARGIN <= alpha) continue;
+        }
+
+        MoveUndo undo;
+        pos.makeMove(move, undo);
+        const int score = -quiescence(ply + 1, -beta, -alpha);
+        pos.unmakeMove(undo);
+
+        if(stopped) return 0;
+
+        if(score > bestScore)
+        {
+            bestScore = score;
+
+            if(score > alpha)
+            {
+                alpha = score;
+                updatePv(ply, move);
+
+                if(score >= beta) break;
+            }
+        }
+    }
+
+    if(inCheck && moveCount == 0) return -SCORE_MATE + ply;
+
+    return bestScore;
+}
@@ -0,0 +1,131 @@
+#ifndef CHEESENG_SEARCH_H
+#define CHEESENG_SEARCH_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "movepicker.hpp"
+#include "position.hpp"
+#include "tt.hpp"
+
+#define MAX_PLY 128
+
+#define SCORE_INFINITE 32001
+#define SCORE_MATE 32000
+#define SCORE_MATE_IN_MAX_PLY (SCORE_MATE - MAX_PLY)
+#define SCORE_DRAW 0
+
+// Every selective feature can be switched off to measure what it buys on a fixed bench
+struct SearchOptions
+{
+    bool pvs = true;                // null window for all moves after the first, re-search on fail high
+    bool aspiration = true;         // narrow root window around the previous iteration's score
+    bool nullMove = true;           // with a zugzwang guard: never without a piece besides pawns
+    bool lmr = true;                // late quiet moves searched shallower, less so with good history
+    bool futility = true;           // quiet moves skipped near the leaves when far below alpha
+    bool reverseFutility = true;    // static eval far above beta near the leaves cuts the node
+    bool checkExtensions = true;    // one ply more when in check
+};
+
+struct SearchLimits
+{
+    int depth = MAX_PLY - 1;
+    uint64_t nodes = 0;             // 0: no limit
+    int64_t moveTime = 0;           // milliseconds, 0: not set
+    int64_t time[PLAYER_COUNT] = {0, 0};
+    int64_t increment[PLAYER_COUNT] = {0, 0};
+    int movesToGo = 0;
+    bool infinite = false;
+    bool ponder = false;            // no time limit until ponderhit, the clock starts then
+};
+
+// Reported after every completed iteration
+struct SearchInfo
+{
+    int depth;
+    int selDepth;
+    int score;
+    uint64_t nodes;
+    double seconds;
+    std::vector<PackedMove> pv;
+};
+
+typedef std::function<void(const SearchInfo& info)> SearchReporter;
+
+// A run with limits.ponder starts in PONDER_ON; ponderhit() moves it to PONDER_HIT from another thread and the
+// search itself to PONDER_OFF when it starts its clock
+enum PonderState{PONDER_OFF, PONDER_ON, PONDER_HIT};
+
+inline bool PonderHit(std::atomic<int>& state)
+{
+    int expected = PONDER_ON;
+    return state.compare_exchange_strong(expected, PONDER_HIT);
+}
+
+struct SearchResult
+{
+    PackedMove bestMove;
+    PackedMove ponderMove;
+    int score;
+    int depth;
+    uint64_t nodes;
+    double seconds;
+};
+
+// Iterative deepening alpha-beta with quiescence. The table is shared, everything else belongs to the search.
+class Search
+{
+public:
+    explicit Search(TranspositionTable& tt);
+
+    SearchOptions options;
+
+    SearchResult run(const Position& root, const SearchLimits& limits, const SearchReporter& report=SearchReporter());
+    void stop() { stopped = true; }
+
+    // The move pondered on was played: the search goes on under its time limits, keeping what it found.
+    // False when no pondering run is going on (not started yet, or over).
+    bool ponderhit() { return PonderHit(ponder); }
+
+    // Forget killers and history (new game)
+    void clear();
+
+private:
+    int negamax(int depth, int ply, int alpha, int beta, bool nullAllowed);
+    int quiescence(int ply, int alpha, int beta);
+
+    void checkLimits();
+    bool clockRunning();
+    void updatePv(int ply, PackedMove move);
+    double elapsed() const;
+    double clockElapsed() const;
+
+    TranspositionTable& tt;
+    Position *pos;
+
+    SearchLimits limits;
+    std::chrono::steady_clock::time_point start, clockStart;
+    double softLimit, hardLimit;    // seconds from clockStart, 0 when not timed
+    std::atomic<bool> stopped;
+    std::atomic<int> ponder;        // PonderState
+
+    uint64_t nodes;
+    int selDepth;
+
+    HistoryTable history;
+    PackedMove killers[MAX_PLY][2];
+    PackedMove pv[MAX_PLY][MAX_PLY];
+    int pvLength[MAX_PLY];
+};
+
+// Seconds to aim for and never to pass on this move, both 0 when the search is not timed
+void AllocateTime(const SearchLimits& limits, PieceColor us, double& softLimit, double& hardLimit);
+
+// "cp 35" or "mate -3", as UCI prints scores
+std::string UciScore(int score);
+
+#endif //CHEESENG_SEARCH_H
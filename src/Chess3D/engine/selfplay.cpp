@@ -0,0 +1,130 @@
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#include "movegen.hpp"
+#include "playout.hpp"
+#include "search.hpp"
+#include "selfplay.hpp"
+#include "tt.hpp"
+
+static TrainingRecord MakeRecord(const Position& pos, int score)
+{
+    TrainingRecord record;
+    std::memset(&record, 0, sizeof record);
+
+    record.state = BoardStateFromPosition(pos);
+    record.score = static_cast<int16_t>(score);
+
+    return record;
+}
+
+// One game from start; its positions go to records, scored but without a result yet
+static GameResult PlayGame(const SelfPlayOptions& options, const Position& start, Xorshift& rng, Search& search,
+                           std::vector<TrainingRecord>& records)
+{
+    Position pos = start;
+    pos.keyHistory.reserve(pos.keyHistory.size() + options.maxPlies + 1);
+
+    SearchLimits limits;
+    limits.nodes = options.nodes;
+
+    int leader = 0, leadPlies = 0;       // sign of the side adjudication would favour, plies it has held
+
+    for(int ply = 0; ; ply++)
+    {
+        MoveList moves;
+        GenerateLegalMoves(pos, moves);
+
+        if(moves.size() == 0)
+            return !pos.checkers() ? RESULT_DRAW : pos.color_playing == WHITE ? RESULT_BLACK_WINS : RESULT_WHITE_WINS;
+
+        if(pos.halfmoveClock >= 100 || pos.isRepetition(3) || InsufficientMaterial(pos) || ply >= options.maxPlies)
+            return RESULT_DRAW;
+
+        PackedMove move;
+
+        if(ply < options.randomPlies)
+        {
+            move = moves[rng.below(moves.size())];
+        }
+        else
+        {
+            const SearchResult searched = search.run(pos, limits);
+            move = searched.bestMove;
+
+            const bool mate = searched.score >= SCORE_MATE_IN_MAX_PLY || searched.score <= -SCORE_MATE_IN_MAX_PLY;
+            const bool skip = mate || (options.skipChecks && pos.checkers()) || (options.skipNoisy && !IsQuietMove(pos, move));
+
+            if(!skip) records.push_back(MakeRecord(pos, searched.score));
+
+            if(options.adjudicateScore)
+            {
+                const int whiteScore = pos.color_playing == WHITE ? searched.score : -searched.score;
+                const int side = whiteScore >= options.adjudicateScore ? 1 : whiteScore <= -options.adjudicateScore ? -1 : 0;
+
+                leadPlies = side && side == leader ? leadPlies + 1 : side ? 1 : 0;
+                leader = side;
+
+                if(leadPlies >= options.adjudicatePlies) return leader > 0 ? RESULT_WHITE_WINS : RESULT_BLACK_WINS;
+            }
+        }
+
+        MoveUndo undo;
+        pos.makeMove(move, undo);
+    }
+}
+
+SelfPlayProgress RunSelfPlay(const SelfPlayOptions& options, TrainingDataWriter& out, const SelfPlayReporter& report)
+{
+    const int threads = options.threads > 0 ? options.threads : 1;
+    const auto start = std::chrono::steady_clock::now();
+
+    std::vector<Position> openings;
+    for(const std::string& fen : options.openings) openings.emplace_back(fen);
+    if(openings.empty()) openings.emplace_back(std::string(PGN_STARTING_FEN));
+
+    std::atomic<uint64_t> next(0);
+    std::mutex mutex;
+    SelfPlayProgress progress = {0, 0, {0, 0, 0, 0}, 0};
+
+    auto worker = [&]()
+    {
+        TranspositionTable tt(options.tableMB);
+        Search search(tt);
+        std::vector<TrainingRecord> records;
+
+        for(uint64_t game; (game = next++) < options.games; )
+        {
+            Xorshift rng(GameSeed(options.seed, game));
+
+            tt.clear();
+            search.clear();
+            records.clear();
+
+            const GameResult result = PlayGame(options, openings[game % openings.size()], rng, search, records);
+            for(TrainingRecord& record : records) record.result = static_cast<uint8_t>(result);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            out.addGame(records);
+
+            progress.games++;
+            progress.positions += records.size();
+            progress.results[result]++;
+            progress.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            if(report) report(progress);
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for(int t = 1; t < threads; t++) pool.emplace_back(worker);
+    worker();
+    for(std::thread& thread : pool) thread.join();
+
+    progress.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    return progress;
+}
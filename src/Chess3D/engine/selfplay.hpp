@@ -0,0 +1,50 @@
+#ifndef CHEESENG_SELFPLAY_H
+#define CHEESENG_SELFPLAY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "trainingdata.hpp"
+
+struct SelfPlayOptions
+{
+    uint64_t games = 1000;
+    int threads = 1;
+    uint64_t nodes = 5000;              // search nodes per move
+    size_t tableMB = 8;                 // per thread, cleared before every game
+
+    // Game i starts from openings[i % size], the starting position when there are none,
+    // followed by randomPlies random legal moves. Positions are written after the random moves only.
+    std::vector<std::string> openings;
+    int randomPlies = 8;
+    uint64_t seed = 1;
+
+    int maxPlies = 400;                 // a draw when reached
+    int adjudicateScore = 1500;         // a win once one side's score stays this high for adjudicatePlies plies, 0: never
+    int adjudicatePlies = 6;
+
+    bool skipChecks = true;             // positions in check are not written
+    bool skipNoisy = true;              // nor those whose best move is a capture or a promotion
+};
+
+struct SelfPlayProgress
+{
+    uint64_t games;
+    uint64_t positions;
+    uint64_t results[4];                // by GameResult
+    double seconds;
+};
+
+typedef std::function<void(const SelfPlayProgress& progress)> SelfPlayReporter;
+
+// Play options.games games of the engine against itself on options.threads threads, every thread with its own
+// search and table. Each game is written to out when it finishes, then report is called.
+// Game i is seeded from options.seed and i alone: its moves do not depend on the thread count, only the
+// order of the games in the file does. Positions with a mate score are never written.
+SelfPlayProgress RunSelfPlay(const SelfPlayOptions& options, TrainingDataWriter& out,
+                             const SelfPlayReporter& report=SelfPlayReporter());
+
+#endif //CHEESENG_SELFPLAY_H
@@ -0,0 +1,178 @@
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+#include "stats.hpp"
+
+static const char *STAT_NAMES[STAT_COUNT] =
+{
+    "nodes",
+    "qnodes",
+    "tt_probes",
+    "tt_hits",
+    "tt_cutoffs",
+    "beta_cutoffs",
+    "first_move_cutoffs",
+    "null_move_tries",
+    "null_move_cutoffs",
+    "lmr_reductions",
+    "lmr_researches",
+    "pvs_researches",
+    "pawn_probes",
+    "pawn_hits",
+    "eval_probes",
+    "eval_hits",
+    "gen_all",
+    "gen_captures",
+    "gen_quiets",
+    "position_copies",
+    "position_allocations",
+};
+
+const char *StatName(StatCounter counter)
+{
+    return STAT_NAMES[counter];
+}
+
+#ifdef ENGINE_STATS
+
+// The blocks of the live threads, and what the finished ones counted
+struct StatsRegistry
+{
+    std::mutex mutex;
+    std::vector<ThreadStats*> threads;
+    uint64_t retired[STAT_COUNT] = {};
+};
+
+static StatsRegistry& Registry()
+{
+    static StatsRegistry registry;
+    return registry;
+}
+
+thread_local ThreadStats threadStats;
+
+ThreadStats::ThreadStats()
+{
+    for(std::atomic<uint64_t>& count : counts) count.store(0, std::memory_order_relaxed);
+
+    StatsRegistry& registry = Registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.threads.push_back(this);
+}
+
+ThreadStats::~ThreadStats()
+{
+    StatsRegistry& registry = Registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    for(int i = 0; i < STAT_COUNT; i++) registry.retired[i] += counts[i].load(std::memory_order_relaxed);
+    registry.threads.erase(std::remove(registry.threads.begin(), registry.threads.end(), this), registry.threads.end());
+}
+
+StatsSnapshot CollectStats()
+{
+    StatsRegistry& registry = Registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    StatsSnapshot stats;
+    for(int i = 0; i < STAT_COUNT; i++) stats.counts[i] = registry.retired[i];
+
+    for(const ThreadStats *thread : registry.threads)
+        for(int i = 0; i < STAT_COUNT; i++) stats.counts[i] += thread->counts[i].load(std::memory_order_relaxed);
+
+    return stats;
+}
+
+void ResetStats()
+{
+    StatsRegistry& registry = Registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    for(uint64_t& count : registry.retired) count = 0;
+
+    for(ThreadStats *thread : registry.threads)
+        for(std::atomic<uint64_t>& count : thread->counts) count.store(0, std::memory_order_relaxed);
+}
+
+#else
+
+StatsSnapshot CollectStats()
+{
+    StatsSnapshot stats = {};
+    return stats;
+}
+
+void ResetStats()
+{
+}
+
+#endif
+
+static double Percent(uint64_t part, uint64_t whole)
+{
+    return whole ? 100.0 * part / whole : 0.0;
+}
+
+struct StatRate
+{
+    const char *name;
+    StatCounter part, whole;
+};
+
+// How often a search feature does what it is there for
+static const StatRate STAT_RATES[] =
+{
+    {"tt_hit_rate", STAT_TT_HITS, STAT_TT_PROBES},
+    {"tt_cutoff_rate", STAT_TT_CUTOFFS, STAT_TT_PROBES},
+    {"first_move_cutoff_rate", STAT_FIRST_MOVE_CUTOFFS, STAT_BETA_CUTOFFS},
+    {"null_move_success_rate", STAT_NULL_MOVE_CUTOFFS, STAT_NULL_MOVE_TRIES},
+    {"lmr_research_rate", STAT_LMR_RESEARCHES, STAT_LMR_REDUCTIONS},
+    {"qnode_share", STAT_QNODES, STAT_NODES},
+    {"pawn_hit_rate", STAT_PAWN_HITS, STAT_PAWN_PROBES},
+    {"eval_hit_rate", STAT_EVAL_HITS, STAT_EVAL_PROBES},
+};
+
+std::string StatsSummary(const StatsSnapshot& stats)
+{
+    char line[512];
+
+    std::snprintf(line, sizeof line,
+                  "nodes %" PRIu64 " qnodes %" PRIu64 " tthit %.1f%% ttcut %.1f%% firstcut %.1f%% null %.1f%% "
+                  "lmrresearch %.1f%% pawnhit %.1f%% evalhit %.1f%% gen %" PRIu64 "/%" PRIu64 "/%" PRIu64 " copies %" PRIu64,
+                  stats[STAT_NODES], stats[STAT_QNODES],
+                  Percent(stats[STAT_TT_HITS], stats[STAT_TT_PROBES]),
+                  Percent(stats[STAT_TT_CUTOFFS], stats[STAT_TT_PROBES]),
+                  Percent(stats[STAT_FIRST_MOVE_CUTOFFS], stats[STAT_BETA_CUTOFFS]),
+                  Percent(stats[STAT_NULL_MOVE_CUTOFFS], stats[STAT_NULL_MOVE_TRIES]),
+                  Percent(stats[STAT_LMR_RESEARCHES], stats[STAT_LMR_REDUCTIONS]),
+                  Percent(stats[STAT_PAWN_HITS], stats[STAT_PAWN_PROBES]),
+                  Percent(stats[STAT_EVAL_HITS], stats[STAT_EVAL_PROBES]),
+                  stats[STAT_GEN_ALL], stats[STAT_GEN_CAPTURES], stats[STAT_GEN_QUIETS],
+                  stats[STAT_POSITION_COPIES]);
+
+    return line;
+}
+
+std::string StatsJSON(const StatsSnapshot& stats)
+{
+    std::string json = "{";
+    char field[96];
+
+    for(int i = 0; i < STAT_COUNT; i++)
+    {
+        std::snprintf(field, sizeof field, "\"%s\": %" PRIu64 ", ", STAT_NAMES[i], stats.counts[i]);
+        json += field;
+    }
+
+    for(const StatRate& rate : STAT_RATES)
+    {
+        std::snprintf(field, sizeof field, "\"%s\": %.4f, ", rate.name, Percent(stats[rate.part], stats[rate.whole]) / 100);
+        json += field;
+    }
+
+    json += STATS_ENABLED ? "\"enabled\": true}" : "\"enabled\": false}";
+    return json;
+}
@@ -0,0 +1,97 @@
+#ifndef CHEESENG_STATS_H
+#define CHEESENG_STATS_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Event counters for the search and the move generator. They only exist when the engine is built with
+// ENGINE_STATS (cmake -DENGINE_STATS=ON); otherwise STAT_INC / STAT_ADD compile to nothing.
+enum StatCounter
+{
+    STAT_NODES,
+    STAT_QNODES,
+    STAT_TT_PROBES,
+    STAT_TT_HITS,
+    STAT_TT_CUTOFFS,
+    STAT_BETA_CUTOFFS,
+    STAT_FIRST_MOVE_CUTOFFS,
+    STAT_NULL_MOVE_TRIES,
+    STAT_NULL_MOVE_CUTOFFS,
+    STAT_LMR_REDUCTIONS,
+    STAT_LMR_RESEARCHES,
+    STAT_PVS_RESEARCHES,
+    STAT_PAWN_PROBES,
+    STAT_PAWN_HITS,
+    STAT_EVAL_PROBES,
+    STAT_EVAL_HITS,
+    STAT_GEN_ALL,               // one per GenType, in its order
+    STAT_GEN_CAPTURES,
+    STAT_GEN_QUIETS,
+    STAT_POSITION_COPIES,
+    STAT_POSITION_ALLOCATIONS,
+    STAT_COUNT
+};
+
+struct StatsSnapshot
+{
+    uint64_t counts[STAT_COUNT];
+
+    uint64_t operator[](StatCounter counter) const { return counts[counter]; }
+};
+
+#ifdef ENGINE_STATS
+
+#define STATS_ENABLED true
+
+// Each thread counts into its own block, only the owner writes it. The atomics are for the
+// readers in CollectStats and cost a plain load and store here.
+struct ThreadStats
+{
+    std::atomic<uint64_t> counts[STAT_COUNT];
+
+    ThreadStats();
+    ~ThreadStats();
+
+    void add(StatCounter counter, uint64_t n)
+    {
+        counts[counter].store(counts[counter].load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+};
+
+extern thread_local ThreadStats threadStats;
+
+#define STAT_ADD(counter, n) threadStats.add(counter, n)
+#define STAT_INC(counter) threadStats.add(counter, 1)
+
+// A member of this type counts the copies of the object holding it
+template<StatCounter Counter>
+struct CopyCounter
+{
+    CopyCounter() {}
+    CopyCounter(const CopyCounter&) { STAT_INC(Counter); }
+    CopyCounter& operator=(const CopyCounter&) { STAT_INC(Counter); return *this; }
+};
+
+#else
+
+#define STATS_ENABLED false
+
+#define STAT_ADD(counter, n) ((void)0)
+#define STAT_INC(counter) ((void)0)
+
+#endif
+
+// Sum over the running threads and the ones that already finished. All zero without ENGINE_STATS.
+StatsSnapshot CollectStats();
+void ResetStats();
+
+const char *StatName(StatCounter counter);
+
+// One line for "info string": the counts that matter for tuning and the rates derived from them
+std::string StatsSummary(const StatsSnapshot& stats);
+
+// Every counter and rate as a JSON object
+std::string StatsJSON(const StatsSnapshot& stats);
+
+#endif //CHEESENG_STATS_H
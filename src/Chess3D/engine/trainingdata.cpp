@@ -0,0 +1,112 @@
+#include <cstring>
+
+#include "trainingdata.hpp"
+
+static const char TRAINING_MAGIC[8] = {'C', '3', 'D', 'T', 'R', 'A', 'I', 'N'};
+
+TrainingDataWriter::TrainingDataWriter() : file(nullptr), records(0) {}
+
+TrainingDataWriter::~TrainingDataWriter()
+{
+    close();
+}
+
+bool TrainingDataWriter::open(const std::string& path)
+{
+    close();
+
+    file = std::fopen(path.c_str(), "wb");
+    if(!file) return false;
+
+    // Counts stay zero until close(), a reader then takes them from the file size
+    TrainingHeader header = {};
+    std::memcpy(header.magic, TRAINING_MAGIC, sizeof header.magic);
+    header.version = TRAINING_VERSION;
+    header.recordSize = sizeof(TrainingRecord);
+    std::fwrite(&header, sizeof header, 1, file);
+
+    records = 0;
+    gameStarts.clear();
+
+    return true;
+}
+
+uint32_t TrainingDataWriter::addGame(std::vector<TrainingRecord>& gameRecords)
+{
+    const uint32_t game = static_cast<uint32_t>(gameStarts.size());
+
+    for(TrainingRecord& record : gameRecords) record.game = game;
+
+    gameStarts.push_back(records);
+    std::fwrite(gameRecords.data(), sizeof(TrainingRecord), gameRecords.size(), file);
+    records += gameRecords.size();
+
+    return game;
+}
+
+bool TrainingDataWriter::close()
+{
+    if(!file) return false;
+
+    TrainingHeader header;
+    std::memcpy(header.magic, TRAINING_MAGIC, sizeof header.magic);
+    header.version = TRAINING_VERSION;
+    header.recordSize = sizeof(TrainingRecord);
+    header.recordCount = records;
+    header.gameCount = gameStarts.size();
+    header.gameTable = sizeof header + records * sizeof(TrainingRecord);
+
+    std::fwrite(gameStarts.data(), sizeof(uint64_t), gameStarts.size(), file);
+    std::rewind(file);
+    std::fwrite(&header, sizeof header, 1, file);
+
+    bool ok = std::ferror(file) == 0;
+    std::fclose(file);
+    file = nullptr;
+
+    return ok;
+}
+
+bool TrainingData::open(const std::string& path)
+{
+    header = nullptr;
+    records = nullptr;
+    gameStarts = nullptr;
+    count = 0;
+
+    if(!file.open(path) || file.size() < sizeof(TrainingHeader)) return false;
+
+    const TrainingHeader *h = reinterpret_cast<const TrainingHeader *>(file.data());
+
+    if(std::memcmp(h->magic, TRAINING_MAGIC, sizeof h->magic) != 0 || h->version != TRAINING_VERSION ||
+       h->recordSize != sizeof(TrainingRecord))
+        return false;
+
+    const size_t available = (file.size() - sizeof(TrainingHeader)) / sizeof(TrainingRecord);
+
+    if(h->gameTable)
+    {
+        if(h->recordCount > available || h->gameTable + h->gameCount * sizeof(uint64_t) > file.size()) return false;
+
+        count = h->recordCount;
+        gameStarts = reinterpret_cast<const uint64_t *>(file.data() + h->gameTable);
+        header = h;
+    }
+    else
+    {
+        count = available;
+    }
+
+    records = reinterpret_cast<const TrainingRecord *>(file.data() + sizeof(TrainingHeader));
+
+    return true;
+}
+
+void TrainingData::game(size_t id, size_t& first, size_t& last) const
+{
+    first = last = 0;
+    if(id >= gameCount()) return;
+
+    first = gameStarts[id];
+    last = id + 1 < gameCount() ? gameStarts[id + 1] : count;
+}
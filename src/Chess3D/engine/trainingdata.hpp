@@ -0,0 +1,85 @@
+#ifndef CHEESENG_TRAININGDATA_H
+#define CHEESENG_TRAININGDATA_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "boardstate.hpp"
+#include "gamedb.hpp"
+#include "mappedfile.hpp"
+
+// Scored positions for evaluation training (<name>.train): a header, fixed size records in the order their
+// games finished, then the index of the first record of every game. Host byte order, like the game store.
+// Record i is at a fixed offset, so the file is read in place from a mapping without parsing. A file whose
+// writer never closed it still has whole records behind its header; they are readable, without the index.
+
+#define TRAINING_VERSION 1
+
+struct TrainingRecord
+{
+    BoardState state;
+    int16_t score;                  // search score for the side to move, centipawns
+    uint8_t result;                 // GameResult of the game the position is from
+    uint8_t reserved;               // zero
+    uint32_t game;                  // game number in the file
+};
+
+static_assert(sizeof(TrainingRecord) == 96, "TrainingRecord must stay compact and without padding");
+static_assert(std::is_trivially_copyable<TrainingRecord>::value, "TrainingRecord is stored in files");
+
+struct TrainingHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;            // sizeof(TrainingRecord)
+    uint64_t recordCount;           // 0 until the writer closes the file
+    uint64_t gameCount;
+    uint64_t gameTable;             // file offset of gameCount uint64_t first record numbers, 0 until closed
+};
+
+class TrainingDataWriter
+{
+public:
+    TrainingDataWriter();
+    ~TrainingDataWriter();
+
+    bool open(const std::string& path);
+
+    // Append the positions of one game, their game numbers are filled in. Returns the game number.
+    uint32_t addGame(std::vector<TrainingRecord>& records);
+
+    bool close();
+
+    uint64_t recordCount() const { return records; }
+    uint64_t gameCount() const { return gameStarts.size(); }
+
+private:
+    FILE *file;
+    uint64_t records;
+    std::vector<uint64_t> gameStarts;
+};
+
+class TrainingData
+{
+public:
+    bool open(const std::string& path);
+
+    size_t size() const { return count; }
+    const TrainingRecord& operator[](size_t i) const { return records[i]; }
+
+    // Games are only known in a closed file
+    size_t gameCount() const { return header ? header->gameCount : 0; }
+    void game(size_t id, size_t& first, size_t& last) const;
+
+private:
+    MappedFile file;
+    const TrainingHeader *header = nullptr;
+    const TrainingRecord *records = nullptr;
+    const uint64_t *gameStarts = nullptr;
+    size_t count = 0;
+};
+
+#endif //CHEESENG_TRAININGDATA_H
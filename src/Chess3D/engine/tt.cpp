@@ -0,0 +1,129 @@
+#include "tt.hpp"
+
+// A search older than the current one costs a slot this many plies of depth when choosing what to replace
+#define TT_AGE_PENALTY 8
+
+// data: move 16 | score 16 | eval 16 | depth 8 | bound 2 | generation 6
+static inline uint64_t PackEntry(PackedMove move, int score, int eval, int depth, TTBound bound, uint8_t generation)
+{
+    return static_cast<uint64_t>(move) |
+           static_cast<uint64_t>(static_cast<uint16_t>(score)) << 16 |
+           static_cast<uint64_t>(static_cast<uint16_t>(eval)) << 32 |
+           static_cast<uint64_t>(static_cast<uint8_t>(depth)) << 48 |
+           static_cast<uint64_t>(bound) << 56 |
+           static_cast<uint64_t>(generation) << 58;
+}
+
+static inline uint8_t EntryGeneration(uint64_t data)
+{
+    return static_cast<uint8_t>(data >> 58);
+}
+
+static inline TTEntry UnpackEntry(uint64_t data)
+{
+    TTEntry entry;
+
+    entry.move  = static_cast<PackedMove>(data);
+    entry.score = static_cast<int16_t>(data >> 16);
+    entry.eval  = static_cast<int16_t>(data >> 32);
+    entry.depth = static_cast<int8_t>(data >> 48);
+    entry.bound = static_cast<TTBound>((data >> 56) & 3);
+
+    return entry;
+}
+
+TranspositionTable::TranspositionTable(size_t megabytes) : bucketCount(0), generation(0)
+{
+    resize(megabytes);
+}
+
+void TranspositionTable::resize(size_t megabytes)
+{
+    size_t count = (megabytes ? megabytes : 1) * 1024 * 1024 / sizeof(Bucket);
+
+    if(count != bucketCount)
+    {
+        buckets.reset(new Bucket[count]);
+        bucketCount = count;
+    }
+
+    clear();
+}
+
+void TranspositionTable::clear()
+{
+    for(size_t i = 0; i < bucketCount; i++)
+        for(Slot& slot : buckets[i].slots)
+        {
+            slot.check.store(0, std::memory_order_relaxed);
+            slot.data.store(0, std::memory_order_relaxed);
+        }
+}
+
+bool TranspositionTable::probe(uint64_t key, TTEntry& out) const
+{
+    const Bucket& bucket = buckets[key % bucketCount];
+
+    for(const Slot& slot : bucket.slots)
+    {
+        const uint64_t data = slot.data.load(std::memory_order_relaxed);
+
+        if(data && (slot.check.load(std::memory_order_relaxed) ^ data) == key)
+        {
+            out = UnpackEntry(data);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void TranspositionTable::store(uint64_t key, PackedMove move, int score, int eval, int depth, TTBound bound)
+{
+    Bucket& bucket = buckets[key % bucketCount];
+    Slot *replace = &bucket.slots[0];
+    int replaceDepth = 1 << 20;
+
+    for(Slot& slot : bucket.slots)
+    {
+        const uint64_t data = slot.data.load(std::memory_order_relaxed);
+
+        // Same position: overwrite, but keep the old best move when the new result has none
+        if(data && (slot.check.load(std::memory_order_relaxed) ^ data) == key)
+        {
+            if(move == NULL_PACKED_MOVE) move = UnpackEntry(data).move;
+            replace = &slot;
+            break;
+        }
+
+        // Otherwise the shallowest entry makes room: empty slots first, then those left by earlier searches
+        const int age = (generation - EntryGeneration(data)) & TT_GENERATION_MASK;
+        const int slotDepth = data ? UnpackEntry(data).depth - age * TT_AGE_PENALTY : -(1 << 10);
+
+        if(slotDepth < replaceDepth)
+        {
+            replace = &slot;
+            replaceDepth = slotDepth;
+        }
+    }
+
+    const uint64_t data = PackEntry(move, score, eval, depth, bound, generation);
+
+    replace->check.store(key ^ data, std::memory_order_relaxed);
+    replace->data.store(data, std::memory_order_relaxed);
+}
+
+int TranspositionTable::hashfull() const
+{
+    const size_t sample = bucketCount < 250 ? bucketCount : 250;
+    int used = 0;
+
+    for(size_t i = 0; i < sample; i++)
+        for(const Slot& slot : buckets[i].slots)
+        {
+            const uint64_t data = slot.data.load(std::memory_order_relaxed);
+            if(data && EntryGeneration(data) == generation) used++;
+        }
+
+    return sample ? static_cast<int>(used * 1000 / (sample * 4)) : 0;
+}
@@ -0,0 +1,64 @@
+#ifndef CHEESENG_TT_H
+#define CHEESENG_TT_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "move.hpp"
+
+enum TTBound{BOUND_NONE, BOUND_UPPER, BOUND_LOWER, BOUND_EXACT};
+
+// Generations wrap around after 64 searches
+#define TT_GENERATION_MASK 63
+
+struct TTEntry
+{
+    PackedMove move;
+    int score;
+    int eval;
+    int depth;
+    TTBound bound;
+};
+
+// Shared hash table of search results. Each slot stores its key xor'ed with its data, so a slot torn by
+// two threads writing at once fails the key check instead of returning a mix of two positions.
+// Entries carry the generation of the search that stored them: the table is kept from move to move and
+// entries of earlier searches are the first to be replaced, however deep.
+class TranspositionTable
+{
+public:
+    explicit TranspositionTable(size_t megabytes=16);
+
+    void resize(size_t megabytes);
+    void clear();
+
+    // Start a new generation, between two searches (a new move to play, not a ponderhit)
+    void newSearch() { generation = (generation + 1) & TT_GENERATION_MASK; }
+
+    bool probe(uint64_t key, TTEntry& out) const;
+    void store(uint64_t key, PackedMove move, int score, int eval, int depth, TTBound bound);
+
+    // Slots of the current generation in a sample of the table, per mille (the UCI hashfull value)
+    int hashfull() const;
+
+private:
+    struct Slot
+    {
+        std::atomic<uint64_t> check;    // key ^ data
+        std::atomic<uint64_t> data;
+    };
+
+    // Four slots fill a 64 byte cache line
+    struct Bucket
+    {
+        Slot slots[4];
+    };
+
+    std::unique_ptr<Bucket[]> buckets;
+    size_t bucketCount;
+    uint8_t generation;
+};
+
+#endif //CHEESENG_TT_H
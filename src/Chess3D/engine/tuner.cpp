@@ -0,0 +1,440 @@
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+#include "bitboard.hpp"
+#include "epd.hpp"
+#include "evaltables.hpp"
+#include "evaluate.hpp"
+#include "trainingdata.hpp"
+#include "tuner.hpp"
+
+// Lines read before they are parsed on the threads
+#define TUNE_LOAD_BLOCK 65536
+
+#define ADAM_BETA1 0.9
+#define ADAM_BETA2 0.999
+#define ADAM_EPSILON 1e-8
+
+static const char *PIECE_NAMES[6] = {"pawn", "knight", "bishop", "rook", "queen", "king"};
+
+// Call work(thread, begin, end) on threads contiguous slices of [0, count)
+template<typename Work>
+static void RunParallel(int threads, size_t count, const Work& work)
+{
+    std::vector<std::thread> pool;
+
+    for(int t = 1; t < threads; t++)
+        pool.emplace_back([&work, t, threads, count]() { work(t, count * t / threads, count * (t + 1) / threads); });
+
+    work(0, 0, count / threads);
+
+    for(std::thread& thread : pool) thread.join();
+}
+
+// Half points for white from a word like "1-0", "[0.5]" or "0.0"
+static bool ParseResult(std::string word, uint8_t& result)
+{
+    while(!word.empty() && (word.back() == ';' || word.back() == ']' || word.back() == '"')) word.pop_back();
+    while(!word.empty() && (word.front() == '[' || word.front() == '"')) word.erase(0, 1);
+
+    if(word == "1-0" || word == "1.0" || word == "1")                   result = 2;
+    else if(word == "1/2-1/2" || word == "0.5" || word == "1/2")        result = 1;
+    else if(word == "0-1" || word == "0.0" || word == "0")              result = 0;
+    else return false;
+
+    return true;
+}
+
+Tuner::Tuner(int threads) : threads(threads > 0 ? threads : 1), k(1.0), steps(0)
+{
+    for(int type = PAWN; type <= KING; type++)
+    {
+        weights[type] = MG_VALUE[type];
+        weights[TUNE_EG_OFFSET + type] = EG_VALUE[type];
+
+        for(int square = 0; square < 64; square++)
+        {
+            weights[TUNE_PST_OFFSET + type * 64 + square] = MG_PST[type][square];
+            weights[TUNE_EG_OFFSET + TUNE_PST_OFFSET + type * 64 + square] = EG_PST[type][square];
+        }
+    }
+
+    for(int term = 0; term < TERM_COUNT; term++)
+    {
+        weights[TUNE_TERM_OFFSET + term] = MG_TERMS[term];
+        weights[TUNE_EG_OFFSET + TUNE_TERM_OFFSET + term] = EG_TERMS[term];
+    }
+
+    for(int i = 0; i < TUNE_PARAMS; i++) momentum[i] = velocity[i] = 0;
+}
+
+void Tuner::addSample(const Position& pos, uint8_t result, std::vector<Sample>& samples, std::vector<uint16_t>& features)
+{
+    Sample sample;
+    sample.first = static_cast<uint32_t>(features.size());
+    sample.phase = static_cast<uint8_t>(GamePhase(pos));
+    sample.result = result;
+
+    for(int color = WHITE; color <= BLACK; color++)
+    {
+        for(int type = PAWN; type <= KING; type++)
+        {
+            for(Bitboard b = pos.pieces[color][type]; b; )
+            {
+                const int square = PopLowestSquare(b) ^ (color == WHITE ? 0 : 56);
+                features.push_back(static_cast<uint16_t>((type * 64 + square) | (color == WHITE ? 0 : BLACK_FEATURE)));
+            }
+        }
+    }
+
+    int counts[TERM_COUNT];
+    EvalTermCounts(pos, counts);
+
+    for(int term = 0; term < TERM_COUNT; term++)
+        for(int n = 0; n < std::abs(counts[term]); n++)
+            features.push_back(static_cast<uint16_t>((TERM_FEATURE + term) | (counts[term] > 0 ? 0 : BLACK_FEATURE)));
+
+    sample.count = static_cast<uint16_t>(features.size() - sample.first);
+    samples.push_back(sample);
+}
+
+// Add positions parsed on a thread, their offsets relative to their own features
+bool Tuner::append(const std::vector<Sample>& parsedSamples, const std::vector<uint16_t>& parsedFeatures)
+{
+    // Offsets are 32 bits, enough for about 130 million positions
+    if(features.size() + parsedFeatures.size() > UINT32_MAX) return false;
+
+    const uint32_t offset = static_cast<uint32_t>(features.size());
+
+    for(Sample sample : parsedSamples)
+    {
+        sample.first += offset;
+        samples.push_back(sample);
+    }
+
+    features.insert(features.end(), parsedFeatures.begin(), parsedFeatures.end());
+
+    return true;
+}
+
+size_t Tuner::load(std::istream& in, size_t *skipped)
+{
+    struct Parsed
+    {
+        std::vector<Sample> samples;
+        std::vector<uint16_t> features;
+        size_t skipped;
+    };
+
+    const size_t before = samples.size();
+    size_t bad = 0;
+
+    std::vector<std::string> lines;
+    std::vector<Parsed> parsed(threads);
+
+    for(bool more = true; more; )
+    {
+        lines.clear();
+
+        for(std::string line; lines.size() < TUNE_LOAD_BLOCK && (more = static_cast<bool>(std::getline(in, line))); )
+            if(line.find_first_not_of(" \t\r") != std::string::npos) lines.push_back(std::move(line));
+
+        RunParallel(threads, lines.size(), [&](int t, size_t begin, size_t end)
+        {
+            Parsed& out = parsed[t];
+            out.samples.clear();
+            out.features.clear();
+            out.skipped = 0;
+
+            for(size_t i = begin; i < end; i++)
+            {
+                EpdRecord record;
+                Sample sample;
+                std::string result;
+
+                if(!ParseEpdLine(lines[i], record))
+                {
+                    out.skipped++;
+                    continue;
+                }
+
+                if((result = EpdOperation(record, "c9")).empty())
+                {
+                    const size_t last = record.operations.find_last_of(" \t");
+                    result = last == std::string::npos ? record.operations : record.operations.substr(last + 1);
+                }
+
+                if(!ParseResult(result, sample.result))
+                {
+                    out.skipped++;
+                    continue;
+                }
+
+                addSample(Position(record.fen), sample.result, out.samples, out.features);
+            }
+        });
+
+        for(Parsed& out : parsed)
+        {
+            bad += out.skipped;
+            if(!append(out.samples, out.features)) bad += out.samples.size();
+        }
+    }
+
+    if(skipped) *skipped = bad;
+
+    return samples.size() - before;
+}
+
+size_t Tuner::load(const TrainingData& data)
+{
+    std::vector<std::vector<Sample>> parsedSamples(threads);
+    std::vector<std::vector<uint16_t>> parsedFeatures(threads);
+
+    RunParallel(threads, data.size(), [&](int t, size_t begin, size_t end)
+    {
+        for(size_t i = begin; i < end; i++)
+        {
+            const GameResult result = static_cast<GameResult>(data[i].result);
+            if(result == RESULT_UNKNOWN) continue;
+
+            const uint8_t halves = result == RESULT_WHITE_WINS ? 2 : result == RESULT_DRAW ? 1 : 0;
+            addSample(Position(data[i].state), halves, parsedSamples[t], parsedFeatures[t]);
+        }
+    });
+
+    const size_t before = samples.size();
+    for(int t = 0; t < threads; t++) append(parsedSamples[t], parsedFeatures[t]);
+
+    return samples.size() - before;
+}
+
+double Tuner::evaluate(const Sample& sample) const
+{
+    double mg = 0, eg = 0;
+
+    for(uint32_t i = sample.first; i < sample.first + sample.count; i++)
+    {
+        const uint16_t feature = features[i];
+        const int index = feature & ~BLACK_FEATURE, type = index >> 6;
+        const double sign = feature & BLACK_FEATURE ? -1 : 1;
+
+        // Terms follow the tables in both the features and the weights, so index serves for both
+        if(index < TERM_FEATURE)
+        {
+            mg += sign * weights[type];
+            eg += sign * weights[TUNE_EG_OFFSET + type];
+        }
+
+        mg += sign * weights[TUNE_PST_OFFSET + index];
+        eg += sign * weights[TUNE_EG_OFFSET + TUNE_PST_OFFSET + index];
+    }
+
+    return (mg * sample.phase + eg * (MAX_PHASE - sample.phase)) / MAX_PHASE;
+}
+
+// Mean squared error; with a gradient array, its derivative by every weight as well
+double Tuner::lossAndGradient(double *gradient) const
+{
+    const double slope = std::log(10.0) * k / 400;
+
+    std::vector<double> partialLoss(threads, 0);
+    std::vector<std::vector<double>> partialGradient(gradient ? threads : 0, std::vector<double>(TUNE_PARAMS, 0));
+
+    RunParallel(threads, samples.size(), [&](int t, size_t begin, size_t end)
+    {
+        double loss = 0;
+        double *sums = gradient ? partialGradient[t].data() : nullptr;
+
+        for(size_t i = begin; i < end; i++)
+        {
+            const Sample& sample = samples[i];
+            const double expected = 1 / (1 + std::exp(-slope * evaluate(sample)));
+            const double error = expected - sample.result * 0.5;
+
+            loss += error * error;
+
+            if(!sums) continue;
+
+            // d(error^2)/d(eval), split between the middlegame and endgame weights by the phase
+            const double d = 2 * error * expected * (1 - expected) * slope;
+            const double mg = d * sample.phase / MAX_PHASE, eg = d * (MAX_PHASE - sample.phase) / MAX_PHASE;
+
+            for(uint32_t f = sample.first; f < sample.first + sample.count; f++)
+            {
+                const uint16_t feature = features[f];
+                const int index = feature & ~BLACK_FEATURE, type = index >> 6;
+                const double sign = feature & BLACK_FEATURE ? -1 : 1;
+
+                if(index < TERM_FEATURE)
+                {
+                    sums[type] += sign * mg;
+                    sums[TUNE_EG_OFFSET + type] += sign * eg;
+                }
+
+                sums[TUNE_PST_OFFSET + index] += sign * mg;
+                sums[TUNE_EG_OFFSET + TUNE_PST_OFFSET + index] += sign * eg;
+            }
+        }
+
+        partialLoss[t] = loss;
+    });
+
+    const double count = samples.empty() ? 1 : static_cast<double>(samples.size());
+    double loss = 0;
+
+    for(int t = 0; t < threads; t++) loss += partialLoss[t];
+
+    if(gradient)
+    {
+        for(int i = 0; i < TUNE_PARAMS; i++)
+        {
+            gradient[i] = 0;
+            for(int t = 0; t < threads; t++) gradient[i] += partialGradient[t][i];
+            gradient[i] /= count;
+        }
+    }
+
+    return loss / count;
+}
+
+double Tuner::loss() const
+{
+    return lossAndGradient(nullptr);
+}
+
+// Golden section search; the loss is unimodal in K
+double Tuner::fitScale()
+{
+    const double ratio = (std::sqrt(5.0) - 1) / 2;
+    double low = 0.1, high = 4.0;
+
+    double a = high - ratio * (high - low), b = low + ratio * (high - low);
+    k = a;
+    double lossA = loss();
+    k = b;
+    double lossB = loss();
+
+    for(int i = 0; i < 30; i++)
+    {
+        if(lossA < lossB)
+        {
+            high = b;
+            b = a;
+            lossB = lossA;
+            a = high - ratio * (high - low);
+            k = a;
+            lossA = loss();
+        }
+        else
+        {
+            low = a;
+            a = b;
+            lossA = lossB;
+            b = low + ratio * (high - low);
+            k = b;
+            lossB = loss();
+        }
+    }
+
+    k = (low + high) / 2;
+    return k;
+}
+
+double Tuner::step(double learningRate)
+{
+    double gradient[TUNE_PARAMS];
+    const double loss = lossAndGradient(gradient);
+
+    steps++;
+    const double correction1 = 1 - std::pow(ADAM_BETA1, steps), correction2 = 1 - std::pow(ADAM_BETA2, steps);
+
+    for(int i = 0; i < TUNE_PARAMS; i++)
+    {
+        momentum[i] = ADAM_BETA1 * momentum[i] + (1 - ADAM_BETA1) * gradient[i];
+        velocity[i] = ADAM_BETA2 * velocity[i] + (1 - ADAM_BETA2) * gradient[i] * gradient[i];
+
+        weights[i] -= learningRate * (momentum[i] / correction1) / (std::sqrt(velocity[i] / correction2) + ADAM_EPSILON);
+    }
+
+    return loss;
+}
+
+void Tuner::writeTables(std::ostream& out) const
+{
+    char text[64];
+
+    out << "#ifndef CHEESENG_EVALTABLES_H\n#define CHEESENG_EVALTABLES_H\n\n#include \"evaluate.hpp\"\n\n";
+    out << "// Evaluation weights, included by evaluate.cpp and by the tuner as its starting point.\n";
+    std::snprintf(text, sizeof text, "%zu positions, K %.4f, loss %.6f.\n", samples.size(), k, loss());
+    out << "// Written by the tune tool from " << text << "\n";
+
+    const char *names[2] = {"MG", "EG"};
+
+    for(int stage = 0; stage < 2; stage++)
+    {
+        const double *stageWeights = weights + stage * TUNE_EG_OFFSET;
+
+        out << "static const int " << names[stage] << "_VALUE[6] = {";
+        for(int type = PAWN; type <= KING; type++)
+            out << (type ? ", " : "") << std::lround(stageWeights[type]);
+        out << "};\n";
+    }
+
+    out << "\n// Piece square tables from white's point of view, a1 = 0 ... h8 = 63 (rank 1 first).\n";
+
+    for(int stage = 0; stage < 2; stage++)
+    {
+        const double *table = weights + stage * TUNE_EG_OFFSET + TUNE_PST_OFFSET;
+
+        out << "static const int " << names[stage] << "_PST[6][64] =\n{\n";
+
+        for(int type = PAWN; type <= KING; type++)
+        {
+            out << "    { // " << PIECE_NAMES[type] << "\n";
+
+            for(int rank = 0; rank < 8; rank++)
+            {
+                out << "       ";
+
+                for(int file = 0; file < 8; file++)
+                {
+                    std::snprintf(text, sizeof text, file ? ", %3ld" : "%4ld", std::lround(table[type * 64 + rank * 8 + file]));
+                    out << text;
+                }
+
+                out << ",\n";
+            }
+
+            out << "    },\n";
+        }
+
+        out << "};\n" << (stage ? "" : "\n");
+    }
+
+    out << "\n// Pawn structure, mobility, king safety and threats, by EvalTerm\n";
+
+    for(int stage = 0; stage < 2; stage++)
+    {
+        const double *terms = weights + stage * TUNE_EG_OFFSET + TUNE_TERM_OFFSET;
+
+        out << "static const int " << names[stage] << "_TERMS[TERM_COUNT] =\n{\n    ";
+
+        for(int term = 0; term < TERM_COUNT; term++)
+        {
+            // A line per group of the enum: pawn weaknesses, passed pawns by rank, free passed pawns,
+            // mobility, king attacks, threats, space
+            const bool group = term == TERM_PASSED_PAWN || term == TERM_FREE_PASSED_PAWN || term == TERM_MOBILITY ||
+                               term == TERM_KING_ATTACK || term == TERM_PAWN_THREAT || term == TERM_SPACE;
+            const char *separator = group ? ",\n    " : term ? ", " : "";
+            out << separator << std::lround(terms[term]);
+        }
+
+        out << ",\n};\n" << (stage ? "" : "\n");
+    }
+
+    out << "\n#endif //CHEESENG_EVALTABLES_H\n";
+}
@@ -0,0 +1,84 @@
+#ifndef CHEESENG_TUNER_H
+#define CHEESENG_TUNER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+#include "evaluate.hpp"
+#include "position.hpp"
+
+class TrainingData;
+
+// Tuned weights: the piece values, piece square tables and other terms of evaltables.hpp, middlegame then endgame
+#define TUNE_PST_OFFSET 6
+#define TUNE_TERM_OFFSET (TUNE_PST_OFFSET + 6 * 64)
+#define TUNE_EG_OFFSET (TUNE_TERM_OFFSET + TERM_COUNT)
+#define TUNE_PARAMS (2 * TUNE_EG_OFFSET)
+
+// Texel tuning of the evaluation: minimise the squared error between the game results of a set of positions
+// and the evaluations mapped to an expected score by 1 / (1 + 10^(-K * eval / 400)).
+//
+// The evaluation is linear in its weights, so every position is kept as a list of its pieces and terms and the
+// whole set fits in memory as two flat arrays, about 100 bytes per position. Loss and gradient are summed over
+// all the positions on every step, on the given number of threads, and the weights move by Adam.
+class Tuner
+{
+public:
+    explicit Tuner(int threads=1);
+
+    // Read labelled EPD lines: the result is taken from a c9 operation ("1-0", "0-1", "1/2-1/2") or from
+    // the last word of the line ("[1.0]", "0.5", "1/2-1/2", ...), from white's point of view.
+    // Returns the number of positions added; lines without a readable position or result are skipped.
+    size_t load(std::istream& in, size_t *skipped=nullptr);
+
+    // Positions written by self-play, labelled with the results of their games
+    size_t load(const TrainingData& data);
+
+    size_t size() const { return samples.size(); }
+
+    // The K that best fits the current weights, kept for the following steps
+    double fitScale();
+    double scale() const { return k; }
+
+    double loss() const;
+
+    // One Adam step on the whole set, returns the loss before it
+    double step(double learningRate);
+
+    // The weights as a replacement for evaltables.hpp
+    void writeTables(std::ostream& out) const;
+
+private:
+    // A piece is stored as type * 64 + square from white's side, with this bit set for black. A term is
+    // TERM_FEATURE + EvalTerm, repeated as often as it counts, with the bit set for black's.
+    static const uint16_t BLACK_FEATURE = 0x8000;
+    static const uint16_t TERM_FEATURE = 6 * 64;
+
+    struct Sample
+    {
+        uint32_t first;             // index of its first feature in features
+        uint16_t count;
+        uint8_t phase;              // GamePhase, 0 ... MAX_PHASE
+        uint8_t result;             // half points for white: 0, 1 or 2
+    };
+
+    static void addSample(const Position& pos, uint8_t result, std::vector<Sample>& samples, std::vector<uint16_t>& features);
+    bool append(const std::vector<Sample>& parsedSamples, const std::vector<uint16_t>& parsedFeatures);
+
+    double evaluate(const Sample& sample) const;
+    double lossAndGradient(double *gradient) const;
+
+    int threads;
+    std::vector<Sample> samples;
+    std::vector<uint16_t> features;
+
+    double k;
+    double weights[TUNE_PARAMS];
+    double momentum[TUNE_PARAMS], velocity[TUNE_PARAMS];
+    int steps;
+};
+
+#endif //CHEESENG_TUNER_H
@@ -0,0 +1,340 @@
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "uciprocess.hpp"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// Time a process is given to exit after "quit"
+#define QUIT_TIMEOUT_MS 1000
+
+static int64_t NowMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+UciProcess::~UciProcess()
+{
+    stop();
+}
+
+bool UciProcess::waitFor(const std::string& prefix, int64_t timeoutMs, std::string *line)
+{
+    const int64_t deadline = NowMs() + timeoutMs;
+    std::string text;
+
+    while(readLine(text, timeoutMs < 0 ? -1 : std::max<int64_t>(0, deadline - NowMs())))
+    {
+        if(text.compare(0, prefix.size(), prefix) != 0 || (text.size() > prefix.size() && text[prefix.size()] != ' '))
+            continue;
+
+        if(line) *line = text;
+        return true;
+    }
+
+    return false;
+}
+
+// Take a whole line from the front of the buffer
+static bool TakeLine(std::string& buffer, std::string& line)
+{
+    const size_t end = buffer.find('\n');
+    if(end == std::string::npos) return false;
+
+    line = buffer.substr(0, end);
+    buffer.erase(0, end + 1);
+
+    if(!line.empty() && line.back() == '\r') line.pop_back();
+
+    return true;
+}
+
+#ifdef _WIN32
+
+UciProcess::UciProcess() : process_(nullptr), input_(nullptr), output_(nullptr) {}
+
+bool UciProcess::start(const std::string& command)
+{
+    stop();
+
+    SECURITY_ATTRIBUTES inherit = {sizeof(SECURITY_ATTRIBUTES), nullptr, TRUE};
+    HANDLE childInput, childOutput, input, output;
+
+    if(!CreatePipe(&childInput, &input, &inherit, 0)) return false;
+
+    if(!CreatePipe(&output, &childOutput, &inherit, 0))
+    {
+        CloseHandle(childInput);
+        CloseHandle(input);
+        return false;
+    }
+
+    // Only the child's ends are inherited
+    SetHandleInformation(input, HANDLE_FLAG_INHERIT, 0);
+    SetHandleInformation(output, HANDLE_FLAG_INHERIT, 0);
+
+    STARTUPINFOA startup = {};
+    startup.cb = sizeof startup;
+    startup.dwFlags = STARTF_USESTDHANDLES;
+    startup.hStdInput = childInput;
+    startup.hStdOutput = childOutput;
+    startup.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+
+    PROCESS_INFORMATION info = {};
+    std::vector<char> commandLine(command.begin(), command.end());
+    commandLine.push_back('\0');
+
+    const BOOL created = CreateProcessA(nullptr, commandLine.data(), nullptr, nullptr, TRUE, 0, nullptr, nullptr, &startup, &info);
+
+    CloseHandle(childInput);
+    CloseHandle(childOutput);
+
+    input_ = input;
+    output_ = output;
+
+    if(!created)
+    {
+        closePipes();
+        return false;
+    }
+
+    CloseHandle(info.hThread);
+    process_ = info.hProcess;
+    buffer_.clear();
+
+    return true;
+}
+
+void UciProcess::closePipes()
+{
+    if(input_) CloseHandle(input_);
+    if(output_) CloseHandle(output_);
+
+    input_ = output_ = nullptr;
+}
+
+void UciProcess::stop()
+{
+    if(process_)
+    {
+        send("quit");
+
+        if(WaitForSingleObject(process_, QUIT_TIMEOUT_MS) != WAIT_OBJECT_0) TerminateProcess(process_, 1);
+
+        WaitForSingleObject(process_, INFINITE);
+        CloseHandle(process_);
+        process_ = nullptr;
+    }
+
+    closePipes();
+}
+
+bool UciProcess::running()
+{
+    return process_ && WaitForSingleObject(process_, 0) == WAIT_TIMEOUT;
+}
+
+bool UciProcess::send(const std::string& line)
+{
+    if(!input_) return false;
+
+    const std::string text = line + "\n";
+    DWORD written;
+
+    return WriteFile(input_, text.data(), static_cast<DWORD>(text.size()), &written, nullptr) && written == text.size();
+}
+
+// Anonymous pipes cannot be waited on, so the pipe is polled every millisecond
+bool UciProcess::readLine(std::string& line, int64_t timeoutMs)
+{
+    const int64_t deadline = NowMs() + timeoutMs;
+
+    while(!TakeLine(buffer_, line))
+    {
+        DWORD available = 0;
+        if(!output_ || !PeekNamedPipe(output_, nullptr, 0, nullptr, &available, nullptr)) return false;
+
+        if(available == 0)
+        {
+            if(timeoutMs >= 0 && NowMs() >= deadline) return false;
+
+            Sleep(1);
+            continue;
+        }
+
+        char chunk[4096];
+        DWORD count;
+
+        if(!ReadFile(output_, chunk, std::min<DWORD>(available, sizeof chunk), &count, nullptr) || count == 0) return false;
+
+        buffer_.append(chunk, count);
+    }
+
+    return true;
+}
+
+#else
+
+UciProcess::UciProcess() : pid_(-1), input_(-1), output_(-1) {}
+
+bool UciProcess::start(const std::string& command)
+{
+    stop();
+
+    std::istringstream words(command);
+    std::vector<std::string> args;
+    for(std::string word; words >> word; ) args.push_back(word);
+
+    if(args.empty()) return false;
+
+    // Prepared before the fork, the child only calls async-signal-safe functions
+    std::vector<char *> argv;
+    for(std::string& arg : args) argv.push_back(&arg[0]);
+    argv.push_back(nullptr);
+
+    // Engines started on other threads must not inherit these pipes, or a pipe stays open after its
+    // engine exits. Close-on-exec is set under a lock so no fork can come between pipe and fcntl.
+    static std::mutex startMutex;
+    std::lock_guard<std::mutex> lock(startMutex);
+
+    int toChild[2], fromChild[2];
+    if(pipe(toChild) != 0) return false;
+
+    if(pipe(fromChild) != 0)
+    {
+        close(toChild[0]);
+        close(toChild[1]);
+        return false;
+    }
+
+    for(int fd : {toChild[0], toChild[1], fromChild[0], fromChild[1]}) fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    // A write to an engine that exited fails with EPIPE instead of ending the program
+    std::signal(SIGPIPE, SIG_IGN);
+
+    pid_ = fork();
+
+    if(pid_ == 0)
+    {
+        dup2(toChild[0], STDIN_FILENO);
+        dup2(fromChild[1], STDOUT_FILENO);
+
+        close(toChild[0]);
+        close(toChild[1]);
+        close(fromChild[0]);
+        close(fromChild[1]);
+
+        execvp(argv[0], argv.data());
+        _exit(127);
+    }
+
+    close(toChild[0]);
+    close(fromChild[1]);
+
+    input_ = toChild[1];
+    output_ = fromChild[0];
+    buffer_.clear();
+
+    if(pid_ < 0)
+    {
+        closePipes();
+        return false;
+    }
+
+    return true;
+}
+
+void UciProcess::closePipes()
+{
+    if(input_ >= 0) close(input_);
+    if(output_ >= 0) close(output_);
+
+    input_ = output_ = -1;
+}
+
+void UciProcess::stop()
+{
+    if(pid_ > 0)
+    {
+        send("quit");
+
+        const int64_t deadline = NowMs() + QUIT_TIMEOUT_MS;
+        int status;
+
+        while(waitpid(pid_, &status, WNOHANG) == 0)
+        {
+            if(NowMs() >= deadline)
+            {
+                kill(pid_, SIGKILL);
+                waitpid(pid_, &status, 0);
+                break;
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    }
+
+    pid_ = -1;
+    closePipes();
+}
+
+bool UciProcess::running()
+{
+    int status;
+    return pid_ > 0 && waitpid(pid_, &status, WNOHANG) == 0;
+}
+
+bool UciProcess::send(const std::string& line)
+{
+    if(input_ < 0) return false;
+
+    const std::string text = line + "\n";
+
+    for(size_t done = 0; done < text.size(); )
+    {
+        const ssize_t count = write(input_, text.data() + done, text.size() - done);
+        if(count <= 0) return false;
+
+        done += count;
+    }
+
+    return true;
+}
+
+bool UciProcess::readLine(std::string& line, int64_t timeoutMs)
+{
+    const int64_t deadline = NowMs() + timeoutMs;
+
+    while(!TakeLine(buffer_, line))
+    {
+        if(output_ < 0) return false;
+
+        const int64_t wait = timeoutMs < 0 ? -1 : std::max<int64_t>(0, deadline - NowMs());
+
+        pollfd fd = {output_, POLLIN, 0};
+        if(poll(&fd, 1, static_cast<int>(wait)) <= 0) return false;
+
+        char chunk[4096];
+        const ssize_t count = read(output_, chunk, sizeof chunk);
+        if(count <= 0) return false;
+
+        buffer_.append(chunk, count);
+    }
+
+    return true;
+}
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef CHEESENG_UCIPROCESS_H
+#define CHEESENG_UCIPROCESS_H
+
+#include <cstdint>
+#include <string>
+
+// A chess engine running as a child process, spoken to line by line over its standard input and output
+class UciProcess
+{
+public:
+    UciProcess();
+    ~UciProcess();
+
+    UciProcess(const UciProcess&) = delete;
+    UciProcess& operator=(const UciProcess&) = delete;
+
+    // command is split at spaces into the program and its arguments
+    bool start(const std::string& command);
+
+    // "quit", and the process is killed when it has not exited a second later
+    void stop();
+
+    bool running();
+
+    bool send(const std::string& line);
+
+    // The next line of output without its line end. False when timeoutMs (< 0: none) passes first
+    // or when the engine closed its output.
+    bool readLine(std::string& line, int64_t timeoutMs);
+
+    // Skip lines until one starts with the word prefix, within timeoutMs in all
+    bool waitFor(const std::string& prefix, int64_t timeoutMs, std::string *line=nullptr);
+
+private:
+    void closePipes();
+
+    std::string buffer_;
+
+#ifdef _WIN32
+    void *process_;
+    void *input_;
+    void *output_;
+#else
+    int pid_;
+    int input_;
+    int output_;
+#endif
+};
+
+#endif //CHEESENG_UCIPROCESS_H
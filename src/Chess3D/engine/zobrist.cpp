@@ -0,0 +1,41 @@
+#include "zobrist.hpp"
+
+// xorshift64*, only used to fill the key tables
+static uint64_t NextKey(uint64_t& state)
+{
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+
+    return state * 0x2545F4914F6CDD1DULL;
+}
+
+static ZobristKeys GenerateKeys()
+{
+    ZobristKeys keys;
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+
+    for(int color = 0; color < 2; color++)
+        for(int type = 0; type < 6; type++)
+            for(int sq = 0; sq < 64; sq++)
+                keys.pieces[color][type][sq] = NextKey(state);
+
+    for(int color = 0; color < 2; color++)
+        for(int side = 0; side < 2; side++)
+            keys.castling[color][side] = NextKey(state);
+
+    for(int file = 0; file < 8; file++)
+        keys.enPassantFile[file] = NextKey(state);
+
+    keys.blackToMove = NextKey(state);
+
+    return keys;
+}
+
+const ZobristKeys& Zobrist()
+{
+    // Function local so positions constructed during static initialization get valid keys
+    static const ZobristKeys keys = GenerateKeys();
+
+    return keys;
+}
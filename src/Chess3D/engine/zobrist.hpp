@@ -0,0 +1,25 @@
+#ifndef CHEESENG_ZOBRIST_H
+#define CHEESENG_ZOBRIST_H
+
+#include <cstdint>
+
+#include "coord.hpp"
+#include "piecetypes.hpp"
+
+struct ZobristKeys
+{
+    uint64_t pieces[2][6][64];   // [color][type][square]
+    uint64_t castling[2][2];     // [color][SHORT_CASTLE / LONG_CASTLE]
+    uint64_t enPassantFile[8];
+    uint64_t blackToMove;
+};
+
+// The keys are generated once from a fixed seed, so hashes are stable between runs and builds
+const ZobristKeys& Zobrist();
+
+inline uint64_t ZobristPiece(Piece piece, Coord coord)
+{
+    return piece.type == NO_PIECE ? 0 : Zobrist().pieces[piece.color][piece.type][SquareIndex(coord)];
+}
+
+#endif //CHEESENG_ZOBRIST_H
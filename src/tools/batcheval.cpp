@@ -0,0 +1,133 @@
+// Evaluate or search every position of an EPD file on a thread pool.
+//
+// usage: batcheval <file.epd> <eval | depth N | nodes N> [threads] [--shared] [--hash MB]
+//
+// One line per position is printed in file order as soon as it and every position before it are done:
+// the id (or line number), the score for the side to move, the best move for a search, and the FEN.
+// --shared makes the threads use one transposition table instead of one each, cleared before every position.
+// --hash sets the table size; by default a shared table has 16 MB and a table per thread is sized to the job.
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "engine/batch.hpp"
+#include "engine/epd.hpp"
+#include "engine/search.hpp"
+
+static void Usage(const char *program)
+{
+    std::fprintf(stderr, "usage: %s <file.epd> <eval | depth N | nodes N> [threads] [--shared] [--hash MB]\n", program);
+}
+
+int main(int argc, char **argv)
+{
+    if(argc < 3)
+    {
+        Usage(argv[0]);
+        return 2;
+    }
+
+    BatchJob job;
+    int arg = 2;
+
+    if(!std::strcmp(argv[arg], "eval"))
+    {
+        job.type = BATCH_STATIC_EVAL;
+        arg++;
+    }
+    else if(!std::strcmp(argv[arg], "depth") && arg + 1 < argc)
+    {
+        job.type = BATCH_DEPTH;
+        job.depth = std::atoi(argv[arg + 1]);
+        arg += 2;
+    }
+    else if(!std::strcmp(argv[arg], "nodes") && arg + 1 < argc)
+    {
+        job.type = BATCH_NODES;
+        job.nodes = std::strtoull(argv[arg + 1], nullptr, 10);
+        arg += 2;
+    }
+    else
+    {
+        Usage(argv[0]);
+        return 2;
+    }
+
+    job.threads = static_cast<int>(std::thread::hardware_concurrency());
+
+    for(; arg < argc; arg++)
+    {
+        if(!std::strcmp(argv[arg], "--shared"))
+            job.sharedTable = true;
+        else if(!std::strcmp(argv[arg], "--hash") && arg + 1 < argc)
+            job.tableMB = std::strtoull(argv[++arg], nullptr, 10);
+        else
+            job.threads = std::atoi(argv[arg]);
+    }
+
+    if(job.threads < 1) job.threads = 1;
+    if(job.depth < 1 || job.depth >= MAX_PLY) job.depth = 1;
+
+    std::ifstream file(argv[1]);
+    if(!file)
+    {
+        std::fprintf(stderr, "%s: cannot open\n", argv[1]);
+        return 1;
+    }
+
+    std::vector<std::string> fens, ids;
+    std::string line;
+    int lineNumber = 0;
+
+    while(std::getline(file, line))
+    {
+        lineNumber++;
+        if(line.find_first_not_of(" \t\r") == std::string::npos) continue;
+
+        EpdRecord record;
+        if(!ParseEpdLine(line, record))
+        {
+            std::fprintf(stderr, "%s:%d: bad EPD line\n", argv[1], lineNumber);
+            continue;
+        }
+
+        std::string id = EpdOperation(record, "id");
+        if(id.empty()) id = "line " + std::to_string(lineNumber);
+
+        fens.push_back(record.fen);
+        ids.push_back(id);
+    }
+
+    auto print = [&](const BatchResult& result)
+    {
+        const char *id = ids[result.index].c_str(), *fen = fens[result.index].c_str();
+
+        if(job.type == BATCH_STATIC_EVAL)
+            std::printf("%s: cp %d  %s\n", id, result.score, fen);
+        else
+            std::printf("%s: %s %s  %s\n", id, UciScore(result.score).c_str(),
+                        result.bestMove == NULL_PACKED_MOVE ? "0000" : UciString(result.bestMove).c_str(), fen);
+
+        std::fflush(stdout);
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<BatchResult> results = EvaluateBatch(fens.data(), fens.size(), job, print);
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    uint64_t nodes = 0;
+    for(const BatchResult& result : results) nodes += result.nodes;
+
+    std::printf("%zu positions, %" PRIu64 " nodes in %.2fs: %.1f positions/s, %.0f nodes/s on %d threads\n",
+                results.size(), nodes, seconds, seconds > 0 ? results.size() / seconds : 0.0,
+                seconds > 0 ? nodes / seconds : 0.0, job.threads);
+
+    return 0;
+}
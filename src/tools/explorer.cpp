@@ -0,0 +1,103 @@
+// Opening explorer: aggregate move statistics from a game database and query them by position.
+//
+// usage: explorer build <db> <file.explorer> [max ply] [threads]
+//        explorer query <file.explorer> "<FEN>"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "engine/explorer.hpp"
+
+static int Usage(const char *name)
+{
+    std::fprintf(stderr, "usage: %s build <db> <file.explorer> [max ply] [threads]\n"
+                         "       %s query <file.explorer> \"<FEN>\"\n", name, name);
+    return 2;
+}
+
+static int Build(const std::string& db, const std::string& path, int maxPly, int threads)
+{
+    GameDatabase games;
+    if(!games.open(db + ".games"))
+    {
+        std::fprintf(stderr, "%s.games: cannot open\n", db.c_str());
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    if(!BuildExplorer(games, path, maxPly, threads))
+    {
+        std::fprintf(stderr, "%s: cannot write\n", path.c_str());
+        return 1;
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::printf("aggregated %zu games up to ply %d in %.2fs\n", games.gameCount(), maxPly, seconds);
+
+    return 0;
+}
+
+static int Query(const std::string& path, const std::string& fen)
+{
+    ExplorerFile explorer;
+    if(!explorer.open(path))
+    {
+        std::fprintf(stderr, "%s: cannot open\n", path.c_str());
+        return 1;
+    }
+
+    if(!PlausibleFEN(fen))
+    {
+        std::fprintf(stderr, "bad FEN\n");
+        return 2;
+    }
+
+    Position pos(fen);
+
+    auto start = std::chrono::steady_clock::now();
+
+    const ExplorerRecord *first, *last;
+    explorer.find(pos.zobristKey, first, last);
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<const ExplorerRecord *> moves;
+    for(const ExplorerRecord *r = first; r != last; r++) moves.push_back(r);
+
+    std::sort(moves.begin(), moves.end(), [](const ExplorerRecord *a, const ExplorerRecord *b) { return a->games > b->games; });
+
+    for(const ExplorerRecord *r : moves)
+    {
+        Move move = UnpackMove(r->move, pos);
+        move.createMoveString(pos);
+
+        std::printf("%-8s %8u games  +%5.1f%% =%5.1f%% -%5.1f%%  avg %4.0f\n", move.algebraicNotation.c_str(), r->games,
+                    100.0 * r->whiteWins / r->games, 100.0 * r->draws / r->games, 100.0 * r->blackWins / r->games,
+                    r->averageRating());
+    }
+
+    std::printf("%zu moves found in %.3f ms\n", moves.size(), ms);
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if(argc < 4) return Usage(argv[0]);
+
+    if(std::strcmp(argv[1], "build") == 0)
+        return Build(argv[2], argv[3], argc > 4 ? std::atoi(argv[4]) : 20,
+                     argc > 5 ? std::atoi(argv[5]) : static_cast<int>(std::thread::hardware_concurrency()));
+
+    if(std::strcmp(argv[1], "query") == 0)
+        return Query(argv[2], argv[3]);
+
+    return Usage(argv[0]);
+}
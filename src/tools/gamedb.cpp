@@ -0,0 +1,160 @@
+// Binary game database: import PGN, build the position index and find games by position.
+//
+// usage: gamedb import <file.pgn> <db> [threads]    writes <db>.games and <db>.index
+//        gamedb index <db> [threads]                rebuilds <db>.index
+//        gamedb find <db> "<FEN>" [max games]       lists the games that reached a position
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "engine/gamedb.hpp"
+
+static int Usage(const char *name)
+{
+    std::fprintf(stderr, "usage: %s import <file.pgn> <db> [threads]\n"
+                         "       %s index <db> [threads]\n"
+                         "       %s find <db> \"<FEN>\" [max games]\n", name, name, name);
+    return 2;
+}
+
+static int Index(const std::string& db, int threads)
+{
+    GameDatabase games;
+    if(!games.open(db + ".games"))
+    {
+        std::fprintf(stderr, "%s.games: cannot open\n", db.c_str());
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    if(!BuildPositionIndex(games, db + ".index", threads))
+    {
+        std::fprintf(stderr, "%s.index: cannot write\n", db.c_str());
+        return 1;
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::printf("indexed %zu games in %.2fs on %d threads\n", games.gameCount(), seconds, threads);
+
+    return 0;
+}
+
+static int Import(const std::string& pgn, const std::string& db, int threads)
+{
+    PgnReader reader;
+    if(!reader.open(pgn))
+    {
+        std::fprintf(stderr, "%s: cannot open or empty\n", pgn.c_str());
+        return 1;
+    }
+
+    GameDbWriter writer;
+    if(!writer.open(db + ".games"))
+    {
+        std::fprintf(stderr, "%s.games: cannot write\n", db.c_str());
+        return 1;
+    }
+
+    std::vector<PgnError> errors;
+    GameDbImportStats stats = ImportPgn(reader, writer, threads, &errors);
+
+    if(!writer.close())
+    {
+        std::fprintf(stderr, "%s.games: write error\n", db.c_str());
+        return 1;
+    }
+
+    for(const PgnError& error : errors)
+    {
+        std::printf("%s:%d:%d: game %zu skipped, ply %d: %s '%s'\n", pgn.c_str(), error.line, error.column,
+                    error.game + 1, error.ply, error.message.c_str(), error.san.c_str());
+    }
+
+    std::printf("imported %zu games (%zu skipped) in %.2fs\n", stats.games, stats.failedGames, stats.seconds);
+
+    return Index(db, threads);
+}
+
+static int Find(const std::string& db, const std::string& fen, size_t maxGames)
+{
+    GameDatabase games;
+    PositionIndex index;
+
+    if(!games.open(db + ".games", ACCESS_RANDOM) || !index.open(db + ".index"))
+    {
+        std::fprintf(stderr, "%s: cannot open database\n", db.c_str());
+        return 1;
+    }
+
+    if(!PlausibleFEN(fen))
+    {
+        std::fprintf(stderr, "bad FEN\n");
+        return 2;
+    }
+
+    Position pos(fen);
+
+    auto start = std::chrono::steady_clock::now();
+
+    const PositionIndexEntry *first, *last;
+    index.find(pos.zobristKey, first, last);
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    size_t shown = 0;
+    uint32_t lastGame = UINT32_MAX;
+    size_t distinctGames = 0;
+
+    for(const PositionIndexEntry *entry = first; entry != last; entry++)
+    {
+        // A game reaching the position more than once is listed at its first occurrence
+        if(entry->game == lastGame) continue;
+        lastGame = entry->game;
+        distinctGames++;
+
+        if(shown >= maxGames) continue;
+        shown++;
+
+        GameRecord record;
+        if(!games.readGame(entry->game, record))
+        {
+            std::printf("game %u ply %u: damaged record\n", entry->game, entry->ply);
+            continue;
+        }
+
+        const std::string *white = record.getTag("White");
+        const std::string *black = record.getTag("Black");
+
+        std::printf("game %u ply %u: %s - %s %s\n", entry->game, entry->ply,
+                    white ? white->c_str() : "?", black ? black->c_str() : "?", GameResultString(record.result));
+    }
+
+    std::printf("%zu games (%zu occurrences) found in %.3f ms\n", distinctGames,
+                static_cast<size_t>(last - first), ms);
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if(argc < 3) return Usage(argv[0]);
+
+    const int defaultThreads = static_cast<int>(std::thread::hardware_concurrency());
+
+    if(std::strcmp(argv[1], "import") == 0 && argc >= 4)
+        return Import(argv[2], argv[3], argc > 4 ? std::atoi(argv[4]) : defaultThreads);
+
+    if(std::strcmp(argv[1], "index") == 0)
+        return Index(argv[2], argc > 3 ? std::atoi(argv[3]) : defaultThreads);
+
+    if(std::strcmp(argv[1], "find") == 0 && argc >= 4)
+        return Find(argv[2], argv[3], argc > 4 ? std::strtoul(argv[4], nullptr, 10) : 20);
+
+    return Usage(argv[0]);
+}
@@ -0,0 +1,158 @@
+// Play two UCI engines against each other: concurrent games, Elo estimate, SPRT stop rule and PGN output.
+//
+// usage: match <engine 1> <engine 2> [options]
+//
+//   --games <n>                 games to play, in pairs with the colors swapped (default 100)
+//   --concurrency <n>           games played at the same time (default 1)
+//   --tc <seconds>[+<inc>]      time per game and increment (default 10+0.1)
+//   --book <file.epd>           openings, one per pair of games in file order
+//   --pgn <file.pgn>            append the games
+//   --sprt <elo0> <elo1>        stop once the test decides, alpha = beta = 0.05
+//   --alpha <a> --beta <b>
+//   --option1 <Name=Value>      setoption for engine 1, repeatable; --option2 for engine 2
+//   --name1 <name> --name2 <name>
+//
+// An engine is a command line, quote it to pass arguments: match ./uci "./uci-old --flag"
+
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#include "engine/epd.hpp"
+#include "engine/match.hpp"
+
+static int Usage(const char *name)
+{
+    std::fprintf(stderr, "usage: %s <engine 1> <engine 2> [--games n] [--concurrency n] [--tc seconds+inc] [--book file.epd]\n"
+                         "       [--pgn file.pgn] [--sprt elo0 elo1] [--alpha a] [--beta b] [--option1 Name=Value]\n"
+                         "       [--option2 Name=Value] [--name1 name] [--name2 name]\n", name);
+    return 2;
+}
+
+static bool ParseTimeControl(const char *text, TimeControl& tc)
+{
+    char *end;
+    const double base = std::strtod(text, &end);
+    double increment = 0;
+
+    if(*end == '+') increment = std::strtod(end + 1, &end);
+    if(*end || base <= 0 || increment < 0) return false;
+
+    tc.base = static_cast<int64_t>(base * 1000);
+    tc.increment = static_cast<int64_t>(increment * 1000);
+
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    if(argc < 3) return Usage(argv[0]);
+
+    MatchOptions options;
+    options.commands[0] = options.names[0] = argv[1];
+    options.commands[1] = options.names[1] = argv[2];
+
+    const char *pgnPath = nullptr;
+
+    for(int arg = 3; arg < argc; arg++)
+    {
+        const bool value = arg + 1 < argc;
+
+        if(!std::strcmp(argv[arg], "--games") && value)             options.games = std::strtoull(argv[++arg], nullptr, 10);
+        else if(!std::strcmp(argv[arg], "--concurrency") && value)  options.concurrency = std::atoi(argv[++arg]);
+        else if(!std::strcmp(argv[arg], "--pgn") && value)          pgnPath = argv[++arg];
+        else if(!std::strcmp(argv[arg], "--alpha") && value)        options.alpha = std::atof(argv[++arg]);
+        else if(!std::strcmp(argv[arg], "--beta") && value)         options.beta = std::atof(argv[++arg]);
+        else if(!std::strcmp(argv[arg], "--option1") && value)      options.engineOptions[0].push_back(argv[++arg]);
+        else if(!std::strcmp(argv[arg], "--option2") && value)      options.engineOptions[1].push_back(argv[++arg]);
+        else if(!std::strcmp(argv[arg], "--name1") && value)        options.names[0] = argv[++arg];
+        else if(!std::strcmp(argv[arg], "--name2") && value)        options.names[1] = argv[++arg];
+        else if(!std::strcmp(argv[arg], "--tc") && value)
+        {
+            if(!ParseTimeControl(argv[++arg], options.timeControl))
+            {
+                std::fprintf(stderr, "%s: bad time control\n", argv[arg]);
+                return 2;
+            }
+        }
+        else if(!std::strcmp(argv[arg], "--book") && value)
+        {
+            if(!LoadEpdPositions(argv[++arg], options.openings) || options.openings.empty())
+            {
+                std::fprintf(stderr, "%s: cannot open or no positions\n", argv[arg]);
+                return 1;
+            }
+        }
+        else if(!std::strcmp(argv[arg], "--sprt") && arg + 2 < argc)
+        {
+            options.sprt = true;
+            options.elo0 = std::atof(argv[++arg]);
+            options.elo1 = std::atof(argv[++arg]);
+        }
+        else
+        {
+            return Usage(argv[0]);
+        }
+    }
+
+    std::ofstream pgn;
+    if(pgnPath)
+    {
+        pgn.open(pgnPath, std::ios::app);
+        if(!pgn)
+        {
+            std::fprintf(stderr, "%s: cannot write\n", pgnPath);
+            return 1;
+        }
+    }
+
+    double lower = 0, upper = 0;
+    if(options.sprt) SprtBounds(options.alpha, options.beta, lower, upper);
+
+    auto printScore = [&](const MatchScore& score)
+    {
+        std::printf("score of %s vs %s: +%" PRIu64 " =%" PRIu64 " -%" PRIu64 ", elo %.1f +- %.1f", options.names[0].c_str(),
+                    options.names[1].c_str(), score.wins, score.draws, score.losses, EloDifference(score), EloMargin(score));
+
+        if(options.sprt)
+            std::printf(", LLR %.2f (%.2f, %.2f)", SprtLlr(score, options.elo0, options.elo1), lower, upper);
+
+        std::printf("\n");
+    };
+
+    auto report = [&](const MatchGame& game, const MatchScore& score)
+    {
+        std::printf("game %" PRIu64 ": %s - %s %s, %s\n", game.number + 1,
+                    options.names[game.white].c_str(), options.names[1 - game.white].c_str(),
+                    GameResultString(game.result), MatchTerminationString(game.termination));
+        printScore(score);
+        std::fflush(stdout);
+
+        if(pgn.is_open()) pgn << MatchGamePgn(options, game) << std::flush;
+    };
+
+    MatchScore score;
+    std::string error;
+
+    if(!RunMatch(options, report, score, error))
+    {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+
+    std::printf("\nfinished after %" PRIu64 " games\n", score.games());
+    printScore(score);
+
+    if(options.sprt)
+    {
+        const double llr = SprtLlr(score, options.elo0, options.elo1);
+        std::printf("SPRT [%.1f, %.1f]: %s\n", options.elo0, options.elo1,
+                    llr >= upper ? "H1 accepted" : llr <= lower ? "H0 accepted" : "inconclusive");
+    }
+
+    return 0;
+}
@@ -0,0 +1,149 @@
+// Solve a set of mate puzzles with the proof-number mate solver.
+//
+// usage: matesolve <file.epd> [max moves] [threads] [nodes per position]
+//
+// Each EPD line is the first four FEN fields followed by operations; "dm N" bounds the search to a mate in N
+// and is checked against the result, "id" names the position in the output.
+
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "engine/dfpn.hpp"
+#include "engine/epd.hpp"
+
+#define DEFAULT_MAX_MOVES 5
+#define SOLVER_MB 32
+
+struct Puzzle
+{
+    std::string fen;
+    std::string id;
+    int directMate;     // 0 when the line has no dm
+};
+
+static bool ParsePuzzle(const std::string& line, Puzzle& puzzle)
+{
+    EpdRecord record;
+    if(!ParseEpdLine(line, record)) return false;
+
+    puzzle.fen = record.fen;
+    puzzle.id = EpdOperation(record, "id");
+    puzzle.directMate = std::atoi(EpdOperation(record, "dm").c_str());
+
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    if(argc < 2)
+    {
+        std::fprintf(stderr, "usage: %s <file.epd> [max moves] [threads] [nodes per position]\n", argv[0]);
+        return 2;
+    }
+
+    std::ifstream file(argv[1]);
+    if(!file)
+    {
+        std::fprintf(stderr, "%s: cannot open\n", argv[1]);
+        return 1;
+    }
+
+    const int maxMoves = argc > 2 ? std::atoi(argv[2]) : DEFAULT_MAX_MOVES;
+    int threads = argc > 3 ? std::atoi(argv[3]) : static_cast<int>(std::thread::hardware_concurrency());
+    const uint64_t maxNodes = argc > 4 ? std::strtoull(argv[4], nullptr, 10) : 0;
+    if(threads < 1) threads = 1;
+
+    std::vector<Puzzle> puzzles;
+    std::string line;
+    int lineNumber = 0;
+
+    while(std::getline(file, line))
+    {
+        lineNumber++;
+        if(line.find_first_not_of(" \t\r") == std::string::npos) continue;
+
+        Puzzle puzzle;
+        if(!ParsePuzzle(line, puzzle))
+        {
+            std::fprintf(stderr, "%s:%d: bad EPD line\n", argv[1], lineNumber);
+            continue;
+        }
+
+        if(puzzle.id.empty()) puzzle.id = "line " + std::to_string(lineNumber);
+        puzzles.push_back(puzzle);
+    }
+
+    // Positions go to the threads one at a time, each thread with its own solver and table
+    std::vector<MateResult> results(puzzles.size());
+    std::atomic<size_t> next(0);
+    auto start = std::chrono::steady_clock::now();
+
+    auto worker = [&]()
+    {
+        MateSolver solver(SOLVER_MB);
+
+        for(size_t i; (i = next++) < puzzles.size(); )
+        {
+            const int bound = puzzles[i].directMate > 0 ? puzzles[i].directMate : maxMoves;
+
+            solver.clear();
+            results[i] = solver.solve(Position(puzzles[i].fen), bound, maxNodes);
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for(int t = 1; t < threads; t++) pool.emplace_back(worker);
+    worker();
+    for(std::thread& thread : pool) thread.join();
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    int found = 0, none = 0, unknown = 0, wrong = 0;
+    uint64_t nodes = 0;
+
+    for(size_t i = 0; i < puzzles.size(); i++)
+    {
+        const MateResult& result = results[i];
+        nodes += result.nodes;
+
+        if(result.status == MATE_FOUND)
+        {
+            found++;
+
+            std::string pv;
+            for(PackedMove move : result.pv) pv += " " + UciString(move);
+
+            const bool mismatch = puzzles[i].directMate && result.mateIn != puzzles[i].directMate;
+            if(mismatch) wrong++;
+
+            std::printf("%s: mate in %d%s%s\n", puzzles[i].id.c_str(), result.mateIn, pv.c_str(),
+                        mismatch ? "  (dm differs)" : "");
+        }
+        else if(result.status == MATE_NONE)
+        {
+            none++;
+            if(puzzles[i].directMate) wrong++;
+
+            std::printf("%s: no mate\n", puzzles[i].id.c_str());
+        }
+        else
+        {
+            unknown++;
+            std::printf("%s: unknown, node limit\n", puzzles[i].id.c_str());
+        }
+    }
+
+    std::printf("%zu positions: %d mates, %d without, %d unknown, %d differ from dm\n", puzzles.size(), found, none,
+                unknown, wrong);
+    std::printf("%" PRIu64 " nodes in %.2fs: %.1f positions/s, %.0f nodes/s on %d threads\n", nodes, seconds,
+                seconds > 0 ? puzzles.size() / seconds : 0.0, seconds > 0 ? nodes / seconds : 0.0, threads);
+
+    return wrong ? 1 : 0;
+}
@@ -0,0 +1,147 @@
+// Count the leaf nodes of the legal move tree to check the move generator and measure its speed.
+//
+// usage: perft "<FEN>" <depth> [threads] [--divide]    (startpos for the initial position)
+//        perft --suite [max depth]                     run the standard positions against their known counts
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include "engine/alloctrack.hpp"
+#include "engine/movegen.hpp"
+#include "engine/pgn.hpp"
+
+struct PerftCase
+{
+    const char *fen;
+    int depth;
+    uint64_t nodes;
+};
+
+// Reference counts from the chess programming wiki perft results page
+static const PerftCase PERFT_SUITE[] =
+{
+    {PGN_STARTING_FEN, 5, 4865609ULL},
+    {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 4, 4085603ULL},
+    {"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 6, 11030083ULL},
+    {"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 5, 15833292ULL},
+    {"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 4, 2103487ULL},
+    {"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 4, 3894594ULL},
+};
+
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Instrumented builds print where the run allocated and fail when the tree walk did
+static int CheckAllocations(uint64_t nodes)
+{
+    if(!ALLOCS_ENABLED) return 0;
+
+    const AllocCounts counts = CollectAllocations();
+    std::printf("%s", AllocationReport(counts, nodes).c_str());
+
+    if(!HotPathAllocated(counts)) return 0;
+
+    std::fprintf(stderr, "the perft tree walk allocated\n");
+    return 1;
+}
+
+static int Suite(int maxDepth)
+{
+    int failed = 0;
+    uint64_t totalNodes = 0;
+    auto start = std::chrono::steady_clock::now();
+    ResetAllocations();
+
+    for(const PerftCase& test : PERFT_SUITE)
+    {
+        if(test.depth > maxDepth) continue;
+
+        Position pos(test.fen);
+        uint64_t nodes = Perft(pos, test.depth);
+        totalNodes += nodes;
+
+        bool ok = nodes == test.nodes;
+        if(!ok) failed++;
+
+        std::printf("%s depth %d: %" PRIu64 " (expected %" PRIu64 ") %s\n", test.fen, test.depth, nodes, test.nodes,
+                    ok ? "ok" : "FAILED");
+    }
+
+    double seconds = Seconds(start);
+    std::printf("%d failed, %" PRIu64 " nodes in %.2fs: %.0f nodes/s\n", failed, totalNodes, seconds,
+                seconds > 0 ? totalNodes / seconds : 0.0);
+
+    const int allocationFailure = CheckAllocations(totalNodes);
+
+    return failed || allocationFailure ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    if(argc >= 2 && std::strcmp(argv[1], "--suite") == 0)
+        return Suite(argc > 2 ? std::atoi(argv[2]) : 6);
+
+    if(argc < 3)
+    {
+        std::fprintf(stderr, "usage: %s \"<FEN>\" <depth> [threads] [--divide]\n"
+                             "       %s --suite [max depth]\n", argv[0], argv[0]);
+        return 2;
+    }
+
+    std::string fen = std::strcmp(argv[1], "startpos") == 0 ? PGN_STARTING_FEN : argv[1];
+
+    if(!PlausibleFEN(fen))
+    {
+        std::fprintf(stderr, "bad FEN\n");
+        return 2;
+    }
+
+    Position pos(fen);
+    const int depth = std::atoi(argv[2]);
+    int threads = static_cast<int>(std::thread::hardware_concurrency());
+    bool divide = false;
+
+    for(int i = 3; i < argc; i++)
+    {
+        if(std::strcmp(argv[i], "--divide") == 0) divide = true;
+        else threads = std::atoi(argv[i]);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t nodes = 0;
+    ResetAllocations();
+
+    if(divide && depth > 0)
+    {
+        MoveList moves;
+        GenerateLegalMoves(pos, moves);
+
+        for(PackedMove move : moves)
+        {
+            MoveUndo undo;
+            pos.makeMove(move, undo);
+            uint64_t count = Perft(pos, depth - 1);
+            pos.unmakeMove(undo);
+
+            std::printf("%s: %" PRIu64 "\n", UciString(move).c_str(), count);
+            nodes += count;
+        }
+    }
+    else
+    {
+        nodes = PerftParallel(pos, depth, threads);
+    }
+
+    double seconds = Seconds(start);
+    std::printf("nodes %" PRIu64 " in %.2fs: %.0f nodes/s on %d threads\n", nodes, seconds,
+                seconds > 0 ? nodes / seconds : 0.0, divide ? 1 : threads);
+
+    return CheckAllocations(nodes);
+}
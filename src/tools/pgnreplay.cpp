@@ -0,0 +1,58 @@
+// Replay every game of a PGN file and report illegal moves and throughput.
+//
+// usage: pgnreplay <file.pgn> [threads] [--keep-annotations] [--check-suffixes] [--progress]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "engine/pgn.hpp"
+
+int main(int argc, char **argv)
+{
+    if(argc < 2)
+    {
+        std::fprintf(stderr, "usage: %s <file.pgn> [threads] [--keep-annotations] [--check-suffixes] [--progress]\n", argv[0]);
+        return 2;
+    }
+
+    std::string path = argv[1];
+    PgnReplayOptions options = {static_cast<int>(std::thread::hardware_concurrency()), PGN_SKIP_ANNOTATIONS, false};
+    bool progress = false;
+
+    for(int i = 2; i < argc; i++)
+    {
+        if(std::strcmp(argv[i], "--keep-annotations") == 0) options.annotations = PGN_KEEP_ANNOTATIONS;
+        else if(std::strcmp(argv[i], "--check-suffixes") == 0) options.validateSuffixes = true;
+        else if(std::strcmp(argv[i], "--progress") == 0) progress = true;
+        else options.threads = std::atoi(argv[i]);
+    }
+
+    if(options.threads < 1) options.threads = 1;
+
+    PgnReader reader;
+    if(!reader.open(path))
+    {
+        std::fprintf(stderr, "%s: cannot open or empty\n", path.c_str());
+        return 1;
+    }
+
+    std::vector<PgnError> errors;
+    PgnStats stats = reader.replay(options, PgnPositionVisitor(), &errors, progress ? &std::cerr : nullptr);
+
+    for(const PgnError& error : errors)
+    {
+        std::printf("%s:%d:%d: game %zu, ply %d: %s '%s'\n", path.c_str(), error.line, error.column,
+                    error.game + 1, error.ply, error.message.c_str(), error.san.c_str());
+    }
+
+    std::printf("%zu games (%zu with errors), %zu plies in %.2fs: %.0f games/s, %.0f plies/s on %d threads\n",
+                stats.games, stats.failedGames, stats.plies, stats.seconds,
+                stats.gamesPerSecond(), stats.seconds > 0 ? stats.plies / stats.seconds : 0.0, options.threads);
+
+    return stats.failedGames ? 1 : 0;
+}
@@ -0,0 +1,64 @@
+// Play random legal games to stress the move generator and measure make / unmake throughput.
+//
+// usage: playout <games> [threads] [seed] ["<FEN>"]    (the initial position by default)
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+#include "engine/pgn.hpp"
+#include "engine/playout.hpp"
+
+int main(int argc, char **argv)
+{
+    if(argc < 2)
+    {
+        std::fprintf(stderr, "usage: %s <games> [threads] [seed] [\"<FEN>\"]\n", argv[0]);
+        return 2;
+    }
+
+    const uint64_t games = std::strtoull(argv[1], nullptr, 10);
+    const int threads = argc > 2 ? std::atoi(argv[2]) : static_cast<int>(std::thread::hardware_concurrency());
+    const uint64_t seed = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 1;
+    const std::string fen = argc > 4 ? argv[4] : PGN_STARTING_FEN;
+
+    if(!PlausibleFEN(fen))
+    {
+        std::fprintf(stderr, "bad FEN\n");
+        return 2;
+    }
+
+    Position start(fen);
+
+    auto begin = std::chrono::steady_clock::now();
+    PlayoutStats stats = RunPlayouts(start, games, threads > 0 ? threads : 1, seed);
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    std::printf("%" PRIu64 " games, %" PRIu64 " plies in %.2fs: %.0f games/s, %.0f plies/s on %d threads\n",
+                stats.games, stats.plies, seconds, seconds > 0 ? stats.games / seconds : 0.0,
+                seconds > 0 ? stats.plies / seconds : 0.0, threads);
+
+    if(!stats.games) return 0;
+
+    std::printf("length: mean %.1f, min %d, max %d plies\n", static_cast<double>(stats.plies) / stats.games,
+                stats.minPlies, stats.maxPlies);
+
+    for(int i = 0; i < PLAYOUT_RESULT_COUNT; i++)
+        std::printf("  %-22s %10" PRIu64 " %6.2f%%\n", PlayoutResultName(static_cast<PlayoutResult>(i)), stats.results[i],
+                    100.0 * stats.results[i] / stats.games);
+
+    std::printf("plies:\n");
+
+    for(int i = 0; i < PLAYOUT_BUCKETS; i++)
+    {
+        if(!stats.lengths[i]) continue;
+
+        std::printf("  %4d-%-4d %10" PRIu64 " %6.2f%%\n", i * PLAYOUT_BUCKET_PLIES, (i + 1) * PLAYOUT_BUCKET_PLIES - 1,
+                    stats.lengths[i], 100.0 * stats.lengths[i] / stats.games);
+    }
+
+    return 0;
+}
@@ -0,0 +1,133 @@
+// Self-play training data: scored positions from fixed node games of the engine against itself.
+//
+// usage: selfplay play <out.train> <games> [threads] [nodes] [options]
+//        selfplay show <file.train> <first record> [count]
+//
+// play options: --book <file.epd>   start from the positions of an EPD or FEN file, game i from line i
+//               --random <plies>    random moves before the first search (default 8)
+//               --seed <n>
+//               --keep-checks       also write positions in check
+//               --keep-noisy        also write positions whose best move is a capture or a promotion
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include "engine/epd.hpp"
+#include "engine/selfplay.hpp"
+
+static int Usage(const char *name)
+{
+    std::fprintf(stderr, "usage: %s play <out.train> <games> [threads] [nodes] [--book <file.epd>] [--random <plies>]\n"
+                         "       %*s [--seed <n>] [--keep-checks] [--keep-noisy]\n"
+                         "       %s show <file.train> <first record> [count]\n",
+                         name, static_cast<int>(std::strlen(name)) + 5, "", name);
+    return 2;
+}
+
+static int Play(int argc, char **argv)
+{
+    SelfPlayOptions options;
+    options.games = std::strtoull(argv[3], nullptr, 10);
+    options.threads = static_cast<int>(std::thread::hardware_concurrency());
+
+    for(int arg = 4, position = 0; arg < argc; arg++)
+    {
+        if(!std::strcmp(argv[arg], "--book") && arg + 1 < argc)
+        {
+            if(!LoadEpdPositions(argv[++arg], options.openings) || options.openings.empty())
+            {
+                std::fprintf(stderr, "%s: cannot open or no positions\n", argv[arg]);
+                return 1;
+            }
+        }
+        else if(!std::strcmp(argv[arg], "--random") && arg + 1 < argc)
+            options.randomPlies = std::atoi(argv[++arg]);
+        else if(!std::strcmp(argv[arg], "--seed") && arg + 1 < argc)
+            options.seed = std::strtoull(argv[++arg], nullptr, 10);
+        else if(!std::strcmp(argv[arg], "--keep-checks"))
+            options.skipChecks = false;
+        else if(!std::strcmp(argv[arg], "--keep-noisy"))
+            options.skipNoisy = false;
+        else if(position == 0 && ++position)
+            options.threads = std::atoi(argv[arg]);
+        else if(position == 1 && ++position)
+            options.nodes = std::strtoull(argv[arg], nullptr, 10);
+        else
+            return Usage(argv[0]);
+    }
+
+    if(options.threads < 1) options.threads = 1;
+
+    TrainingDataWriter writer;
+    if(!writer.open(argv[2]))
+    {
+        std::fprintf(stderr, "%s: cannot write\n", argv[2]);
+        return 1;
+    }
+
+    const uint64_t every = options.games >= 20 ? options.games / 20 : 1;
+
+    auto report = [every](const SelfPlayProgress& progress)
+    {
+        if(progress.games % every) return;
+
+        std::printf("%" PRIu64 " games, %" PRIu64 " positions in %.0fs: %.0f positions/hour, +%" PRIu64 " =%" PRIu64 " -%" PRIu64 "\n",
+                    progress.games, progress.positions, progress.seconds,
+                    progress.seconds > 0 ? progress.positions * 3600.0 / progress.seconds : 0.0,
+                    progress.results[RESULT_WHITE_WINS], progress.results[RESULT_DRAW], progress.results[RESULT_BLACK_WINS]);
+        std::fflush(stdout);
+    };
+
+    SelfPlayProgress progress = RunSelfPlay(options, writer, report);
+
+    if(!writer.close())
+    {
+        std::fprintf(stderr, "%s: write error\n", argv[2]);
+        return 1;
+    }
+
+    std::printf("%" PRIu64 " positions from %" PRIu64 " games in %.2fs on %d threads, %.0f positions/hour\n",
+                progress.positions, progress.games, progress.seconds, options.threads,
+                progress.seconds > 0 ? progress.positions * 3600.0 / progress.seconds : 0.0);
+
+    return 0;
+}
+
+static int Show(int argc, char **argv)
+{
+    TrainingData data;
+    if(!data.open(argv[2]))
+    {
+        std::fprintf(stderr, "%s: cannot open or not training data\n", argv[2]);
+        return 1;
+    }
+
+    const size_t first = std::strtoull(argv[3], nullptr, 10);
+    const size_t count = argc > 4 ? std::strtoull(argv[4], nullptr, 10) : 1;
+
+    std::printf("%zu positions, %zu games\n", data.size(), data.gameCount());
+
+    for(size_t i = first; i < first + count && i < data.size(); i++)
+    {
+        const TrainingRecord& record = data[i];
+
+        std::printf("%zu: game %u, score %d, %s, %s\n", i, record.game, record.score,
+                    GameResultString(static_cast<GameResult>(record.result)), Position(record.state).CreateFENString().c_str());
+    }
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if(argc < 4) return Usage(argv[0]);
+
+    if(!std::strcmp(argv[1], "play")) return Play(argc, argv);
+    if(!std::strcmp(argv[1], "show")) return Show(argc, argv);
+
+    return Usage(argv[0]);
+}
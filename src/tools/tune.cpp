@@ -0,0 +1,108 @@
+// Tune the evaluation weights on positions labelled with game results.
+//
+// usage: tune <data.epd | data.train> <tables.hpp> [epochs] [threads] [learning rate]
+//
+// Each EPD line is a position followed by its result, as a c9 operation or as the last word of the line
+// ("1-0", "[0.5]", ...). A .train file from selfplay is labelled with the results of its games.
+// The tuned tables are written to tables.hpp every report and at the end; copy it over
+// src/Chess3D/engine/evaltables.hpp and rebuild to use them.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#include "engine/trainingdata.hpp"
+#include "engine/tuner.hpp"
+
+#define DEFAULT_EPOCHS 1000
+#define DEFAULT_LEARNING_RATE 1.0
+#define REPORT_EPOCHS 50
+
+static bool WriteTables(const Tuner& tuner, const char *path)
+{
+    std::ofstream out(path);
+    if(!out) return false;
+
+    tuner.writeTables(out);
+    return static_cast<bool>(out);
+}
+
+int main(int argc, char **argv)
+{
+    if(argc < 3)
+    {
+        std::fprintf(stderr, "usage: %s <data.epd | data.train> <tables.hpp> [epochs] [threads] [learning rate]\n", argv[0]);
+        return 2;
+    }
+
+    const int epochs = argc > 3 ? std::atoi(argv[3]) : DEFAULT_EPOCHS;
+    int threads = argc > 4 ? std::atoi(argv[4]) : static_cast<int>(std::thread::hardware_concurrency());
+    const double learningRate = argc > 5 ? std::atof(argv[5]) : DEFAULT_LEARNING_RATE;
+    if(threads < 1) threads = 1;
+
+    Tuner tuner(threads);
+    auto start = std::chrono::steady_clock::now();
+    auto elapsed = [&start]() { return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(); };
+
+    const std::string path = argv[1];
+    size_t loaded, skipped = 0;
+
+    // Self-play output is read in place, anything else as EPD
+    if(path.size() > 6 && path.compare(path.size() - 6, 6, ".train") == 0)
+    {
+        TrainingData data;
+        if(!data.open(path))
+        {
+            std::fprintf(stderr, "%s: cannot open or not training data\n", argv[1]);
+            return 1;
+        }
+
+        loaded = tuner.load(data);
+        skipped = data.size() - loaded;
+    }
+    else
+    {
+        std::ifstream file(path);
+        if(!file)
+        {
+            std::fprintf(stderr, "%s: cannot open\n", argv[1]);
+            return 1;
+        }
+
+        loaded = tuner.load(file, &skipped);
+    }
+
+    std::printf("%zu positions loaded in %.2fs, %zu skipped\n", loaded, elapsed(), skipped);
+    if(!loaded) return 1;
+
+    const double k = tuner.fitScale();
+    std::printf("K %.4f, loss %.6f\n", k, tuner.loss());
+    std::fflush(stdout);
+
+    start = std::chrono::steady_clock::now();
+
+    for(int epoch = 1; epoch <= epochs; epoch++)
+    {
+        const double loss = tuner.step(learningRate);
+
+        if(epoch % REPORT_EPOCHS == 0 || epoch == epochs)
+        {
+            std::printf("epoch %d: loss %.6f, %.2fs, %.0f positions/s\n", epoch, loss, elapsed(),
+                        elapsed() > 0 ? static_cast<double>(loaded) * epoch / elapsed() : 0.0);
+            std::fflush(stdout);
+
+            if(!WriteTables(tuner, argv[2]))
+            {
+                std::fprintf(stderr, "%s: cannot write\n", argv[2]);
+                return 1;
+            }
+        }
+    }
+
+    std::printf("final loss %.6f, tables written to %s\n", tuner.loss(), argv[2]);
+
+    return 0;
+}
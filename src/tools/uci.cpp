@@ -0,0 +1,701 @@
+// UCI engine on top of the alpha-beta search. Every selective search feature is a check option,
+// so its effect can be measured by switching it off in a GUI or a match runner.
+//
+// usage: uci                            (then speak UCI on stdin / stdout)
+//        uci bench [depth] [threads]     fixed depth search of built-in positions: node signature and nodes/s
+//        uci bench mcts [playouts] [threads]     the same positions with MCTS: playouts/s and thread scaling
+//        uci bench eval [positions]      attack bitboard evaluation terms against legal move mobility, ns per position
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "engine/alloctrack.hpp"
+#include "engine/bitboard.hpp"
+#include "engine/evaluate.hpp"
+#include "engine/mcts.hpp"
+#include "engine/movegen.hpp"
+#include "engine/pgn.hpp"
+#include "engine/search.hpp"
+#include "engine/stats.hpp"
+
+#define ENGINE_NAME "Chess3D"
+#define DEFAULT_HASH_MB 16
+#define MAX_HASH_MB 4096
+#define DEFAULT_MCTS_MB 64
+#define MAX_THREADS 256
+
+struct CheckOption
+{
+    const char *name;
+    bool SearchOptions::*field;
+};
+
+static const CheckOption CHECK_OPTIONS[] =
+{
+    {"PVS", &SearchOptions::pvs},
+    {"Aspiration", &SearchOptions::aspiration},
+    {"NullMove", &SearchOptions::nullMove},
+    {"LMR", &SearchOptions::lmr},
+    {"Futility", &SearchOptions::futility},
+    {"ReverseFutility", &SearchOptions::reverseFutility},
+    {"CheckExtensions", &SearchOptions::checkExtensions},
+};
+
+static std::mutex outputMutex;
+
+// The search thread and the input loop both write; whole lines only
+static void Send(const std::string& line)
+{
+    std::lock_guard<std::mutex> lock(outputMutex);
+    std::cout << line << std::endl;
+}
+
+static bool ParseBool(const std::string& value)
+{
+    return value == "true" || value == "1" || value == "on";
+}
+
+// A UCI move is only accepted when it matches one of the legal moves
+static bool ApplyUciMove(Position& pos, const std::string& text)
+{
+    MoveList moves;
+    GenerateLegalMoves(pos, moves);
+
+    for(PackedMove move : moves)
+    {
+        if(UciString(move) != text) continue;
+
+        MoveUndo undo;
+        pos.makeMove(move, undo);
+        return true;
+    }
+
+    return false;
+}
+
+class Engine
+{
+public:
+    Engine() : tt(DEFAULT_HASH_MB), search(tt), mcts(DEFAULT_MCTS_MB), position(PGN_STARTING_FEN), useMcts(false), threads(1),
+               pondering(false), stopRequested(false), ponderhitReceived(false), finished(true) {}
+    ~Engine() { stop(); }
+
+    void command(const std::string& line);
+
+private:
+    void setPosition(std::istringstream& in);
+    void setOption(std::istringstream& in);
+    void go(std::istringstream& in);
+    void ponderhit();
+    void stop();
+
+    TranspositionTable tt;
+    Search search;
+    Mcts mcts;
+    Position position;
+
+    // Threads only apply to MCTS, the alpha-beta search runs on one
+    bool useMcts;
+    int threads;
+
+    // The last go was go ponder: its best move waits for ponderhit or stop
+    bool pondering;
+
+    std::thread worker;
+    std::atomic<bool> stopRequested;
+    std::atomic<bool> ponderhitReceived;
+    std::atomic<bool> finished;
+};
+
+void Engine::command(const std::string& line)
+{
+    std::istringstream in(line);
+    std::string token;
+    in >> token;
+
+    if(token == "uci")
+    {
+        Send("id name " ENGINE_NAME);
+        Send("id author mdrosiadis");
+        Send("option name Hash type spin default " + std::to_string(DEFAULT_HASH_MB) + " min 1 max " + std::to_string(MAX_HASH_MB));
+        Send("option name Clear Hash type button");
+        Send("option name Ponder type check default false");
+        Send("option name Threads type spin default 1 min 1 max " + std::to_string(MAX_THREADS));
+        Send("option name UseMCTS type check default false");
+        Send("option name MCTSMemory type spin default " + std::to_string(DEFAULT_MCTS_MB) + " min 1 max " + std::to_string(MAX_HASH_MB));
+
+        for(const CheckOption& option : CHECK_OPTIONS)
+            Send(std::string("option name ") + option.name + " type check default true");
+
+        Send("uciok");
+    }
+    else if(token == "isready")
+    {
+        Send("readyok");
+    }
+    else if(token == "ucinewgame")
+    {
+        stop();
+        tt.clear();
+        search.clear();
+        mcts.clear();
+        position = Position(PGN_STARTING_FEN);
+    }
+    else if(token == "position")
+    {
+        stop();
+        setPosition(in);
+    }
+    else if(token == "setoption")
+    {
+        stop();
+        setOption(in);
+    }
+    else if(token == "go")
+    {
+        stop();
+        go(in);
+    }
+    else if(token == "ponderhit")
+    {
+        ponderhit();
+    }
+    else if(token == "stop")
+    {
+        stop();
+    }
+    else if(token == "d")
+    {
+        Send(position.CreateFENString());
+    }
+    else if(token == "stats")
+    {
+        // Counters since the last go, zero unless built with ENGINE_STATS
+        Send(StatsJSON(CollectStats()));
+    }
+}
+
+// position startpos|fen <FEN> [moves <m1> <m2> ...]
+void Engine::setPosition(std::istringstream& in)
+{
+    std::string token, fen;
+    in >> token;
+
+    if(token == "startpos")
+    {
+        fen = PGN_STARTING_FEN;
+        in >> token;
+    }
+    else if(token == "fen")
+    {
+        while(in >> token && token != "moves") fen += (fen.empty() ? "" : " ") + token;
+    }
+
+    if(!PlausibleFEN(fen))
+    {
+        Send("info string bad position " + fen);
+        return;
+    }
+
+    position = Position(fen);
+
+    if(token != "moves") return;
+
+    while(in >> token)
+    {
+        if(!ApplyUciMove(position, token))
+        {
+            Send("info string illegal move " + token);
+            return;
+        }
+    }
+}
+
+// setoption name <id> [value <x>]
+void Engine::setOption(std::istringstream& in)
+{
+    std::string token, name, value;
+    in >> token;
+
+    while(in >> token && token != "value") name += (name.empty() ? "" : " ") + token;
+    while(in >> token) value += (value.empty() ? "" : " ") + token;
+
+    if(name == "Hash")
+    {
+        int megabytes = std::atoi(value.c_str());
+        if(megabytes < 1) megabytes = 1;
+        if(megabytes > MAX_HASH_MB) megabytes = MAX_HASH_MB;
+
+        tt.resize(megabytes);
+        return;
+    }
+
+    if(name == "Clear Hash")
+    {
+        tt.clear();
+        return;
+    }
+
+    // Only tells that the GUI may send go ponder, which is always understood
+    if(name == "Ponder") return;
+
+    if(name == "Threads")
+    {
+        threads = std::max(1, std::min(MAX_THREADS, std::atoi(value.c_str())));
+        return;
+    }
+
+    if(name == "UseMCTS")
+    {
+        useMcts = ParseBool(value);
+        return;
+    }
+
+    if(name == "MCTSMemory")
+    {
+        mcts.resize(std::max(1, std::min(MAX_HASH_MB, std::atoi(value.c_str()))));
+        return;
+    }
+
+    for(const CheckOption& option : CHECK_OPTIONS)
+    {
+        if(name != option.name) continue;
+
+        search.options.*option.field = ParseBool(value);
+        return;
+    }
+
+    Send("info string unknown option " + name);
+}
+
+void Engine::go(std::istringstream& in)
+{
+    SearchLimits limits;
+    std::string token;
+
+    while(in >> token)
+    {
+        if(token == "depth")          in >> limits.depth;
+        else if(token == "nodes")     in >> limits.nodes;
+        else if(token == "movetime")  in >> limits.moveTime;
+        else if(token == "wtime")     in >> limits.time[WHITE];
+        else if(token == "btime")     in >> limits.time[BLACK];
+        else if(token == "winc")      in >> limits.increment[WHITE];
+        else if(token == "binc")      in >> limits.increment[BLACK];
+        else if(token == "movestogo") in >> limits.movesToGo;
+        else if(token == "infinite")  limits.infinite = true;
+        else if(token == "ponder")    limits.ponder = true;
+    }
+
+    if(limits.depth < 1) limits.depth = 1;
+    if(limits.depth > MAX_PLY - 1) limits.depth = MAX_PLY - 1;
+
+    // A new move to find, pondered or not: entries of the earlier searches are kept but age
+    tt.newSearch();
+
+    pondering = limits.ponder;
+    stopRequested = false;
+    ponderhitReceived = false;
+    finished = false;
+    ResetStats();
+
+    worker = std::thread([this, limits]()
+    {
+        // With MCTS the nodes are playouts and hashfull is the share of the node arena in use
+        SearchReporter report = [this](const SearchInfo& info)
+        {
+            const int hashfull = useMcts ? static_cast<int>(mcts.nodesUsed() * 1000 / mcts.capacity()) : tt.hashfull();
+
+            std::string line = "info depth " + std::to_string(info.depth) + " seldepth " + std::to_string(info.selDepth) +
+                               " score " + UciScore(info.score) + " nodes " + std::to_string(info.nodes) +
+                               " time " + std::to_string(static_cast<int64_t>(info.seconds * 1000)) +
+                               " nps " + std::to_string(static_cast<uint64_t>(info.seconds > 0 ? info.nodes / info.seconds : 0)) +
+                               " hashfull " + std::to_string(hashfull) + " pv";
+
+            for(PackedMove move : info.pv) line += " " + UciString(move);
+
+            Send(line);
+        };
+
+        SearchResult result = useMcts ? mcts.run(position, limits, threads, report) : search.run(position, limits, report);
+
+        // With go infinite the best move may only be sent after stop, even when the search ended on its own,
+        // and with go ponder only after stop or ponderhit
+        while(!stopRequested && (limits.infinite || (limits.ponder && !ponderhitReceived)))
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+        if(STATS_ENABLED) Send("info string " + StatsSummary(CollectStats()));
+
+        if(result.bestMove == NULL_PACKED_MOVE)
+            Send("bestmove 0000");
+        else if(result.ponderMove == NULL_PACKED_MOVE)
+            Send("bestmove " + UciString(result.bestMove));
+        else
+            Send("bestmove " + UciString(result.bestMove) + " ponder " + UciString(result.ponderMove));
+
+        finished = true;
+    });
+}
+
+// The pondering search becomes the search of the move: same tree, same table, its clock starting now
+void Engine::ponderhit()
+{
+    if(!worker.joinable() || !pondering) return;
+
+    pondering = false;
+    ponderhitReceived = true;
+
+    // Like stop, a ponderhit can arrive before the search has started
+    while(!finished && !(useMcts ? mcts.ponderhit() : search.ponderhit()))
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+void Engine::stop()
+{
+    if(!worker.joinable()) return;
+
+    stopRequested = true;
+
+    // A stop sent right after go can arrive before the search has started and reset its flag
+    while(!finished)
+    {
+        search.stop();
+        mcts.stop();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    worker.join();
+}
+
+#define BENCH_DEPTH 9
+#define BENCH_MCTS_PLAYOUTS 20000
+#define BENCH_EVAL_POSITIONS 20000
+#define BENCH_EVAL_PASSES 5
+
+// Openings, middlegames and endgames of every kind, with a few mates and draws. Changing this list, the
+// search or the evaluation changes the node signature of bench.
+static const char *BENCH_FENS[] =
+{
+    PGN_STARTING_FEN,
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 10",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 11",
+    "4rrk1/pp1n3p/3q2pQ/2p1pb2/2PP4/2P3N1/P2B2PP/4RRK1 b - - 7 19",
+    "rq3rk1/ppp2ppp/1bnpb3/3N2B1/3NP3/7P/PPPQ1PP1/2KR3R w - - 7 14",
+    "r1bq1r1k/1pp1n1pp/1p1p4/4p2Q/4Pp2/1BNP4/PPP2PPP/3R1RK1 w - - 2 14",
+    "r3r1k1/2p2ppp/p1p1bn2/8/1q2P3/2NPQN2/PPP3PP/R4RK1 b - - 2 15",
+    "r1bbk1nr/pp3p1p/2n5/1N4p1/2Np1B2/8/PPP2PPP/2KR1B1R w kq - 0 13",
+    "r1bq1rk1/ppp1nppp/4n3/3p3Q/3P4/1BP1B3/PP1N2PP/R4RK1 w - - 1 16",
+    "4r1k1/r1q2ppp/ppp2n2/4P3/5Rb1/1N1BQ3/PPP3PP/R5K1 w - - 1 17",
+    "2rqkb1r/ppp2p2/2npb1p1/1N1Nn2p/2P1PP2/8/PP2B1PP/R1BQK2R b KQ - 0 11",
+    "r1bq1r1k/b1p1npp1/p2p3p/1p6/3PP3/1B2NN2/PP3PPP/R2Q1RK1 w - - 1 16",
+    "3r1rk1/p5pp/bpp1pp2/8/q1PP1P2/b3P3/P2NQRPP/1R2B1K1 b - - 6 22",
+    "r1q2rk1/2p1bppp/2Pp4/p6b/Q1PNp3/4B3/PP1R1PPP/2K4R w - - 2 18",
+    "4k2r/1pb2ppp/1p2p3/1R1p4/3P4/2r1PN2/P4PPP/1R4K1 b - - 3 22",
+    "3q2k1/pb3p1p/4pbp1/2r5/PpN2N2/1P2P2P/5PP1/Q2R2K1 b - - 4 26",
+    "6k1/6p1/6Pp/ppp5/3pn2P/1P3K2/1PP2P2/3N4 b - - 0 1",
+    "3b4/5kp1/1p1p1p1p/pP1PpP1P/P1P1P3/3KN3/8/8 w - - 0 1",
+    "2K5/p7/7P/5pR1/8/5k2/r7/8 w - - 0 1",
+    "8/6pk/1p6/8/PP3p1p/5P2/4KP1q/3Q4 w - - 0 1",
+    "7k/3p2pp/4q3/8/4Q3/5Kp1/P6b/8 w - - 0 1",
+    "8/2p5/8/2kPKp1p/2p4P/2P5/3P4/8 w - - 0 1",
+    "8/1p3pp1/7p/5P1P/2k3P1/8/2K2P2/8 w - - 0 1",
+    "8/pp2r1k1/2p1p3/3pP2p/1P1P1P1P/P5KR/8/8 w - - 0 1",
+    "8/3p4/p1bk3p/Pp6/1Kp1PpPp/2P2P1P/2P5/5B2 b - - 0 1",
+    "5k2/7R/4P2p/5K2/p1r2P1p/8/8/8 b - - 0 1",
+    "6k1/6p1/P6p/r1N5/5p2/7P/1b3PP1/4R1K1 w - - 0 1",
+    "1r3k2/4q3/2Pp3b/3Bp3/2Q2p2/1p1P2P1/1P2KP2/3N4 w - - 0 1",
+    "6k1/4pp1p/3p2p1/P1pPb3/R7/1r2P1PP/3B1P2/6K1 w - - 0 1",
+    "8/3p3B/5p2/5P2/p7/PP5b/k7/6K1 w - - 0 1",
+    "5rk1/q6p/2p3bR/1pPp1rP1/1P1Pp3/P3B1Q1/1K3P2/R7 w - - 93 90",
+    "4rrk1/1p1nq3/p7/2p1P1pp/3P2bp/3Q1Bn1/PPPB4/1K2R1NR w - - 40 21",
+    "r3k2r/3nnpbp/q2pp1p1/p7/Pp1PPPP1/4BNN1/1P5P/R2Q1RK1 w kq - 0 16",
+    "3Qb1k1/1r2ppb1/pN1n2q1/Pp1Pp1Pr/4P2p/4BP2/4B1R1/1R5K b - - 11 40",
+    "4k3/3q1r2/1N2r1b1/3ppN2/2nPP3/1B1R2n1/2R1Q3/3K4 w - - 5 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "8/8/8/8/5kp1/P7/8/1K1N4 w - - 0 80",
+    "8/8/8/5N2/8/p7/8/2NK3k w - - 0 82",
+    "8/3k4/8/8/8/4B3/4KB2/2B5 w - - 0 85",
+    "8/8/1P6/5pr1/8/4R3/7k/2K5 w - - 0 92",
+    "8/2p4P/8/kr6/6R1/8/8/1K6 w - - 0 94",
+    "8/8/3P3k/8/1p6/8/1P6/1K3n2 b - - 0 90",
+    "8/R7/2q5/8/6k1/8/1P5p/K6R w - - 0 124",
+    "6k1/3b3r/1p1p4/p1n2p2/1PPNpP1q/P3Q1p1/1R1RB1P1/5K2 b - - 0 1",
+    "r2r1n2/pp2bk2/2p1p2p/3q4/3PN1QP/2P3R1/P4PP1/5RK1 w - - 0 1",
+    "8/8/8/4k3/8/8/4P3/4K3 w - - 0 1",
+    "7k/7P/6K1/8/3B4/8/8/8 b - - 0 1",
+    "r2qkb1r/pp2nppp/3p4/2pNN1B1/2BnP3/3P4/PPP2PPP/R2bK2R w KQkq - 1 10",
+};
+
+#define BENCH_POSITIONS (sizeof BENCH_FENS / sizeof BENCH_FENS[0])
+
+struct BenchRun
+{
+    uint64_t nodes;
+    double seconds;
+};
+
+// One thread runs every position from a cleared table and history, so the node count is reproducible.
+// With more threads the positions are shared out through a common table and the count is not.
+static BenchRun RunBench(int depth, int threads)
+{
+    TranspositionTable tt(DEFAULT_HASH_MB);
+    std::atomic<size_t> next(0);
+    std::atomic<uint64_t> nodes(0);
+
+    SearchLimits limits;
+    limits.depth = depth;
+
+    auto worker = [&]()
+    {
+        Search search(tt);
+
+        for(size_t i; (i = next++) < BENCH_POSITIONS; )
+        {
+            if(threads == 1) tt.clear();
+            search.clear();
+
+            SearchResult result = search.run(Position(BENCH_FENS[i]), limits);
+            nodes += result.nodes;
+
+            if(threads == 1)
+                std::fprintf(stderr, "position %zu/%zu: %" PRIu64 " nodes, bestmove %s\n", i + 1, BENCH_POSITIONS,
+                             result.nodes, result.bestMove == NULL_PACKED_MOVE ? "0000" : UciString(result.bestMove).c_str());
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> pool;
+    for(int t = 1; t < threads; t++) pool.emplace_back(worker);
+    worker();
+    for(std::thread& thread : pool) thread.join();
+
+    BenchRun run = {nodes, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()};
+    return run;
+}
+
+// bench [depth] [threads]: the node count of the single threaded run is the search's signature
+static int Bench(int depth, int threads)
+{
+    if(depth < 1) depth = BENCH_DEPTH;
+    if(threads < 1) threads = 1;
+
+    ResetStats();
+    ResetAllocations();
+    BenchRun single = RunBench(depth, 1);
+    const StatsSnapshot stats = CollectStats();
+    const AllocCounts allocations = CollectAllocations();
+    const double singleNps = single.seconds > 0 ? single.nodes / single.seconds : 0;
+
+    std::printf("bench depth %d, %zu positions\n", depth, BENCH_POSITIONS);
+    std::printf("nodes %" PRIu64 " in %.2fs: %.0f nodes/s\n", single.nodes, single.seconds, singleNps);
+    if(STATS_ENABLED) std::printf("stats %s\n", StatsJSON(stats).c_str());
+    if(ALLOCS_ENABLED) std::printf("%s", AllocationReport(allocations, single.nodes).c_str());
+
+    if(threads > 1)
+    {
+        BenchRun parallel = RunBench(depth, threads);
+        const double nps = parallel.seconds > 0 ? parallel.nodes / parallel.seconds : 0;
+        const double speedup = singleNps > 0 ? nps / singleNps : 0;
+
+        std::printf("threads %d: nodes %" PRIu64 " in %.2fs: %.0f nodes/s, speedup %.2f, efficiency %.0f%%\n", threads,
+                    parallel.nodes, parallel.seconds, nps, speedup, 100 * speedup / threads);
+    }
+
+    std::fflush(stdout);
+
+    if(HotPathAllocated(allocations))
+    {
+        std::fprintf(stderr, "the search allocated below the root\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+// A fresh tree per position, so every run does the same work apart from the threads' interleaving
+static BenchRun RunMctsBench(uint64_t playouts, int threads)
+{
+    Mcts mcts(DEFAULT_MCTS_MB);
+    uint64_t total = 0;
+
+    SearchLimits limits;
+    limits.nodes = playouts;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for(const char *fen : BENCH_FENS)
+    {
+        mcts.clear();
+        total += mcts.run(Position(fen), limits, threads).nodes;
+    }
+
+    BenchRun run = {total, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()};
+    return run;
+}
+
+// bench mcts [playouts] [threads]: playouts/s on one thread and on threads sharing each tree
+static int BenchMcts(uint64_t playouts, int threads)
+{
+    if(playouts < 1) playouts = BENCH_MCTS_PLAYOUTS;
+    if(threads < 1) threads = 1;
+
+    BenchRun single = RunMctsBench(playouts, 1);
+    const double singleRate = single.seconds > 0 ? single.nodes / single.seconds : 0;
+
+    std::printf("bench mcts %" PRIu64 " playouts, %zu positions\n", playouts, BENCH_POSITIONS);
+    std::printf("playouts %" PRIu64 " in %.2fs: %.0f playouts/s\n", single.nodes, single.seconds, singleRate);
+
+    if(threads > 1)
+    {
+        BenchRun parallel = RunMctsBench(playouts, threads);
+        const double rate = parallel.seconds > 0 ? parallel.nodes / parallel.seconds : 0;
+        const double speedup = singleRate > 0 ? rate / singleRate : 0;
+
+        std::printf("threads %d: playouts %" PRIu64 " in %.2fs: %.0f playouts/s, speedup %.2f, efficiency %.0f%%\n", threads,
+                    parallel.nodes, parallel.seconds, rate, speedup, 100 * speedup / threads);
+    }
+
+    return 0;
+}
+
+// The bench positions and the ones two plies after them, up to count
+static std::vector<Position> EvalBenchPositions(size_t count)
+{
+    std::vector<Position> positions;
+
+    for(size_t i = 0; i < BENCH_POSITIONS && positions.size() < count; i++)
+    {
+        Position pos(BENCH_FENS[i]);
+        positions.push_back(pos);
+
+        MoveList moves;
+        GenerateLegalMoves(pos, moves);
+
+        for(PackedMove move : moves)
+        {
+            MoveUndo undo;
+            pos.makeMove(move, undo);
+
+            MoveList replies;
+            GenerateLegalMoves(pos, replies);
+
+            for(PackedMove reply : replies)
+            {
+                if(positions.size() >= count) break;
+
+                MoveUndo replyUndo;
+                pos.makeMove(reply, replyUndo);
+                positions.push_back(pos);
+                pos.unmakeMove(replyUndo);
+            }
+
+            pos.unmakeMove(undo);
+        }
+    }
+
+    return positions;
+}
+
+// Mobility as it was counted before the attack bitboards: the legal moves of every piece, the side
+// not to move through a null move
+static int LegalMoveMobility(Position& pos)
+{
+    int mobility = 0;
+    MoveUndo undo;
+
+    for(int side = 0; side < PLAYER_COUNT; side++)
+    {
+        const PieceColor color = pos.color_playing;
+
+        for(int type = KNIGHT; type <= QUEEN; type++)
+            for(Bitboard pieces = pos.pieces[color][type]; pieces; )
+            {
+                const int moves = static_cast<int>(pos.MovesFromSquare(CoordFromIndex(PopLowestSquare(pieces))).size());
+                mobility += color == WHITE ? moves : -moves;
+            }
+
+        if(side == 0) pos.makeNullMove(undo);
+    }
+
+    pos.unmakeNullMove(undo);
+    return mobility;
+}
+
+// bench eval [positions]: every term EvalTermCounts finds (pawn structure, and mobility, king attacks,
+// threats and space from the attack bitboards) against the mobility counts alone from MovesFromSquare
+static int BenchEval(size_t count)
+{
+    if(count < 1) count = BENCH_EVAL_POSITIONS;
+
+    std::vector<Position> positions = EvalBenchPositions(count);
+    long long checksum = 0;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for(int pass = 0; pass < BENCH_EVAL_PASSES; pass++)
+        for(const Position& pos : positions)
+        {
+            int counts[TERM_COUNT] = {};
+            EvalTermCounts(pos, counts);
+            checksum += counts[TERM_MOBILITY];
+        }
+
+    auto middle = std::chrono::steady_clock::now();
+
+    for(int pass = 0; pass < BENCH_EVAL_PASSES; pass++)
+        for(Position& pos : positions)
+            checksum += LegalMoveMobility(pos);
+
+    auto end = std::chrono::steady_clock::now();
+
+    const double runs = static_cast<double>(positions.size()) * BENCH_EVAL_PASSES;
+    const double termsNs = std::chrono::duration<double, std::nano>(middle - start).count() / runs;
+    const double legalNs = std::chrono::duration<double, std::nano>(end - middle).count() / runs;
+
+    std::printf("bench eval %zu positions, %d passes (checksum %lld)\n", positions.size(), BENCH_EVAL_PASSES, checksum);
+    std::printf("attack bitboard terms %.0f ns, legal move mobility %.0f ns per position\n", termsNs, legalNs);
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if(argc >= 3 && std::string(argv[1]) == "bench" && std::string(argv[2]) == "mcts")
+        return BenchMcts(argc > 3 ? std::strtoull(argv[3], nullptr, 10) : BENCH_MCTS_PLAYOUTS, argc > 4 ? std::atoi(argv[4]) : 1);
+
+    if(argc >= 3 && std::string(argv[1]) == "bench" && std::string(argv[2]) == "eval")
+        return BenchEval(argc > 3 ? std::strtoull(argv[3], nullptr, 10) : BENCH_EVAL_POSITIONS);
+
+    if(argc >= 2 && std::string(argv[1]) == "bench")
+        return Bench(argc > 2 ? std::atoi(argv[2]) : BENCH_DEPTH, argc > 3 ? std::atoi(argv[3]) : 1);
+
+    std::ios::sync_with_stdio(false);
+
+    // Reading input would flush std::cout outside the output lock while the search thread prints
+    std::cin.tie(nullptr);
+
+    Engine engine;
+    std::string line;
+
+    while(std::getline(std::cin, line))
+    {
+        if(line == "quit") break;
+
+        engine.command(line);
+    }
+
+    return 0;
+}